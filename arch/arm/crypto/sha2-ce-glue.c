@@ -11,6 +11,7 @@
 #include <crypto/sha.h>
 #include <crypto/sha256_base.h>
 #include <crypto/internal.h>
+#include <crypto/pbl-sha.h>
 #include <linux/linkage.h>
 #include <asm/byteorder.h>
 #include <asm/neon.h>
@@ -73,16 +74,25 @@ static int sha256_ce_final(struct digest *desc, u8 *out)
 	return sha256_base_finish(desc, out);
 }
 
-static struct digest_algo sha224 = {
+static bool sha256_ce_supported(void)
+{
+	uint64_t isar0;
+
+	isar0 = read_sysreg(ID_AA64ISAR0_EL1);
+
+	return isar0 & ID_AA64ISAR0_EL1_SHA2_MASK;
+}
+
+static struct digest_algo sha256 = {
 	.base = {
-		.name		=	"sha224",
-		.driver_name	=	"sha224-ce",
+		.name		=	"sha256",
+		.driver_name	=	"sha256-ce",
 		.priority	=	200,
-		.algo		=	HASH_ALGO_SHA224,
+		.algo		=	HASH_ALGO_SHA256,
 	},
 
-	.length	=	SHA224_DIGEST_SIZE,
-	.init	=	sha224_base_init,
+	.length	=	SHA256_DIGEST_SIZE,
+	.init	=	sha256_base_init,
 	.update	=	sha256_ce_update,
 	.final	=	sha256_ce_final,
 	.digest	=	digest_generic_digest,
@@ -90,22 +100,24 @@ static struct digest_algo sha224 = {
 	.ctx_length =	sizeof(struct sha256_ce_state),
 };
 
-static int sha224_ce_digest_register(void)
+#ifdef __PBL__
+static_assert(sizeof(struct sha256_ce_state) <= SHA256_PBL_CTX_SIZE);
+
+struct digest_algo *sha256_ce_pbl_algo(void)
 {
-	return digest_algo_register(&sha224);
+	return sha256_ce_supported() ? &sha256 : NULL;
 }
-coredevice_initcall(sha224_ce_digest_register);
-
-static struct digest_algo sha256 = {
+#else
+static struct digest_algo sha224 = {
 	.base = {
-		.name		=	"sha256",
-		.driver_name	=	"sha256-ce",
+		.name		=	"sha224",
+		.driver_name	=	"sha224-ce",
 		.priority	=	200,
-		.algo		=	HASH_ALGO_SHA256,
+		.algo		=	HASH_ALGO_SHA224,
 	},
 
-	.length	=	SHA256_DIGEST_SIZE,
-	.init	=	sha256_base_init,
+	.length	=	SHA224_DIGEST_SIZE,
+	.init	=	sha224_base_init,
 	.update	=	sha256_ce_update,
 	.final	=	sha256_ce_final,
 	.digest	=	digest_generic_digest,
@@ -113,14 +125,18 @@ static struct digest_algo sha256 = {
 	.ctx_length =	sizeof(struct sha256_ce_state),
 };
 
-static int sha256_ce_digest_register(void)
+static int sha224_ce_digest_register(void)
 {
-	uint64_t isar0;
+	return digest_algo_register(&sha224);
+}
+coredevice_initcall(sha224_ce_digest_register);
 
-	isar0 = read_sysreg(ID_AA64ISAR0_EL1);
-	if (!(isar0 & ID_AA64ISAR0_EL1_SHA2_MASK))
+static int sha256_ce_digest_register(void)
+{
+	if (!sha256_ce_supported())
 		return -EOPNOTSUPP;
 
 	return digest_algo_register(&sha256);
 }
 coredevice_initcall(sha256_ce_digest_register);
+#endif /* __PBL__ */
@@ -14,6 +14,7 @@
 #include <binfmt.h>
 #include <common.h>
 #include <libfile.h>
+#include <image-fit.h>
 #include <linux/kernel.h>
 
 #include <asm/cache.h>
@@ -114,10 +115,20 @@ static int do_bootm_elf(struct image_data *data)
 	struct elf_image *elf;
 	int ret;
 
-	if (data->fit_kernel)
-		elf = elf_open_binary((void *) data->fit_kernel);
-	else
+	if (data->os_fit) {
+		const void *kernel;
+		unsigned long kernel_size;
+
+		/* fit_kernel may only hold the kernel header, get the whole ELF */
+		ret = fit_open_image(data->os_fit, data->fit_config, "kernel",
+				     &kernel, &kernel_size);
+		if (ret)
+			return ret;
+
+		elf = elf_open_binary((void *)kernel);
+	} else {
 		elf = elf_open(data->os_file);
+	}
 
 	if (IS_ERR(elf))
 		return PTR_ERR(elf);
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * sha256-ni-glue.c - SHA-224/SHA-256 using the x86 SHA extensions
+ */
+
+#include <common.h>
+#include <digest.h>
+#include <init.h>
+#include <crypto/sha.h>
+#include <crypto/sha256_base.h>
+#include <crypto/internal.h>
+#include <linux/linkage.h>
+
+MODULE_DESCRIPTION("SHA-224/SHA-256 secure hash using the x86 SHA extensions");
+MODULE_LICENSE("GPL v2");
+MODULE_ALIAS_CRYPTO("sha224");
+MODULE_ALIAS_CRYPTO("sha256");
+
+#define CPUID1_ECX_SSSE3	BIT(9)
+#define CPUID1_ECX_SSE4_1	BIT(19)
+#define CPUID7_EBX_SHA		BIT(29)
+
+asmlinkage void sha256_ni_transform(u32 *digest, const u8 *data, int blocks);
+
+static void __sha256_ni_transform(struct sha256_state *sst, u8 const *src,
+				  int blocks)
+{
+	sha256_ni_transform(sst->state, src, blocks);
+}
+
+static int sha256_ni_update(struct digest *desc, const void *data,
+			    unsigned long len)
+{
+	return sha256_base_do_update(desc, data, len, __sha256_ni_transform);
+}
+
+static int sha256_ni_final(struct digest *desc, u8 *out)
+{
+	sha256_base_do_finalize(desc, __sha256_ni_transform);
+	return sha256_base_finish(desc, out);
+}
+
+static void sha256_ni_cpuid(u32 leaf, u32 *eax, u32 *ebx, u32 *ecx)
+{
+	u32 edx;
+
+	asm volatile("cpuid"
+		     : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (edx)
+		     : "0" (leaf), "2" (0));
+}
+
+static bool sha256_ni_supported(void)
+{
+	u32 max, eax, ebx, ecx;
+
+	sha256_ni_cpuid(0, &max, &ebx, &ecx);
+	if (max < 7)
+		return false;
+
+	sha256_ni_cpuid(1, &eax, &ebx, &ecx);
+	if ((ecx & (CPUID1_ECX_SSSE3 | CPUID1_ECX_SSE4_1)) !=
+	    (CPUID1_ECX_SSSE3 | CPUID1_ECX_SSE4_1))
+		return false;
+
+	sha256_ni_cpuid(7, &eax, &ebx, &ecx);
+
+	return ebx & CPUID7_EBX_SHA;
+}
+
+static struct digest_algo sha224 = {
+	.base = {
+		.name		=	"sha224",
+		.driver_name	=	"sha224-ni",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA224,
+	},
+
+	.length	=	SHA224_DIGEST_SIZE,
+	.init	=	sha224_base_init,
+	.update	=	sha256_ni_update,
+	.final	=	sha256_ni_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static int sha224_ni_digest_register(void)
+{
+	if (!sha256_ni_supported())
+		return -EOPNOTSUPP;
+
+	return digest_algo_register(&sha224);
+}
+coredevice_initcall(sha224_ni_digest_register);
+
+static struct digest_algo sha256 = {
+	.base = {
+		.name		=	"sha256",
+		.driver_name	=	"sha256-ni",
+		.priority	=	200,
+		.algo		=	HASH_ALGO_SHA256,
+	},
+
+	.length	=	SHA256_DIGEST_SIZE,
+	.init	=	sha256_base_init,
+	.update	=	sha256_ni_update,
+	.final	=	sha256_ni_final,
+	.digest	=	digest_generic_digest,
+	.verify	=	digest_generic_verify,
+	.ctx_length =	sizeof(struct sha256_state),
+};
+
+static int sha256_ni_digest_register(void)
+{
+	if (!sha256_ni_supported())
+		return -EOPNOTSUPP;
+
+	return digest_algo_register(&sha256);
+}
+coredevice_initcall(sha256_ni_digest_register);
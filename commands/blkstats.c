@@ -35,16 +35,20 @@ static int do_blkstats(int argc, char *argv[])
 		if (name && strcmp(name, blk->cdev.name))
 			continue;
 
-		if (first) {
-			printf("%-16s %10s %10s %10s\n",
-			       "Device", "Read", "Write", "Erase");
+		if (!first) {
+			printf("%-16s %10s %10s %10s %10s %10s %10s %10s\n",
+			       "Device", "Read", "Write", "Erase",
+			       "Read-BP", "Write-BP", "RA-Hit", "RA-Miss");
 			first = true;
 		}
 
 		stats = &blk->stats;
 
-		printf("%-16s %10llu %10llu %10llu\n", blk->cdev.name,
-		       stats->read_sectors, stats->write_sectors, stats->erase_sectors);
+		printf("%-16s %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n",
+		       blk->cdev.name,
+		       stats->read_sectors, stats->write_sectors, stats->erase_sectors,
+		       stats->bypass_read_sectors, stats->bypass_write_sectors,
+		       stats->readahead_hits, stats->readahead_misses);
 	}
 
 	return 0;
@@ -52,6 +56,10 @@ static int do_blkstats(int argc, char *argv[])
 
 BAREBOX_CMD_HELP_START(blkstats)
 BAREBOX_CMD_HELP_TEXT("Display a block device's number of read, written and erased sectors")
+BAREBOX_CMD_HELP_TEXT("Read-BP and Write-BP show how many of the read and written sectors")
+BAREBOX_CMD_HELP_TEXT("bypassed the block cache and were transferred directly to/from the")
+BAREBOX_CMD_HELP_TEXT("caller's buffer. RA-Hit and RA-Miss count the block cache misses")
+BAREBOX_CMD_HELP_TEXT("that were served from the readahead buffer or needed a synchronous read.")
 BAREBOX_CMD_HELP_TEXT("")
 BAREBOX_CMD_HELP_TEXT("Options:")
 BAREBOX_CMD_HELP_OPT("-l",  "list all currently registered block devices")
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * membench - measure memory/string function throughput
+ *
+ * Compares the string functions barebox is using with the generic C
+ * implementations from lib/string.c and plain byte loops.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <clock.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <string.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+static unsigned long membench_sink;
+
+/*
+ * Keep the compiler from turning the byte loops back into calls to the
+ * very functions they are compared against.
+ */
+#define __membench_bytewise	__optimize("no-tree-loop-distribute-patterns")
+
+static void membench_memcpy(void *dst, void *src, size_t size)
+{
+	memcpy(dst, src, size);
+}
+
+static void membench_memcpy_generic(void *dst, void *src, size_t size)
+{
+	__default_memcpy(dst, src, size);
+}
+
+static void __membench_bytewise membench_memcpy_byte(void *dst, void *src, size_t size)
+{
+	char *d = dst, *s = src;
+
+	while (size--)
+		*d++ = *s++;
+}
+
+static void membench_memset(void *dst, void *src, size_t size)
+{
+	memset(dst, 0x5a, size);
+}
+
+static void membench_memset_generic(void *dst, void *src, size_t size)
+{
+	__default_memset(dst, 0x5a, size);
+}
+
+static void __membench_bytewise membench_memset_byte(void *dst, void *src, size_t size)
+{
+	char *d = dst;
+
+	while (size--)
+		*d++ = 0x5a;
+}
+
+static void membench_memcmp(void *dst, void *src, size_t size)
+{
+	membench_sink += memcmp(dst, src, size);
+}
+
+static void __membench_bytewise membench_memcmp_byte(void *dst, void *src, size_t size)
+{
+	const unsigned char *d = dst, *s = src;
+	int res = 0;
+
+	while (size--)
+		if ((res = *d++ - *s++) != 0)
+			break;
+
+	membench_sink += res;
+}
+
+static void membench_strlen(void *dst, void *src, size_t size)
+{
+	membench_sink += strlen(src);
+}
+
+static void __membench_bytewise membench_strlen_byte(void *dst, void *src, size_t size)
+{
+	const char *s = src;
+
+	while (*s)
+		s++;
+
+	membench_sink += s - (const char *)src;
+}
+
+struct membench_test {
+	const char *name;
+	const char *impl;
+	void (*run)(void *dst, void *src, size_t size);
+};
+
+static const struct membench_test membench_tests[] = {
+	{ "memcpy", "active", membench_memcpy },
+	{ "memcpy", "generic", membench_memcpy_generic },
+	{ "memcpy", "bytewise", membench_memcpy_byte },
+	{ "memset", "active", membench_memset },
+	{ "memset", "generic", membench_memset_generic },
+	{ "memset", "bytewise", membench_memset_byte },
+	{ "memcmp", "active", membench_memcmp },
+	{ "memcmp", "bytewise", membench_memcmp_byte },
+	{ "strlen", "active", membench_strlen },
+	{ "strlen", "bytewise", membench_strlen_byte },
+};
+
+static int do_membench(int argc, char *argv[])
+{
+	const struct membench_test *test;
+	size_t size = SZ_1M, offset = 0;
+	unsigned int iterations = 16, i;
+	void *dstbuf, *srcbuf, *dst, *src;
+	u64 start, ns, mbps;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:i:o:")) > 0) {
+		switch (opt) {
+		case 's':
+			size = strtoull_suffix(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			offset = simple_strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (!size || !iterations || offset >= sizeof(long))
+		return COMMAND_ERROR_USAGE;
+
+	dstbuf = malloc(size + sizeof(long));
+	srcbuf = malloc(size + sizeof(long));
+	if (!dstbuf || !srcbuf) {
+		printf("could not allocate 2 x %zu bytes\n", size);
+		free(dstbuf);
+		free(srcbuf);
+		return 1;
+	}
+
+	/* misalign the source only, so that unequal alignment is covered */
+	dst = dstbuf;
+	src = srcbuf + offset;
+
+	printf("%zu bytes, %u iterations, source offset %zu\n",
+	       size, iterations, offset);
+
+	for (test = membench_tests;
+	     test < membench_tests + ARRAY_SIZE(membench_tests); test++) {
+		/* equal NUL-terminated buffers, so memcmp/strlen scan everything */
+		memset(src, 'x', size - 1);
+		((char *)src)[size - 1] = '\0';
+		memcpy(dst, src, size);
+
+		start = get_time_ns();
+		for (i = 0; i < iterations; i++)
+			test->run(dst, src, size);
+		ns = get_time_ns() - start;
+
+		if (ctrlc())
+			break;
+
+		mbps = div64_u64((u64)size * iterations * NSEC_PER_SEC,
+				 max_t(u64, ns, 1) * SZ_1M);
+
+		printf("%-8s %-10s %8llu us %8llu MiB/s\n", test->name,
+		       test->impl, div_u64(ns, NSEC_PER_USEC), mbps);
+	}
+
+	free(dstbuf);
+	free(srcbuf);
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(membench)
+BAREBOX_CMD_HELP_TEXT("Measure the throughput of memcpy, memset, memcmp and strlen.")
+BAREBOX_CMD_HELP_TEXT("The implementation in use (active) is compared against the")
+BAREBOX_CMD_HELP_TEXT("generic C version from lib/string.c and a plain byte loop.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-s SIZE",  "buffer size (default 1M)")
+BAREBOX_CMD_HELP_OPT ("-i COUNT", "iterations per function (default 16)")
+BAREBOX_CMD_HELP_OPT ("-o OFFSET", "misalign source buffer by OFFSET bytes")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(membench)
+	.cmd		= do_membench,
+	BAREBOX_CMD_DESC("benchmark string and memory functions")
+	BAREBOX_CMD_OPTS("[-sio]")
+	BAREBOX_CMD_GROUP(CMD_GRP_INFO)
+	BAREBOX_CMD_HELP(cmd_membench_help)
+BAREBOX_CMD_END
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/* wget.c - fetch a file via HTTP */
+
+#include <common.h>
+#include <command.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <net.h>
+#include <libfile.h>
+#include <linux/kstrtox.h>
+
+#define WGET_HDR_SIZE	1024
+
+struct wget_priv {
+	int fd;
+	int status;
+	int error;
+	bool header_done;
+	char header[WGET_HDR_SIZE];
+	size_t header_len;
+	loff_t size;
+};
+
+static int wget_parse_header(struct wget_priv *priv)
+{
+	char *p;
+
+	/* only the status line is of interest */
+	p = strstr(priv->header, "\r\n");
+	if (p)
+		*p = '\0';
+
+	if (!str_has_prefix(priv->header, "HTTP/1."))
+		return -EPROTO;
+
+	p = strchr(priv->header, ' ');
+	if (!p)
+		return -EPROTO;
+
+	priv->status = simple_strtoul(p + 1, NULL, 10);
+
+	return 0;
+}
+
+static int wget_write(struct wget_priv *priv, const char *data, unsigned len)
+{
+	int ret;
+
+	if (!len)
+		return 0;
+
+	if (priv->status != 200)
+		return 0;
+
+	ret = write_full(priv->fd, data, len);
+	if (ret < 0)
+		return ret;
+
+	priv->size += len;
+
+	return 0;
+}
+
+static void wget_handler(void *ctx, char *data, unsigned len)
+{
+	struct wget_priv *priv = ctx;
+	size_t now, start, ofs;
+	char *end;
+
+	if (priv->error)
+		return;
+
+	if (priv->header_done) {
+		priv->error = wget_write(priv, data, len);
+		return;
+	}
+
+	/* collect the response header, it may be split over several segments */
+	start = priv->header_len;
+	now = min_t(size_t, len, WGET_HDR_SIZE - 1 - priv->header_len);
+	memcpy(priv->header + priv->header_len, data, now);
+	priv->header_len += now;
+	priv->header[priv->header_len] = '\0';
+
+	end = strstr(priv->header, "\r\n\r\n");
+	if (!end) {
+		if (priv->header_len == WGET_HDR_SIZE - 1)
+			priv->error = -E2BIG;
+		return;
+	}
+
+	/* the part of this segment following the header is body */
+	ofs = end + 4 - priv->header - start;
+
+	*end = '\0';
+	priv->header_done = true;
+
+	priv->error = wget_parse_header(priv);
+	if (!priv->error)
+		priv->error = wget_write(priv, data + ofs, len - ofs);
+}
+
+static int wget(IPaddr_t ip, uint16_t port, const char *host,
+		const char *path, struct wget_priv *priv)
+{
+	struct net_connection *con;
+	char *req;
+	int ret;
+
+	con = net_tcp_new(ip, port, wget_handler, priv);
+	if (IS_ERR(con))
+		return PTR_ERR(con);
+
+	req = xasprintf("GET /%s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n\r\n",
+			path, host);
+	ret = net_tcp_send(con, req, strlen(req));
+	free(req);
+	if (ret)
+		goto out;
+
+	while (!net_tcp_eof(con) && !priv->error) {
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto out;
+		}
+		net_poll();
+	}
+
+	ret = net_tcp_close(con);
+	if (!ret)
+		ret = priv->error;
+	if (!ret && !priv->header_done)
+		ret = -EPROTO;
+out:
+	net_unregister(con);
+
+	return ret;
+}
+
+static int do_wget(int argc, char *argv[])
+{
+	struct wget_priv priv = {};
+	const char *url, *dest;
+	char *host, *path, *p;
+	uint16_t port = 80;
+	IPaddr_t ip;
+	int ret;
+
+	if (argc < 2)
+		return COMMAND_ERROR_USAGE;
+
+	url = argv[1];
+
+	if (!str_has_prefix(url, "http://")) {
+		printf("only http:// URLs are supported\n");
+		return COMMAND_ERROR_USAGE;
+	}
+
+	host = xstrdup(url + strlen("http://"));
+
+	path = strchrnul(host, '/');
+	if (*path)
+		*path++ = '\0';
+
+	p = strchr(host, ':');
+	if (p) {
+		*p++ = '\0';
+		if (kstrtou16(p, 10, &port) || !port) {
+			printf("invalid port '%s'\n", p);
+			ret = COMMAND_ERROR_USAGE;
+			goto out;
+		}
+	}
+
+	if (argc > 2)
+		dest = argv[2];
+	else
+		dest = kbasename(path);
+
+	if (!*dest) {
+		printf("no destination file given\n");
+		ret = COMMAND_ERROR_USAGE;
+		goto out;
+	}
+
+	ret = resolv(host, &ip);
+	if (ret) {
+		printf("unknown host %s\n", host);
+		goto out;
+	}
+
+	priv.fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC);
+	if (priv.fd < 0) {
+		ret = priv.fd;
+		printf("could not open %s: %m\n", dest);
+		goto out;
+	}
+
+	ret = wget(ip, port, host, path, &priv);
+
+	close(priv.fd);
+
+	if (!ret && priv.status != 200) {
+		printf("server returned: %s\n", priv.header);
+		ret = -EIO;
+	}
+
+	if (ret) {
+		printf("fetching %s failed: %pe\n", url, ERR_PTR(ret));
+		unlink(dest);
+	} else {
+		printf("%lld bytes written to %s\n", priv.size, dest);
+	}
+out:
+	free(host);
+
+	return ret < 0 ? COMMAND_ERROR : ret;
+}
+
+BAREBOX_CMD_HELP_START(wget)
+BAREBOX_CMD_HELP_TEXT("Fetch URL with HTTP/1.0 and write the body to FILE.")
+BAREBOX_CMD_HELP_TEXT("FILE defaults to the last path component of URL.")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(wget)
+	.cmd		= do_wget,
+	BAREBOX_CMD_DESC("fetch a file via HTTP")
+	BAREBOX_CMD_OPTS("http://HOST[:PORT]/PATH [FILE]")
+	BAREBOX_CMD_GROUP(CMD_GRP_NET)
+	BAREBOX_CMD_HELP(cmd_wget_help)
+BAREBOX_CMD_END
@@ -14,6 +14,10 @@
 #include <range.h>
 #include <bootargs.h>
 #include <file-list.h>
+#include <param.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
 
 LIST_HEAD(block_device_list);
 
@@ -24,9 +28,12 @@ struct chunk {
 	int dirty; /* need to write back to device */
 	int num; /* number of chunk, debugging only */
 	struct list_head list;
+	struct hlist_node hnode; /* in chunk_hash while cached */
 };
 
 #define BUFSIZE (PAGE_SIZE * 16)
+#define NUM_CHUNKS 8
+#define READAHEAD_MAX SZ_512K
 
 static int writebuffer_io_len(struct block_device *blk, struct chunk *chunk)
 {
@@ -46,12 +53,46 @@ static void blk_stats_record_erase(struct block_device *blk, blkcnt_t count)
 {
 	blk->stats.erase_sectors += count;
 }
+static void blk_stats_record_bypass_read(struct block_device *blk, blkcnt_t count)
+{
+	blk->stats.read_sectors += count;
+	blk->stats.bypass_read_sectors += count;
+}
+static void blk_stats_record_bypass_write(struct block_device *blk, blkcnt_t count)
+{
+	blk->stats.write_sectors += count;
+	blk->stats.bypass_write_sectors += count;
+}
+static void blk_stats_record_ra_hit(struct block_device *blk)
+{
+	blk->stats.readahead_hits++;
+}
+static void blk_stats_record_ra_miss(struct block_device *blk)
+{
+	blk->stats.readahead_misses++;
+}
 #else
 static void blk_stats_record_read(struct block_device *blk, blkcnt_t count) { }
 static void blk_stats_record_write(struct block_device *blk, blkcnt_t count) { }
 static void blk_stats_record_erase(struct block_device *blk, blkcnt_t count) { }
+static void blk_stats_record_bypass_read(struct block_device *blk, blkcnt_t count) { }
+static void blk_stats_record_bypass_write(struct block_device *blk, blkcnt_t count) { }
+static void blk_stats_record_ra_hit(struct block_device *blk) { }
+static void blk_stats_record_ra_miss(struct block_device *blk) { }
 #endif
 
+/*
+ * Drop the part of the readahead buffer overlapping the given range.
+ * The buffer only holds a single contiguous window, so it is simply
+ * invalidated as a whole.
+ */
+static void block_ra_invalidate(struct block_device *blk, sector_t block,
+				blkcnt_t num_blocks)
+{
+	if (region_overlap_size(block, num_blocks, blk->ra_start, blk->ra_len))
+		blk->ra_len = 0;
+}
+
 static int chunk_flush(struct block_device *blk, struct chunk *chunk)
 {
 	size_t len;
@@ -67,6 +108,9 @@ static int chunk_flush(struct block_device *blk, struct chunk *chunk)
 
 	blk_stats_record_write(blk, len);
 
+	/* the readahead buffer may have been filled while the chunk was dirty */
+	block_ra_invalidate(blk, chunk->block_start, len);
+
 	chunk->dirty = 0;
 
 	return 0;
@@ -95,17 +139,33 @@ static int writebuffer_flush(struct block_device *blk)
 	return 0;
 }
 
+static struct hlist_head *chunk_hash_head(struct block_device *blk,
+					  sector_t block_start)
+{
+	return &blk->chunk_hash[hash_64(block_start, blk->chunk_hash_bits)];
+}
+
+static void chunk_hash_add(struct block_device *blk, struct chunk *chunk)
+{
+	hlist_add_head(&chunk->hnode, chunk_hash_head(blk, chunk->block_start));
+}
+
+static void chunk_hash_del(struct chunk *chunk)
+{
+	hlist_del_init(&chunk->hnode);
+}
+
 /*
  * get the chunk containing a given block. Will return NULL if the
  * block is not cached, the chunk otherwise.
  */
 static struct chunk *chunk_get_cached(struct block_device *blk, sector_t block)
 {
+	sector_t block_start = block & ~blk->blkmask;
 	struct chunk *chunk;
 
-	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
-		if (block >= chunk->block_start &&
-				block < chunk->block_start + blk->rdbufsize) {
+	hlist_for_each_entry(chunk, chunk_hash_head(blk, block_start), hnode) {
+		if (chunk->block_start == block_start) {
 			dev_vdbg(blk->dev, "%s: found %llu in %d\n", __func__,
 				block, chunk->num);
 			/*
@@ -150,6 +210,7 @@ static struct chunk *get_chunk(struct block_device *blk)
 		ret = chunk_flush(blk, chunk);
 		if (ret < 0)
 			return ERR_PTR(ret);
+		chunk_hash_del(chunk);
 	} else {
 		chunk = list_first_entry(&blk->idle_blocks, struct chunk, list);
 	}
@@ -185,6 +246,7 @@ static int block_cache(struct block_device *blk, sector_t block)
 	    <= blk->discard_start + blk->discard_size) {
 		memset(chunk->data, 0, len);
 		list_add(&chunk->list, &blk->buffered_blocks);
+		chunk_hash_add(blk, chunk);
 		return 0;
 	}
 
@@ -196,15 +258,88 @@ static int block_cache(struct block_device *blk, sector_t block)
 
 	blk_stats_record_read(blk, len);
 	list_add(&chunk->list, &blk->buffered_blocks);
+	chunk_hash_add(blk, chunk);
+
+	return 0;
+}
+
+/*
+ * Get the data pointer for a given block from the readahead buffer.
+ * Will return NULL if the block is not in the current readahead window.
+ */
+static void *block_get_readahead(struct block_device *blk, sector_t block)
+{
+	if (block < blk->ra_start || block >= blk->ra_start + blk->ra_len)
+		return NULL;
+
+	return blk->ra_buf + ((block - blk->ra_start) << blk->blockbits);
+}
+
+/*
+ * Sequential stream detection. A miss on the chunk following the previous
+ * miss means the consumer reads sequentially. In this case the readahead
+ * window is doubled (up to blk->readahead bytes) and the whole window is
+ * read from the device in a single request. Any other access pattern resets
+ * the window. Returns 0 if the readahead buffer contains @block afterwards,
+ * -EAGAIN if the block should be read into the chunk cache instead, or
+ * a negative error code from the driver.
+ */
+static int block_readahead(struct block_device *blk, sector_t block)
+{
+	sector_t start = block & ~blk->blkmask;
+	blkcnt_t max = blk->readahead >> blk->blockbits;
+	blkcnt_t len;
+	int ret;
+
+	if (start != blk->ra_next || max < 2 * blk->rdbufsize) {
+		blk->ra_window = 0;
+		blk->ra_next = start + blk->rdbufsize;
+		return -EAGAIN;
+	}
+
+	if (!blk->ra_window)
+		blk->ra_window = 2 * blk->rdbufsize;
+	else
+		blk->ra_window = min_t(blkcnt_t, blk->ra_window * 2, max);
+
+	len = min_t(blkcnt_t, blk->ra_window, blk->num_blocks - start);
+
+	if (region_overlap_size(start << blk->blockbits, len << blk->blockbits,
+				blk->discard_start, blk->discard_size))
+		return -EAGAIN;
+
+	if (!blk->ra_buf) {
+		blk->ra_buf = dma_alloc(max << blk->blockbits);
+		if (!blk->ra_buf)
+			return -EAGAIN;
+	}
+
+	dev_vdbg(blk->dev, "%s: %llu blocks at %llu\n", __func__, len, start);
+
+	blk->ra_len = 0;
+
+	ret = blk->ops->read(blk, blk->ra_buf, start, len);
+	if (ret) {
+		blk->ra_window = 0;
+		return ret;
+	}
+
+	blk_stats_record_read(blk, len);
+
+	blk->ra_start = start;
+	blk->ra_len = len;
+	blk->ra_next = start + len;
 
 	return 0;
 }
 
 /*
  * Get the data for a block, either from the cache or from
- * the device.
+ * the device. With @write set the block is always returned from
+ * a chunk, never from the readahead buffer, so that it can be
+ * marked dirty afterwards.
  */
-static void *block_get(struct block_device *blk, sector_t block)
+static void *__block_get(struct block_device *blk, sector_t block, bool write)
 {
 	void *outdata;
 	int ret;
@@ -216,6 +351,24 @@ static void *block_get(struct block_device *blk, sector_t block)
 	if (outdata)
 		return outdata;
 
+	if (write)
+		goto cache;
+
+	outdata = block_get_readahead(blk, block);
+	if (outdata) {
+		blk_stats_record_ra_hit(blk);
+		return outdata;
+	}
+
+	blk_stats_record_ra_miss(blk);
+
+	ret = block_readahead(blk, block);
+	if (!ret)
+		return block_get_readahead(blk, block);
+	if (ret != -EAGAIN)
+		return ERR_PTR(ret);
+
+cache:
 	ret = block_cache(blk, block);
 	if (ret)
 		return ERR_PTR(ret);
@@ -227,6 +380,96 @@ static void *block_get(struct block_device *blk, sector_t block)
 	return outdata;
 }
 
+static void *block_get(struct block_device *blk, sector_t block)
+{
+	return __block_get(blk, block, false);
+}
+
+/*
+ * Write back all dirty chunks overlapping the given range. With @drop
+ * set the chunks are additionally removed from the cache, which is
+ * needed when the device contents of the range are about to change
+ * behind the cache's back. Chunks completely covered by the range
+ * are dropped without writing them back first.
+ */
+static int block_sync_range(struct block_device *blk, sector_t block,
+			    blkcnt_t num_blocks, bool drop)
+{
+	struct chunk *chunk, *tmp;
+	int ret;
+
+	if (drop)
+		block_ra_invalidate(blk, block, num_blocks);
+
+	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
+		if (!region_overlap_size(block, num_blocks,
+					 chunk->block_start, blk->rdbufsize))
+			continue;
+
+		if (!drop || chunk->block_start < block ||
+		    chunk->block_start + blk->rdbufsize > block + num_blocks) {
+			ret = chunk_flush(blk, chunk);
+			if (ret < 0)
+				return ret;
+		}
+
+		if (drop) {
+			chunk->dirty = 0;
+			chunk_hash_del(chunk);
+			list_move(&chunk->list, &blk->idle_blocks);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check if a request can bypass the block cache and be passed directly
+ * to the driver. This is done for requests spanning at least a full chunk
+ * when the caller's buffer is suitable for DMA. Going through the cache
+ * would only add a memcpy for every block in this case.
+ */
+static bool block_can_bypass(struct block_device *blk, const void *buf,
+			     sector_t block, blkcnt_t num_blocks)
+{
+	if (num_blocks < blk->rdbufsize)
+		return false;
+
+	if (!IS_ALIGNED((unsigned long)buf, DMA_ALIGNMENT))
+		return false;
+
+	if (block + num_blocks > blk->num_blocks)
+		return false;
+
+	if (region_overlap_size(block << blk->blockbits, num_blocks << blk->blockbits,
+				blk->discard_start, blk->discard_size))
+		return false;
+
+	return true;
+}
+
+static int block_read_bypass(struct block_device *blk, void *buf,
+			     sector_t block, blkcnt_t num_blocks)
+{
+	int ret;
+
+	dev_vdbg(blk->dev, "%s: %llu blocks at %llu\n", __func__,
+		 num_blocks, block);
+
+	/* make sure the device has the current data for the range */
+	ret = block_sync_range(blk, block, num_blocks, false);
+	if (ret)
+		return ret;
+
+	ret = blk->ops->read(blk, buf, block, num_blocks);
+	if (ret)
+		return ret;
+
+	blk_stats_record_bypass_read(blk, num_blocks);
+
+	return 0;
+}
+
 static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 		loff_t offset, unsigned long flags)
 {
@@ -253,6 +496,17 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 
 	blocks = count >> blk->blockbits;
 
+	if (block_can_bypass(blk, buf, block, blocks)) {
+		int ret = block_read_bypass(blk, buf, block, blocks);
+		if (ret)
+			return ret;
+
+		buf += blocks << blk->blockbits;
+		block += blocks;
+		count -= blocks << blk->blockbits;
+		blocks = 0;
+	}
+
 	while (blocks) {
 		void *iobuf = block_get(blk, block);
 
@@ -292,7 +546,7 @@ static int block_put(struct block_device *blk, const void *buf, sector_t block)
 	if (block >= blk->num_blocks)
 		return -EINVAL;
 
-	data = block_get(blk, block);
+	data = __block_get(blk, block, true);
 	if (IS_ERR(data))
 		return PTR_ERR(data);
 
@@ -304,6 +558,28 @@ static int block_put(struct block_device *blk, const void *buf, sector_t block)
 	return 0;
 }
 
+static int block_write_bypass(struct block_device *blk, const void *buf,
+			      sector_t block, blkcnt_t num_blocks)
+{
+	int ret;
+
+	dev_vdbg(blk->dev, "%s: %llu blocks at %llu\n", __func__,
+		 num_blocks, block);
+
+	/* cached copies of the range would be stale after the write */
+	ret = block_sync_range(blk, block, num_blocks, true);
+	if (ret)
+		return ret;
+
+	ret = blk->ops->write(blk, buf, block, num_blocks);
+	if (ret)
+		return ret;
+
+	blk_stats_record_bypass_write(blk, num_blocks);
+
+	return 0;
+}
+
 static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 		loff_t offset, ulong flags)
 {
@@ -327,7 +603,7 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 
 	if (offset & mask) {
 		size_t now = BLOCKSIZE(blk) - (offset & mask);
-		void *iobuf = block_get(blk, block);
+		void *iobuf = __block_get(blk, block, true);
 
 		now = min(count, now);
 
@@ -346,6 +622,17 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 
 	blocks = count >> blk->blockbits;
 
+	if (block_can_bypass(blk, buf, block, blocks)) {
+		ret = block_write_bypass(blk, buf, block, blocks);
+		if (ret)
+			return ret;
+
+		buf += blocks << blk->blockbits;
+		block += blocks;
+		count -= blocks << blk->blockbits;
+		blocks = 0;
+	}
+
 	while (blocks) {
 		ret = block_put(blk, buf, block);
 		if (ret)
@@ -358,7 +645,7 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 	}
 
 	if (count) {
-		void *iobuf = block_get(blk, block);
+		void *iobuf = __block_get(blk, block, true);
 
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
@@ -403,13 +690,15 @@ static int block_op_discard_range(struct cdev *cdev, loff_t count, loff_t offset
 	blk->discard_start = offset;
 	blk->discard_size = count;
 
+	block_ra_invalidate(blk, offset >> blk->blockbits,
+			    DIV_ROUND_UP(count, BLOCKSIZE(blk)));
+
 	return 0;
 }
 
 static __maybe_unused int block_op_erase(struct cdev *cdev, loff_t count, loff_t offset)
 {
 	struct block_device *blk = cdev->priv;
-	struct chunk *chunk, *tmp;
 	int ret;
 
 	if (!blk->ops->erase)
@@ -418,14 +707,9 @@ static __maybe_unused int block_op_erase(struct cdev *cdev, loff_t count, loff_t
 	count >>= blk->blockbits;
 	offset >>= blk->blockbits;
 
-	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
-		if (region_overlap_size(offset, count, chunk->block_start, blk->rdbufsize)) {
-			ret = chunk_flush(blk, chunk);
-			if (ret < 0)
-				return ret;
-			list_move(&chunk->list, &blk->idle_blocks);
-		}
-	}
+	ret = block_sync_range(blk, offset, count, true);
+	if (ret)
+		return ret;
 
 	ret = blk->ops->erase(blk, offset, count);
 	if (ret)
@@ -447,37 +731,214 @@ static struct cdev_operations block_ops = {
 	.discard_range = block_op_discard_range,
 };
 
+static void block_cache_free(struct block_device *blk)
+{
+	struct chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+
+	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+
+	INIT_LIST_HEAD(&blk->buffered_blocks);
+	INIT_LIST_HEAD(&blk->idle_blocks);
+
+	free(blk->chunk_hash);
+	blk->chunk_hash = NULL;
+
+	/* the readahead window is a multiple of the chunk size */
+	blk->ra_len = 0;
+	blk->ra_window = 0;
+}
+
+/*
+ * Allocate the chunks and the hash index according to the currently
+ * configured cache geometry. The current cache is only replaced once
+ * all allocations succeeded, so it stays intact on -ENOMEM.
+ */
+static int block_cache_alloc(struct block_device *blk)
+{
+	struct chunk *chunk, *tmp;
+	struct hlist_head *hash;
+	unsigned int hash_bits;
+	LIST_HEAD(chunks);
+	int i;
+
+	/* hash_64() needs at least one bit */
+	hash_bits = max(ilog2(roundup_pow_of_two(blk->cache_chunks)), 1);
+	hash = xzalloc(sizeof(*hash) << hash_bits);
+
+	for (i = 0; i < blk->cache_chunks; i++) {
+		chunk = xzalloc(sizeof(*chunk));
+		chunk->data = dma_alloc(blk->cache_chunk_size);
+		if (!chunk->data) {
+			free(chunk);
+			goto err_free;
+		}
+		chunk->num = i;
+		INIT_HLIST_NODE(&chunk->hnode);
+		list_add_tail(&chunk->list, &chunks);
+	}
+
+	block_cache_free(blk);
+
+	blk->rdbufsize = blk->cache_chunk_size >> blk->blockbits;
+	blk->blkmask = blk->rdbufsize - 1;
+	blk->chunk_hash_bits = hash_bits;
+	blk->chunk_hash = hash;
+	list_splice_tail(&chunks, &blk->idle_blocks);
+
+	dev_dbg(blk->dev, "rdbufsize: %d blockbits: %d blkmask: 0x%08x chunks: %u\n",
+		blk->rdbufsize, blk->blockbits, blk->blkmask, blk->cache_chunks);
+
+	return 0;
+
+err_free:
+	list_for_each_entry_safe(chunk, tmp, &chunks, list) {
+		dma_free(chunk->data);
+		free(chunk);
+	}
+	free(hash);
+
+	return -ENOMEM;
+}
+
+static void block_ra_free(struct block_device *blk)
+{
+	dma_free(blk->ra_buf);
+	blk->ra_buf = NULL;
+	blk->ra_len = 0;
+	blk->ra_window = 0;
+}
+
+static int block_set_readahead(struct param_d *p, void *priv)
+{
+	struct block_device *blk = priv;
+
+	if (blk->readahead > SZ_16M)
+		return -EINVAL;
+
+	/* reallocated with the new size on the next sequential access */
+	block_ra_free(blk);
+
+	return 0;
+}
+
+static int block_set_cache_geometry(struct param_d *p, void *priv)
+{
+	struct block_device *blk = priv;
+	int ret;
+
+	if (!blk->cache_chunks || blk->cache_chunks > 1024)
+		return -EINVAL;
+
+	if (!is_power_of_2(blk->cache_chunk_size) ||
+	    blk->cache_chunk_size < BLOCKSIZE(blk) ||
+	    blk->cache_chunk_size > SZ_16M)
+		return -EINVAL;
+
+	/* rdbufsize still describes the old geometry here */
+	ret = writebuffer_flush(blk);
+	if (ret)
+		return ret;
+
+	/* on failure the param core restores the previous geometry */
+	return block_cache_alloc(blk);
+}
+
+/*
+ * Parameters are attached to the parent device, which may carry several
+ * block devices (e.g. MMC boot partitions or NVMe namespaces). Prefix the
+ * parameter with the part of the cdev name that distinguishes them.
+ */
+static char *block_param_name(struct block_device *blk, const char *name)
+{
+	const char *devname = dev_name(blk->dev);
+	const char *cdevname = blk->cdev.name;
+	size_t len = strlen(devname);
+
+	if (!strcmp(cdevname, devname))
+		return xstrdup(name);
+
+	if (!strncmp(cdevname, devname, len) && cdevname[len] == '.')
+		cdevname += len + 1;
+
+	return xasprintf("%s.%s", cdevname, name);
+}
+
+static void block_add_params(struct block_device *blk)
+{
+	char *name;
+
+	if (!IS_ENABLED(CONFIG_PARAMETER))
+		return;
+
+	name = block_param_name(blk, "cache_chunks");
+	blk->param_cache_chunks = dev_add_param_uint32(blk->dev, name,
+			block_set_cache_geometry, NULL,
+			&blk->cache_chunks, "%u", blk);
+	free(name);
+
+	name = block_param_name(blk, "cache_chunk_size");
+	blk->param_cache_chunk_size = dev_add_param_uint32(blk->dev, name,
+			block_set_cache_geometry, NULL,
+			&blk->cache_chunk_size, "%u", blk);
+	free(name);
+
+	name = block_param_name(blk, "readahead");
+	blk->param_readahead = dev_add_param_uint32(blk->dev, name,
+			block_set_readahead, NULL,
+			&blk->readahead, "%u", blk);
+	free(name);
+}
+
+static void block_remove_params(struct block_device *blk)
+{
+	if (!IS_ERR_OR_NULL(blk->param_cache_chunks))
+		param_remove(blk->param_cache_chunks);
+	if (!IS_ERR_OR_NULL(blk->param_cache_chunk_size))
+		param_remove(blk->param_cache_chunk_size);
+	if (!IS_ERR_OR_NULL(blk->param_readahead))
+		param_remove(blk->param_readahead);
+}
+
 int blockdevice_register(struct block_device *blk)
 {
 	loff_t size = (loff_t)blk->num_blocks * BLOCKSIZE(blk);
 	int ret;
-	int i;
 
 	blk->cdev.size = size;
 	blk->cdev.dev = blk->dev;
 	blk->cdev.ops = &block_ops;
 	blk->cdev.priv = blk;
 	blk->cdev.flags |= DEVFS_IS_BLOCK_DEV;
-	blk->rdbufsize = BUFSIZE >> blk->blockbits;
 
 	INIT_LIST_HEAD(&blk->buffered_blocks);
 	INIT_LIST_HEAD(&blk->idle_blocks);
-	blk->blkmask = blk->rdbufsize - 1;
 
-	dev_dbg(blk->dev, "rdbufsize: %d blockbits: %d blkmask: 0x%08x\n",
-		blk->rdbufsize, blk->blockbits, blk->blkmask);
-
-	if (!blk->rdbufsize) {
+	if (!blk->cache_chunks)
+		blk->cache_chunks = NUM_CHUNKS;
+	if (!blk->cache_chunk_size)
+		blk->cache_chunk_size = BUFSIZE;
+	if (blk->readahead == BLOCK_READAHEAD_DISABLED)
+		blk->readahead = 0;
+	else if (!blk->readahead)
+		blk->readahead = READAHEAD_MAX;
+	blk->ra_next = ~(sector_t)0;
+
+	if (blk->cache_chunk_size < BLOCKSIZE(blk)) {
 		pr_warn("block size of %u not supported\n", BLOCKSIZE(blk));
 		return -ENOSYS;
 	}
 
-	for (i = 0; i < 8; i++) {
-		struct chunk *chunk = xzalloc(sizeof(*chunk));
-		chunk->data = dma_alloc(BUFSIZE);
-		chunk->num = i;
-		list_add_tail(&chunk->list, &blk->idle_blocks);
-	}
+	ret = block_cache_alloc(blk);
+	if (ret)
+		return ret;
 
 	/* TODO: We currently set this to ignore ERASE_TO_FLASH, but it could
 	 * be useful to propagate the enum erase_type down into the erase
@@ -498,24 +959,19 @@ int blockdevice_register(struct block_device *blk)
 	/* Lack of partition table is unusual, but not a failure */
 	(void)parse_partition_table(blk);
 
+	block_add_params(blk);
+
 	return 0;
 }
 
 int blockdevice_unregister(struct block_device *blk)
 {
-	struct chunk *chunk, *tmp;
+	block_remove_params(blk);
 
 	writebuffer_flush(blk);
 
-	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
-
-	list_for_each_entry_safe(chunk, tmp, &blk->idle_blocks, list) {
-		dma_free(chunk->data);
-		free(chunk);
-	}
+	block_cache_free(blk);
+	block_ra_free(blk);
 
 	devfs_remove(&blk->cdev);
 	list_del(&blk->list);
@@ -166,6 +166,37 @@ static bool bootm_get_override(char **oldpath, const char *newpath)
 	return true;
 }
 
+static int bootm_load_fit_kernel(struct image_data *data,
+				 unsigned long load_address)
+{
+	void *head;
+	int ret;
+
+	ret = fit_load_image(data->os_fit, data->fit_config, "kernel",
+			     (void *)load_address, data->fit_kernel_size);
+	if (ret)
+		goto err;
+
+	/*
+	 * The image handler has already looked at the kernel header we read
+	 * in advance. Make sure it matches what we have just verified.
+	 */
+	head = xmalloc(data->fit_kernel_head_size);
+	zero_page_memcpy(head, (void *)load_address, data->fit_kernel_head_size);
+	if (memcmp(head, data->fit_kernel_head, data->fit_kernel_head_size))
+		ret = -EBADMSG;
+	free(head);
+	if (ret)
+		goto err;
+
+	return 0;
+err:
+	pr_err("Loading kernel from FIT image failed: %pe\n", ERR_PTR(ret));
+	release_sdram_region(data->os_res);
+	data->os_res = NULL;
+	return ret;
+}
+
 /*
  * bootm_load_os() - load OS to RAM
  *
@@ -200,6 +231,10 @@ int bootm_load_os(struct image_data *data, unsigned long load_address)
 				(unsigned long long)load_address + kernel_size - 1);
 			return -ENOMEM;
 		}
+
+		if (data->fit_kernel_head)
+			return bootm_load_fit_kernel(data, load_address);
+
 		zero_page_memcpy((void *)load_address, kernel, kernel_size);
 		return 0;
 	}
@@ -295,12 +330,18 @@ bootm_load_initrd(struct image_data *data, unsigned long load_address)
 		const void *initrd;
 		unsigned long initrd_size;
 
-		ret = fit_open_image(data->os_fit, data->fit_config, "ramdisk",
-				     &initrd, &initrd_size);
-		if (ret) {
-			pr_err("Cannot open ramdisk image in FIT image: %pe\n",
-					ERR_PTR(ret));
-			return ERR_PTR(ret);
+		bool stream;
+
+		stream = fit_image_is_streamable(data->os_fit, data->fit_config,
+						 "ramdisk", &initrd_size);
+		if (!stream) {
+			ret = fit_open_image(data->os_fit, data->fit_config,
+					     "ramdisk", &initrd, &initrd_size);
+			if (ret) {
+				pr_err("Cannot open ramdisk image in FIT image: %pe\n",
+						ERR_PTR(ret));
+				return ERR_PTR(ret);
+			}
 		}
 		data->initrd_res = request_sdram_region("initrd",
 				load_address, initrd_size,
@@ -312,7 +353,20 @@ bootm_load_initrd(struct image_data *data, unsigned long load_address)
 				(unsigned long long)load_address + initrd_size - 1);
 			return ERR_PTR(-ENOMEM);
 		}
-		memcpy((void *)load_address, initrd, initrd_size);
+		if (stream) {
+			ret = fit_load_image(data->os_fit, data->fit_config,
+					     "ramdisk", (void *)load_address,
+					     initrd_size);
+			if (ret) {
+				pr_err("Cannot load ramdisk image from FIT image: %pe\n",
+						ERR_PTR(ret));
+				release_sdram_region(data->initrd_res);
+				data->initrd_res = NULL;
+				return ERR_PTR(ret);
+			}
+		} else {
+			memcpy((void *)load_address, initrd, initrd_size);
+		}
 		pr_info("Loaded initrd from FIT image\n");
 		goto done1;
 	}
@@ -656,10 +710,30 @@ static int bootm_open_fit(struct image_data *data)
 		return PTR_ERR(data->fit_config);
 	}
 
-	ret = fit_open_image(data->os_fit, data->fit_config, kernel_img,
-			     &data->fit_kernel, &data->fit_kernel_size);
-	if (ret)
-		return ret;
+	if (fit_image_is_streamable(data->os_fit, data->fit_config, kernel_img,
+				    &data->fit_kernel_size)) {
+		/*
+		 * Only read the kernel header here, the kernel itself is read
+		 * or uncompressed directly to its load address in
+		 * bootm_load_os().
+		 */
+		ssize_t now;
+
+		data->fit_kernel_head = xmalloc(PAGE_SIZE);
+		now = fit_read_image_head(data->os_fit, data->fit_config,
+					  kernel_img, data->fit_kernel_head,
+					  PAGE_SIZE);
+		if (now < 0)
+			return now;
+
+		data->fit_kernel_head_size = now;
+		data->fit_kernel = data->fit_kernel_head;
+	} else {
+		ret = fit_open_image(data->os_fit, data->fit_config, kernel_img,
+				     &data->fit_kernel, &data->fit_kernel_size);
+		if (ret)
+			return ret;
+	}
 	if (data->os_address == UIMAGE_SOME_ADDRESS) {
 		ret = fit_get_image_address(data->os_fit,
 					    data->fit_config,
@@ -790,7 +864,10 @@ int bootm_boot(struct bootm_data *bootm_data)
 	switch (os_type) {
 	case filetype_oftree:
 		ret = bootm_open_fit(data);
-		os_type = file_detect_type(data->fit_kernel, data->fit_kernel_size);
+		os_type = file_detect_type(data->fit_kernel,
+					   data->fit_kernel_head ?
+					   data->fit_kernel_head_size :
+					   data->fit_kernel_size);
 		os_type_str = "FIT";
 		break;
 	case filetype_uimage:
@@ -966,6 +1043,7 @@ int bootm_boot(struct bootm_data *bootm_data)
 	globalvar_remove("linux.bootargs.bootm.earlycon");
 	globalvar_remove("linux.bootargs.bootm.appendroot");
 	free(data->os_header);
+	free(data->fit_kernel_head);
 	free(data->os_file);
 	free(data->oftree_file);
 	free(data->initrd_file);
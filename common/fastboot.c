@@ -44,12 +44,14 @@
 #include <linux/mtd/mtd.h>
 #include <fastboot.h>
 #include <system-partitions.h>
+#include <work.h>
 
 #define FASTBOOT_VERSION		"0.4"
 
 static unsigned int fastboot_max_download_size;
 static int fastboot_bbu;
 static char *fastboot_partitions;
+static char *fastboot_stream_partition;
 
 struct fb_variable {
 	char *name;
@@ -186,6 +188,466 @@ static int fastboot_add_partition_variables(struct fastboot *fb, struct list_hea
 	return ret;
 }
 
+#define FASTBOOT_STREAM_CHUNK_SIZE	SZ_256K
+#define FASTBOOT_STREAM_QUEUE_LIMIT	SZ_8M
+
+struct fastboot_stream_chunk {
+	struct list_head list;
+	size_t len;
+	u8 data[FASTBOOT_STREAM_CHUNK_SIZE];
+};
+
+/*
+ * In streaming mode the downloaded data is not stored in a temporary file,
+ * but written to the partition named in global.fastboot.stream while the
+ * download is still running. The transport hands the data to us in poller
+ * context where we can't access the partition, so it is only queued there
+ * and written by a work queue in command context. When too much data is
+ * queued the transport is asked to stall until the queue has been drained.
+ */
+struct fastboot_stream {
+	struct fastboot *fb;
+	struct work_queue wq;
+	struct work_struct work;
+	bool work_queued;
+
+	bool active;		/* a streamed download is in progress */
+	bool finished;		/* all data of the download has been received */
+	bool aborted;
+	bool stalled;		/* the transport waits for resume_download() */
+	bool done;		/* the download has been written successfully */
+	int err;
+
+	char *partition;
+	int fd;
+	bool is_reg;
+	loff_t pos;
+
+	/* the start of the image, used to detect sparse images */
+	u8 probe[sizeof(struct sparse_header)];
+	size_t probe_len;
+	bool raw;
+	struct sparse_image_stream *sparse;
+
+	struct list_head chunks;
+	size_t queued;
+};
+
+static void fastboot_stream_queue_work(struct fastboot_stream *stream)
+{
+	if (stream->work_queued)
+		return;
+
+	stream->work_queued = true;
+	wq_queue_work(&stream->wq, &stream->work);
+}
+
+static int fastboot_stream_write(void *ctx, const void *buf, loff_t pos,
+				 size_t len)
+{
+	struct fastboot_stream *stream = ctx;
+	int ret;
+
+	discard_range(stream->fd, len, pos);
+
+	if (lseek(stream->fd, pos, SEEK_SET) == -1)
+		return errno == EINVAL ? -ENOSPC : -errno;
+
+	ret = write_full(stream->fd, buf, len);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static int fastboot_stream_sparse(struct fastboot_stream *stream,
+				  const void *buf, size_t len)
+{
+	if (!IS_ENABLED(CONFIG_FASTBOOT_SPARSE))
+		return -EOPNOTSUPP;
+
+	return sparse_image_stream_write(stream->sparse, buf, len);
+}
+
+static int fastboot_stream_raw(struct fastboot_stream *stream,
+			       const void *buf, size_t len)
+{
+	int ret;
+
+	ret = fastboot_stream_write(stream, buf, stream->pos, len);
+	if (ret)
+		return ret;
+
+	stream->pos += len;
+
+	return 0;
+}
+
+/* Called once we have seen enough of the image to know its type */
+static int fastboot_stream_start(struct fastboot_stream *stream)
+{
+	struct fastboot *fb = stream->fb;
+	loff_t size;
+	int ret;
+
+	if (stream->probe_len == sizeof(stream->probe) &&
+	    is_sparse_image(stream->probe)) {
+		if (!IS_ENABLED(CONFIG_FASTBOOT_SPARSE))
+			return -EOPNOTSUPP;
+
+		stream->sparse = sparse_image_stream_new(fastboot_stream_write,
+							 stream);
+
+		/* the probe buffer holds the file header, so we know the size afterwards */
+		ret = fastboot_stream_sparse(stream, stream->probe,
+					     stream->probe_len);
+		if (ret)
+			return ret;
+
+		size = sparse_image_stream_size(stream->sparse);
+	} else {
+		stream->raw = true;
+		size = fb->download_size;
+	}
+
+	if (stream->is_reg) {
+		ret = ftruncate(stream->fd, size);
+		if (ret)
+			return ret;
+	}
+
+	if (stream->raw)
+		return fastboot_stream_raw(stream, stream->probe,
+					   stream->probe_len);
+
+	return 0;
+}
+
+static int fastboot_stream_consume(struct fastboot_stream *stream,
+				   const u8 *buf, size_t len)
+{
+	size_t now;
+	int ret;
+
+	if (!stream->raw && !stream->sparse) {
+		now = min(len, sizeof(stream->probe) - stream->probe_len);
+
+		memcpy(stream->probe + stream->probe_len, buf, now);
+		stream->probe_len += now;
+		buf += now;
+		len -= now;
+
+		if (stream->probe_len < sizeof(stream->probe))
+			return 0;
+
+		ret = fastboot_stream_start(stream);
+		if (ret)
+			return ret;
+	}
+
+	if (!len)
+		return 0;
+
+	if (stream->sparse)
+		return fastboot_stream_sparse(stream, buf, len);
+
+	return fastboot_stream_raw(stream, buf, len);
+}
+
+static int fastboot_stream_close(struct fastboot_stream *stream)
+{
+	struct fastboot_stream_chunk *chunk, *tmp;
+	int ret = 0;
+
+	list_for_each_entry_safe(chunk, tmp, &stream->chunks, list) {
+		list_del(&chunk->list);
+		free(chunk);
+	}
+
+	if (stream->sparse) {
+		sparse_image_stream_free(stream->sparse);
+		stream->sparse = NULL;
+	}
+
+	if (stream->fd >= 0) {
+		ret = close(stream->fd);
+		stream->fd = -1;
+	}
+
+	stream->queued = 0;
+	stream->active = false;
+	stream->finished = false;
+	stream->aborted = false;
+	stream->stalled = false;
+
+	return ret;
+}
+
+static void fastboot_stream_complete(struct fastboot_stream *stream)
+{
+	struct fastboot *fb = stream->fb;
+	int ret, err;
+
+	ret = stream->err;
+
+	/* images shorter than the probe buffer are raw */
+	if (!ret && !stream->raw && !stream->sparse)
+		ret = fastboot_stream_start(stream);
+
+	if (!ret && stream->sparse)
+		ret = sparse_image_stream_finish(stream->sparse);
+
+	err = fastboot_stream_close(stream);
+	if (!ret)
+		ret = err;
+
+	printf("\n");
+
+	if (ret) {
+		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL, "writing %s: %pe",
+				  stream->partition, ERR_PTR(ret));
+		return;
+	}
+
+	stream->done = true;
+
+	fastboot_tx_print(fb, FASTBOOT_MSG_INFO, "Downloading %zu bytes finished",
+			  fb->download_bytes);
+
+	fastboot_tx_print(fb, FASTBOOT_MSG_OKAY, "");
+}
+
+static struct fastboot_stream_chunk *fastboot_stream_get_chunk(struct fastboot_stream *stream)
+{
+	struct fastboot_stream_chunk *chunk;
+
+	chunk = list_first_entry_or_null(&stream->chunks,
+					 struct fastboot_stream_chunk, list);
+	if (!chunk)
+		return NULL;
+
+	/* the last chunk is still being filled */
+	if (list_is_last(&chunk->list, &stream->chunks) && !stream->finished &&
+	    !stream->aborted)
+		return NULL;
+
+	list_del(&chunk->list);
+
+	return chunk;
+}
+
+static void fastboot_stream_work(struct work_struct *work)
+{
+	struct fastboot_stream *stream = container_of(work, struct fastboot_stream, work);
+	struct fastboot *fb = stream->fb;
+	struct fastboot_stream_chunk *chunk;
+	int ret;
+
+	stream->work_queued = false;
+
+	if (!stream->active)
+		return;
+
+	while ((chunk = fastboot_stream_get_chunk(stream))) {
+		if (!stream->err && !stream->aborted) {
+			ret = fastboot_stream_consume(stream, chunk->data,
+						      chunk->len);
+			if (ret)
+				stream->err = ret;
+		}
+
+		stream->queued -= chunk->len;
+		free(chunk);
+
+		if (stream->stalled && (stream->err ||
+		    stream->queued < FASTBOOT_STREAM_QUEUE_LIMIT / 2)) {
+			stream->stalled = false;
+			fb->resume_download(fb);
+		}
+	}
+
+	if (stream->aborted)
+		fastboot_stream_close(stream);
+	else if (stream->finished)
+		fastboot_stream_complete(stream);
+}
+
+static void fastboot_stream_work_cancel(struct work_struct *work)
+{
+	struct fastboot_stream *stream = container_of(work, struct fastboot_stream, work);
+
+	stream->work_queued = false;
+}
+
+/* Forget about the last streamed download */
+static void fastboot_stream_reset(struct fastboot *fb)
+{
+	struct fastboot_stream *stream = fb->stream;
+
+	if (!stream)
+		return;
+
+	fastboot_stream_close(stream);
+
+	free(stream->partition);
+	stream->partition = NULL;
+	stream->done = false;
+	stream->err = 0;
+	stream->pos = 0;
+	stream->probe_len = 0;
+	stream->raw = false;
+}
+
+static int fastboot_stream_open(struct fastboot *fb)
+{
+	struct fastboot_stream *stream = fb->stream;
+	struct file_list_entry *fentry;
+	unsigned int flags = O_RDWR;
+	struct stat s;
+	int ret, fd;
+
+	fentry = file_list_entry_by_name(fb->files, fastboot_stream_partition);
+	if (!fentry)
+		return -ENOENT;
+
+	/* ubiformat and barebox update need the complete image */
+	if (fentry->flags & FILE_LIST_FLAG_UBI || strstarts(fentry->name, "bbu-"))
+		return -EOPNOTSUPP;
+
+	if (IS_ENABLED(CONFIG_BAREBOX_UPDATE) &&
+	    bbu_find_handler_by_device(fentry->filename))
+		return -EOPNOTSUPP;
+
+	ret = fb_file_available(fentry);
+	if (ret < 0)
+		return ret;
+	if (!ret)
+		flags |= O_CREAT;
+
+	fd = open(fentry->filename, flags);
+	if (fd < 0)
+		return -errno;
+
+	ret = fstat(fd, &s);
+	if (ret) {
+		close(fd);
+		return ret;
+	}
+
+	/* Don't leave stale data around for "fastboot boot" */
+	unlink(fb->tempname);
+
+	stream->fd = fd;
+	stream->is_reg = S_ISREG(s.st_mode);
+	stream->partition = xstrdup(fentry->name);
+	stream->active = true;
+
+	return 0;
+}
+
+static int fastboot_stream_data(struct fastboot *fb, const void *buffer,
+				unsigned int len)
+{
+	struct fastboot_stream *stream = fb->stream;
+	struct fastboot_stream_chunk *chunk;
+	size_t now;
+
+	if (stream->err)
+		return stream->err;
+
+	fb->download_bytes += len;
+
+	while (len) {
+		chunk = list_empty(&stream->chunks) ? NULL :
+			list_last_entry(&stream->chunks,
+					struct fastboot_stream_chunk, list);
+
+		if (!chunk || chunk->len == FASTBOOT_STREAM_CHUNK_SIZE) {
+			chunk = malloc(sizeof(*chunk));
+			if (!chunk)
+				return -ENOMEM;
+
+			chunk->len = 0;
+			list_add_tail(&chunk->list, &stream->chunks);
+		}
+
+		now = min_t(size_t, len, FASTBOOT_STREAM_CHUNK_SIZE - chunk->len);
+		memcpy(chunk->data + chunk->len, buffer, now);
+
+		chunk->len += now;
+		stream->queued += now;
+		buffer += now;
+		len -= now;
+	}
+
+	show_progress(fb->download_bytes);
+
+	fastboot_stream_queue_work(stream);
+
+	if (fb->resume_download && stream->queued >= FASTBOOT_STREAM_QUEUE_LIMIT &&
+	    fb->download_bytes < fb->download_size) {
+		stream->stalled = true;
+		return FASTBOOT_DOWNLOAD_STALL;
+	}
+
+	return 0;
+}
+
+/*
+ * Called for "flash:" after a streamed download. Returns true when the
+ * command has been answered.
+ */
+static bool fastboot_stream_flash(struct fastboot *fb, const char *partition)
+{
+	struct fastboot_stream *stream = fb->stream;
+
+	if (!stream || !stream->partition)
+		return false;
+
+	if (!stream->done)
+		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+				  "streaming to %s failed", stream->partition);
+	else if (strcmp(partition, stream->partition))
+		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+				  "data was streamed to %s", stream->partition);
+	else
+		fastboot_tx_print(fb, FASTBOOT_MSG_OKAY, "");
+
+	fastboot_stream_reset(fb);
+
+	return true;
+}
+
+static struct fastboot_stream *fastboot_stream_new(struct fastboot *fb)
+{
+	struct fastboot_stream *stream;
+
+	stream = xzalloc(sizeof(*stream));
+	stream->fb = fb;
+	stream->fd = -1;
+	INIT_LIST_HEAD(&stream->chunks);
+
+	stream->wq.fn = fastboot_stream_work;
+	stream->wq.cancel = fastboot_stream_work_cancel;
+	wq_register(&stream->wq);
+
+	return stream;
+}
+
+static void fastboot_stream_free(struct fastboot *fb)
+{
+	struct fastboot_stream *stream = fb->stream;
+
+	if (!stream)
+		return;
+
+	fastboot_stream_reset(fb);
+	wq_unregister(&stream->wq);
+	free(stream);
+
+	fb->stream = NULL;
+}
+
 int fastboot_generic_init(struct fastboot *fb, bool export_bbu)
 {
 	struct fb_variable *var;
@@ -205,6 +667,9 @@ int fastboot_generic_init(struct fastboot *fb, bool export_bbu)
 	if (!fb->tempname)
 		return -ENOMEM;
 
+	if (IS_ENABLED(CONFIG_FASTBOOT_STREAM))
+		fb->stream = fastboot_stream_new(fb);
+
 	if (!fb->files)
 		fb->files = file_list_new();
 	if (export_bbu)
@@ -229,6 +694,8 @@ void fastboot_generic_free(struct fastboot *fb)
 {
 	fastboot_free_variables(&fb->variables);
 
+	fastboot_stream_free(fb);
+
 	free(fb->tempname);
 
 	fb->active = false;
@@ -391,6 +858,9 @@ int fastboot_handle_download_data(struct fastboot *fb, const void *buffer,
 {
 	int ret;
 
+	if (fb->stream && fb->stream->active)
+		return fastboot_stream_data(fb, buffer, len);
+
 	ret = write(fb->download_fd, buffer, len);
 	if (ret < 0)
 		return ret;
@@ -402,6 +872,12 @@ int fastboot_handle_download_data(struct fastboot *fb, const void *buffer,
 
 void fastboot_download_finished(struct fastboot *fb)
 {
+	if (fb->stream && fb->stream->active) {
+		fb->stream->finished = true;
+		fastboot_stream_queue_work(fb->stream);
+		return;
+	}
+
 	close(fb->download_fd);
 	fb->download_fd = 0;
 
@@ -420,6 +896,12 @@ void fastboot_abort(struct fastboot *fb)
 		fb->download_fd = 0;
 	}
 
+	if (fb->stream && fb->stream->active) {
+		fb->stream->aborted = true;
+		fb->stream->stalled = false;
+		fastboot_stream_queue_work(fb->stream);
+	}
+
 	fb->active = false;
 
 	unlink(fb->tempname);
@@ -427,14 +909,30 @@ void fastboot_abort(struct fastboot *fb)
 
 static void cb_download(struct fastboot *fb, const char *cmd)
 {
+	int ret;
+
 	fb->download_size = simple_strtoul(cmd, NULL, 16);
 	fb->download_bytes = 0;
 
+	fastboot_stream_reset(fb);
+
 	fastboot_tx_print(fb, FASTBOOT_MSG_INFO, "Downloading %zu bytes...",
 			  fb->download_size);
 
 	init_progression_bar(fb->download_size);
 
+	if (fb->stream && fastboot_stream_partition && *fastboot_stream_partition) {
+		ret = fastboot_stream_open(fb);
+		if (ret) {
+			fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
+					  "cannot stream to %s: %pe",
+					  fastboot_stream_partition, ERR_PTR(ret));
+			return;
+		}
+
+		goto start;
+	}
+
 	if (fb->download_fd > 0) {
 		pr_err("%s called and %s is still opened\n", __func__, fb->tempname);
 		close(fb->download_fd);
@@ -446,6 +944,7 @@ static void cb_download(struct fastboot *fb, const char *cmd)
 			return;
 	}
 
+start:
 	if (!fb->download_size)
 		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL,
 					  "data invalid size");
@@ -687,6 +1186,9 @@ static void cb_flash(struct fastboot *fb, const char *cmd)
 	const char *filename = NULL;
 	enum filetype filetype;
 
+	if (fastboot_stream_flash(fb, cmd))
+		return;
+
 	ret = file_name_detect_type(fb->tempname, &filetype);
 	if (ret) {
 		fastboot_tx_print(fb, FASTBOOT_MSG_FAIL, "internal error");
@@ -1045,6 +1547,10 @@ static int fastboot_globalvars_init(void)
 				 &fastboot_max_download_size, "%u");
 	}
 
+	if (IS_ENABLED(CONFIG_FASTBOOT_STREAM))
+		globalvar_add_simple_string("fastboot.stream",
+					    &fastboot_stream_partition);
+
 	globalvar_add_simple_bool("fastboot.bbu", &fastboot_bbu);
 	globalvar_add_simple_string("fastboot.partitions",
 				    &fastboot_partitions);
@@ -1067,3 +1573,5 @@ BAREBOX_MAGICVAR(global.fastboot.partitions,
 		       "Partitions exported for update via fastboot");
 BAREBOX_MAGICVAR(global.fastboot.bbu,
 		       "Export barebox update handlers via fastboot");
+BAREBOX_MAGICVAR(global.fastboot.stream,
+		 "Partition to write downloads to while they are received");
@@ -24,6 +24,8 @@
 #include <crypto/public_key.h>
 #include <uncompress.h>
 #include <image-fit.h>
+#include <zero_page.h>
+#include <linux/sizes.h>
 #include <fuzz.h>
 
 #define FDT_MAX_DEPTH 32
@@ -374,15 +376,21 @@ static int fit_verify_signature(struct fit_handle *handle, struct device_node *s
 	return ret;
 }
 
-static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
-			   const void *data, int data_len)
+/*
+ * Look up the hash node of @image and prepare a digest for it. On success
+ * *@outd is NULL when there is nothing to verify, otherwise the caller feeds
+ * the image data into it and passes it on to fit_hash_finish().
+ */
+static int fit_hash_start(struct fit_handle *handle, struct device_node *image,
+			  struct digest **outd, struct device_node **outhash)
 {
 	struct digest *d;
 	const char *algo;
-	const char *value_read;
 	int hash_len, ret;
 	struct device_node *hash;
 
+	*outd = NULL;
+
 	switch (handle->verify) {
 	case BOOTM_VERIFY_NONE:
 		return 0;
@@ -402,8 +410,7 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 		return ret;
 	}
 
-	value_read = of_get_property(hash, "value", &hash_len);
-	if (!value_read) {
+	if (!of_get_property(hash, "value", &hash_len)) {
 		pr_err("%pOF: \"value\" property not found\n", hash);
 		return -EINVAL;
 	}
@@ -421,12 +428,25 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 
 	if (hash_len != digest_length(d)) {
 		pr_err("%pOF: invalid hash length %d\n", hash, hash_len);
-		ret = -EINVAL;
-		goto err_digest_free;
+		digest_free(d);
+		return -EINVAL;
 	}
 
 	digest_init(d);
-	digest_update(d, data, data_len);
+
+	*outd = d;
+	*outhash = hash;
+
+	return 0;
+}
+
+static int fit_hash_finish(struct fit_handle *handle, struct device_node *hash,
+			   struct digest *d)
+{
+	const char *value_read;
+	int ret;
+
+	value_read = of_get_property(hash, "value", NULL);
 
 	if (digest_verify(d, value_read)) {
 		pr_err("%pOF: hash BAD\n", hash);
@@ -437,12 +457,27 @@ static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
 		ret = 0;
 	}
 
-err_digest_free:
 	digest_free(d);
 
 	return ret;
 }
 
+static int fit_verify_hash(struct fit_handle *handle, struct device_node *image,
+			   const void *data, int data_len)
+{
+	struct device_node *hash;
+	struct digest *d;
+	int ret;
+
+	ret = fit_hash_start(handle, image, &d, &hash);
+	if (ret || !d)
+		return ret;
+
+	digest_update(d, data, data_len);
+
+	return fit_hash_finish(handle, hash, d);
+}
+
 static int fit_image_verify_signature(struct fit_handle *handle,
 				      struct device_node *image,
 				      const void *data, int data_len)
@@ -542,6 +577,130 @@ fit_get_image(struct fit_handle *handle, void *configuration,
 	return 0;
 }
 
+/*
+ * FIT images created with "mkimage -E" do not embed the image data in the
+ * FDT, but append it after the FDT. "data-offset" is relative to the 4 byte
+ * aligned end of the FDT, "data-position" is an absolute file offset.
+ */
+static int fit_get_external_data(struct fit_handle *handle,
+				 struct device_node *image,
+				 loff_t *pos, unsigned long *size)
+{
+	const struct fdt_header *fdt = handle->fit;
+	u32 offset, len;
+
+	if (of_property_read_u32(image, "data-size", &len))
+		return -ENOENT;
+
+	if (!of_property_read_u32(image, "data-position", &offset))
+		*pos = offset;
+	else if (!of_property_read_u32(image, "data-offset", &offset))
+		*pos = ALIGN(fdt32_to_cpu(fdt->totalsize), 4) + (loff_t)offset;
+	else
+		return -ENOENT;
+
+	*size = len;
+
+	return 0;
+}
+
+/*
+ * Read external image data. Data that has already been read along with the
+ * FDT is taken from the buffer, everything else is read from the file the
+ * FIT image was opened from.
+ */
+static int fit_read_external(struct fit_handle *handle, int fd, void *buf,
+			     loff_t pos, size_t len)
+{
+	int ret;
+
+	if (pos + len <= handle->size) {
+		memcpy(buf, handle->fit + pos, len);
+		return 0;
+	}
+
+	if (fd < 0)
+		return -EINVAL;
+
+	ret = pread_full(fd, buf, len, pos);
+	if (ret < 0)
+		return ret;
+	if (ret < len)
+		return -ENODATA;
+
+	return 0;
+}
+
+static int fit_open_external(struct fit_handle *handle, loff_t end)
+{
+	int fd;
+
+	if (end <= handle->size || !handle->filename)
+		return -ENOENT;
+
+	fd = open(handle->filename, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	return fd;
+}
+
+static const void *fit_get_image_data(struct fit_handle *handle,
+				      struct device_node *image, int *data_len)
+{
+	const void *data;
+	struct property *pp;
+	unsigned long size;
+	loff_t pos;
+	void *buf;
+	int fd, ret;
+
+	data = of_get_property(image, "data", data_len);
+	if (data)
+		return data;
+
+	pp = of_find_property(image, "$external-data", NULL);
+	if (pp)
+		goto out;
+
+	ret = fit_get_external_data(handle, image, &pos, &size);
+	if (ret)
+		return ERR_PTR(ret);
+
+	if (size > INT_MAX)
+		return ERR_PTR(-EFBIG);
+
+	fd = fit_open_external(handle, pos + size);
+
+	buf = malloc(size);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto err_close;
+	}
+
+	ret = fit_read_external(handle, fd, buf, pos, size);
+	if (ret) {
+		free(buf);
+		goto err_close;
+	}
+
+	if (fd >= 0)
+		close(fd);
+
+	/* associate buffer with FIT, so it's not leaked */
+	pp = __of_new_property(image, "$external-data", buf, size);
+out:
+	*data_len = pp->length;
+
+	return of_property_get_value(pp);
+
+err_close:
+	if (fd >= 0)
+		close(fd);
+
+	return ERR_PTR(ret);
+}
+
 /**
  * fit_get_image_address - Get an address from an image in a FIT image
  * @handle: The FIT image handle
@@ -644,6 +803,61 @@ static int fit_handle_decompression(struct device_node *image,
 	return 0;
 }
 
+/*
+ * Find the image @name, get its (still compressed) data and verify it. This
+ * is fit_open_image() without the decompression step.
+ */
+static int fit_open_image_data(struct fit_handle *handle, void *configuration,
+			       const char *name, struct device_node **outimage,
+			       const char **outtype, const void **outdata,
+			       int *outlen)
+{
+	struct device_node *image;
+	const char *unit = name, *type = NULL, *desc= "(no description)";
+	const void *data;
+	int data_len;
+	int ret = 0;
+
+	ret = fit_get_image(handle, configuration, &unit, &image);
+	if (ret)
+		return ret;
+
+	of_property_read_string(image, "description", &desc);
+	if (handle->verbose)
+		pr_info("image '%s': '%s'\n", unit, desc);
+
+	of_property_read_string(image, "type", &type);
+	if (!type) {
+		pr_err("No \"type\" property found in %pOF\n", image);
+		return -EINVAL;
+	}
+
+	data = fit_get_image_data(handle, image, &data_len);
+	if (IS_ERR(data)) {
+		if (PTR_ERR(data) == -ENOENT) {
+			pr_err("data not found\n");
+			return -EINVAL;
+		}
+		pr_err("Cannot read data of %pOF: %pe\n", image, data);
+		return PTR_ERR(data);
+	}
+
+	if (configuration)
+		ret = fit_verify_hash(handle, image, data, data_len);
+	else
+		ret = fit_image_verify_signature(handle, image, data, data_len);
+
+	if (ret < 0)
+		return ret;
+
+	*outimage = image;
+	*outtype = type;
+	*outdata = data;
+	*outlen = data_len;
+
+	return 0;
+}
+
 /**
  * fit_open_image - Open an image in a FIT image
  * @handle: The FIT image handle
@@ -666,49 +880,306 @@ int fit_open_image(struct fit_handle *handle, void *configuration,
 		   unsigned long *outsize)
 {
 	struct device_node *image;
-	const char *unit = name, *type = NULL, *desc= "(no description)";
+	const char *type;
 	const void *data;
 	int data_len;
-	int ret = 0;
+	int ret;
 
-	ret = fit_get_image(handle, configuration, &unit, &image);
+	ret = fit_open_image_data(handle, configuration, name, &image, &type,
+				  &data, &data_len);
 	if (ret)
 		return ret;
 
-	of_property_read_string(image, "description", &desc);
-	if (handle->verbose)
-		pr_info("image '%s': '%s'\n", unit, desc);
+	ret = fit_handle_decompression(image, type, &data, &data_len);
+	if (ret)
+		return ret;
+
+	*outdata = data;
+	*outsize = data_len;
+
+	return 0;
+}
+
+/*
+ * Compressed images (other than ramdisks) can be uncompressed directly to
+ * their destination when we know their uncompressed size beforehand.
+ */
+static bool fit_image_uncompress_direct(struct device_node *image,
+					const char *type)
+{
+	return IS_ENABLED(CONFIG_UNCOMPRESS) && get_compression_type(image) &&
+		strcmp(type, "ramdisk");
+}
+
+/**
+ * fit_image_is_streamable - check if an image can be streamed from a FIT image
+ * @handle: The FIT image handle
+ * @configuration: The cookie returned from fit_open_configuration()
+ * @name: The name of the image
+ * @outsize: Size of the image data
+ *
+ * Check if the image @name can be loaded with fit_load_image() directly to its
+ * final location without keeping a copy of the whole (uncompressed) image in
+ * memory. This is the case for:
+ *
+ * - Compressed images with a known uncompressed size. These are uncompressed
+ *   directly to their destination.
+ * - Uncompressed images that are stored outside of the FDT ("mkimage -E") and
+ *   opened as part of a configuration. These are read in chunks to their
+ *   destination and their hash is calculated while reading.
+ *
+ * Return: true if the image can be streamed, false otherwise
+ */
+bool fit_image_is_streamable(struct fit_handle *handle, void *configuration,
+			     const char *name, unsigned long *outsize)
+{
+	struct device_node *image;
+	const char *unit = name, *type = NULL;
+	unsigned long size;
+	const void *data;
+	int data_len;
+	ssize_t len;
+	loff_t pos;
+
+	if (fit_get_image(handle, configuration, &unit, &image))
+		return false;
 
 	of_property_read_string(image, "type", &type);
-	if (!type) {
-		pr_err("No \"type\" property found in %pOF\n", image);
-		return -EINVAL;
-	}
+	if (!type)
+		return false;
 
-	data = of_get_property(image, "data", &data_len);
-	if (!data) {
-		pr_err("data not found\n");
-		return -EINVAL;
+	if (fit_image_uncompress_direct(image, type)) {
+		data = fit_get_image_data(handle, image, &data_len);
+		if (IS_ERR(data))
+			return false;
+
+		len = uncompress_get_size(data, data_len);
+		if (len < 0)
+			return false;
+
+		*outsize = len;
+
+		return true;
 	}
 
-	if (configuration)
-		ret = fit_verify_hash(handle, image, data, data_len);
-	else
-		ret = fit_image_verify_signature(handle, image, data, data_len);
+	if (!configuration || !handle->filename)
+		return false;
 
-	if (ret < 0)
+	if (of_find_property(image, "data", NULL))
+		return false;
+
+	/* compression is ignored for ramdisks, see fit_handle_decompression() */
+	if (get_compression_type(image) && strcmp(type, "ramdisk"))
+		return false;
+
+	if (fit_get_external_data(handle, image, &pos, &size))
+		return false;
+
+	*outsize = size;
+
+	return true;
+}
+
+static void fit_uncompress_silent_fn(char *x)
+{
+}
+
+/**
+ * fit_read_image_head - read the beginning of a streamable image
+ * @handle: The FIT image handle
+ * @configuration: The cookie returned from fit_open_configuration()
+ * @name: The name of the image
+ * @buf: The buffer to read to
+ * @len: The maximum number of bytes to read
+ *
+ * This reads the first bytes of an image for which fit_image_is_streamable()
+ * returned true, so that the image type can be detected before the image is
+ * loaded. Compressed images are verified like in fit_open_image() before they
+ * are uncompressed as far as necessary, so the decompressor never sees
+ * unverified data. Uncompressed external data is returned as read, it is
+ * verified when the image is loaded.
+ *
+ * Return: The number of bytes read or a negative error code
+ */
+ssize_t fit_read_image_head(struct fit_handle *handle, void *configuration,
+			    const char *name, void *buf, size_t len)
+{
+	struct device_node *image;
+	const char *unit = name, *type = NULL;
+	unsigned long size;
+	const void *data;
+	int data_len;
+	ssize_t now;
+	loff_t pos;
+	int fd, ret;
+
+	ret = fit_get_image(handle, configuration, &unit, &image);
+	if (ret)
 		return ret;
 
-	ret = fit_handle_decompression(image, type, &data, &data_len);
+	of_property_read_string(image, "type", &type);
+	if (type && fit_image_uncompress_direct(image, type)) {
+		ret = fit_open_image_data(handle, configuration, name, &image,
+					  &type, &data, &data_len);
+		if (ret)
+			return ret;
+
+		/* we are only interested in the first @len bytes */
+		now = uncompress_buf_to_fixed_buf(data, data_len, buf, len,
+						  fit_uncompress_silent_fn);
+		return now == -ENOSPC ? len : now;
+	}
+
+	ret = fit_get_external_data(handle, image, &pos, &size);
 	if (ret)
 		return ret;
 
-	*outdata = data;
-	*outsize = data_len;
+	len = min_t(unsigned long, len, size);
+
+	fd = fit_open_external(handle, pos + len);
+
+	ret = fit_read_external(handle, fd, buf, pos, len);
+
+	if (fd >= 0)
+		close(fd);
+
+	return ret ? ret : len;
+}
+
+static int fit_load_image_uncompress(struct fit_handle *handle,
+				     void *configuration, const char *name,
+				     void *dest, unsigned long size)
+{
+	struct device_node *image;
+	const char *type;
+	const void *data;
+	int data_len;
+	ssize_t len;
+	int ret;
+
+	ret = fit_open_image_data(handle, configuration, name, &image, &type,
+				  &data, &data_len);
+	if (ret)
+		return ret;
+
+	len = uncompress_buf_to_fixed_buf(data, data_len, dest, size,
+					  fit_uncompress_error_fn);
+	if (len < 0) {
+		pr_err("%s data couldn't be decompressed: %pe\n",
+		       get_compression_type(image), ERR_PTR(len));
+		return len;
+	}
 
 	return 0;
 }
 
+#define FIT_STREAM_CHUNK	SZ_1M
+
+/**
+ * fit_load_image - load an image from a FIT image to a given location
+ * @handle: The FIT image handle
+ * @configuration: The cookie returned from fit_open_configuration()
+ * @name: The name of the image
+ * @dest: The location to load the image to
+ * @size: The size available at @dest
+ *
+ * This loads the image @name to @dest. Streamable images (see
+ * fit_image_is_streamable()) are uncompressed or read directly to @dest, all
+ * other images are opened with fit_open_image() and copied to @dest. @dest may
+ * be located in the zero page.
+ *
+ * Return: 0 for success, negative error code otherwise. On failure the
+ * contents of @dest are undefined.
+ */
+int fit_load_image(struct fit_handle *handle, void *configuration,
+		   const char *name, void *dest, unsigned long size)
+{
+	struct device_node *image, *hash = NULL;
+	const char *unit = name, *desc = "(no description)", *type = NULL;
+	unsigned long len, done, now;
+	struct digest *d;
+	void *bounce = NULL;
+	loff_t pos;
+	int fd, ret;
+
+	if (!fit_image_is_streamable(handle, configuration, name, &len)) {
+		const void *data;
+
+		ret = fit_open_image(handle, configuration, name, &data, &len);
+		if (ret)
+			return ret;
+		if (len > size)
+			return -ENOSPC;
+
+		zero_page_memcpy(dest, data, len);
+
+		return 0;
+	}
+
+	if (len > size)
+		return -ENOSPC;
+
+	ret = fit_get_image(handle, configuration, &unit, &image);
+	if (ret)
+		return ret;
+
+	of_property_read_string(image, "type", &type);
+	if (type && fit_image_uncompress_direct(image, type))
+		return fit_load_image_uncompress(handle, configuration, name,
+						 dest, size);
+
+	of_property_read_string(image, "description", &desc);
+	if (handle->verbose)
+		pr_info("image '%s': '%s'\n", unit, desc);
+
+	ret = fit_get_external_data(handle, image, &pos, &len);
+	if (ret)
+		return ret;
+
+	ret = fit_hash_start(handle, image, &d, &hash);
+	if (ret)
+		return ret;
+
+	fd = fit_open_external(handle, pos + len);
+
+	for (done = 0; done < len; done += now) {
+		unsigned long adr = (unsigned long)dest + done;
+		void *buf = dest + done;
+
+		now = min_t(unsigned long, len - done, FIT_STREAM_CHUNK);
+
+		if (zero_page_contains(adr)) {
+			if (!bounce)
+				bounce = xmalloc(PAGE_SIZE);
+			now = min_t(unsigned long, now, PAGE_SIZE - adr);
+			buf = bounce;
+		}
+
+		ret = fit_read_external(handle, fd, buf, pos + done, now);
+		if (ret)
+			goto out;
+
+		if (d)
+			digest_update(d, buf, now);
+
+		if (buf == bounce)
+			zero_page_memcpy(dest + done, bounce, now);
+	}
+
+	if (d) {
+		ret = fit_hash_finish(handle, hash, d);
+		d = NULL;
+	}
+out:
+	if (fd >= 0)
+		close(fd);
+	free(bounce);
+	if (d)
+		digest_free(d);
+
+	return ret;
+}
+
 int fit_config_verify_signature(struct fit_handle *handle, struct device_node *conf_node)
 {
 	struct device_node *sig_node;
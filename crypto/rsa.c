@@ -30,40 +30,75 @@
 #define RSA_MIN_KEY_BITS	1024
 #define RSA_MAX_KEY_BITS	4096
 
+/*
+ * The Montgomery arithmetic below works on native machine words. 64-bit
+ * limbs need a 128-bit type for the double-width products, so fall back
+ * to 32-bit limbs where the compiler has none.
+ */
+#if BITS_PER_LONG == 64 && defined(__SIZEOF_INT128__)
+typedef uint64_t rsa_limb_t;
+typedef unsigned __int128 rsa_dlimb_t;
+#else
+typedef uint32_t rsa_limb_t;
+typedef uint64_t rsa_dlimb_t;
+#endif
+
+#define RSA_LIMB_BITS		(sizeof(rsa_limb_t) * 8)
+#define RSA_LIMB_WORDS		(sizeof(rsa_limb_t) / sizeof(uint32_t))
+#define RSA_MAX_LIMBS		(RSA_MAX_KEY_BITS / RSA_LIMB_BITS)
+
+/* Maximum sliding window size, see pow_mod_window_bits() */
+#define RSA_MAX_WINDOW_BITS	3
+
+/**
+ * struct rsa_mont - Montgomery constants of a key in native limbs
+ *
+ * @len:	Number of limbs in @modulus and @rr
+ * @n0inv:	-1 / modulus[0] mod 2^RSA_LIMB_BITS
+ * @modulus:	Modulus as little endian limb array
+ * @rr:		R^2 mod modulus with R = 2^(len * RSA_LIMB_BITS)
+ */
+struct rsa_mont {
+	uint len;
+	rsa_limb_t n0inv;
+	rsa_limb_t modulus[RSA_MAX_LIMBS];
+	rsa_limb_t rr[RSA_MAX_LIMBS];
+};
+
 /**
  * subtract_modulus() - subtract modulus from the given value
  *
- * @key:	Key containing modulus to subtract
- * @num:	Number to subtract modulus from, as little endian word array
+ * @m:		Montgomery constants containing modulus to subtract
+ * @num:	Number to subtract modulus from, as little endian limb array
  */
-static void subtract_modulus(const struct rsa_public_key *key, uint32_t num[])
+static void subtract_modulus(const struct rsa_mont *m, rsa_limb_t num[])
 {
-	int64_t acc = 0;
+	rsa_limb_t borrow = 0, n;
 	uint i;
 
-	for (i = 0; i < key->len; i++) {
-		acc += (uint64_t)num[i] - key->modulus[i];
-		num[i] = (uint32_t)acc;
-		acc >>= 32;
+	for (i = 0; i < m->len; i++) {
+		n = num[i] - m->modulus[i] - borrow;
+		borrow = borrow ? n >= num[i] : n > num[i];
+		num[i] = n;
 	}
 }
 
 /**
  * greater_equal_modulus() - check if a value is >= modulus
  *
- * @key:	Key containing modulus to check
- * @num:	Number to check against modulus, as little endian word array
+ * @m:		Montgomery constants containing modulus to check
+ * @num:	Number to check against modulus, as little endian limb array
  * @return 0 if num < modulus, 1 if num >= modulus
  */
-static int greater_equal_modulus(const struct rsa_public_key *key,
-				 uint32_t num[])
+static int greater_equal_modulus(const struct rsa_mont *m,
+				 const rsa_limb_t num[])
 {
 	int i;
 
-	for (i = (int)key->len - 1; i >= 0; i--) {
-		if (num[i] < key->modulus[i])
+	for (i = (int)m->len - 1; i >= 0; i--) {
+		if (num[i] < m->modulus[i])
 			return 0;
-		if (num[i] > key->modulus[i])
+		if (num[i] > m->modulus[i])
 			return 1;
 	}
 
@@ -75,34 +110,36 @@ static int greater_equal_modulus(const struct rsa_public_key *key,
  *
  * Operation: montgomery result[] += a * b[] / n0inv % modulus
  *
- * @key:	RSA key
- * @result:	Place to put result, as little endian word array
+ * @m:		Montgomery constants
+ * @result:	Place to put result, as little endian limb array
  * @a:		Multiplier
- * @b:		Multiplicand, as little endian word array
+ * @b:		Multiplicand, as little endian limb array
  */
-static void montgomery_mul_add_step(const struct rsa_public_key *key,
-		uint32_t result[], const uint32_t a, const uint32_t b[])
+static void montgomery_mul_add_step(const struct rsa_mont *m,
+		rsa_limb_t result[], const rsa_limb_t a, const rsa_limb_t b[])
 {
-	uint64_t acc_a, acc_b;
-	uint32_t d0;
+	rsa_dlimb_t acc_a, acc_b;
+	rsa_limb_t d0;
 	uint i;
 
-	acc_a = (uint64_t)a * b[0] + result[0];
-	d0 = (uint32_t)acc_a * key->n0inv;
-	acc_b = (uint64_t)d0 * key->modulus[0] + (uint32_t)acc_a;
-	for (i = 1; i < key->len; i++) {
-		acc_a = (acc_a >> 32) + (uint64_t)a * b[i] + result[i];
-		acc_b = (acc_b >> 32) + (uint64_t)d0 * key->modulus[i] +
-				(uint32_t)acc_a;
-		result[i - 1] = (uint32_t)acc_b;
+	acc_a = (rsa_dlimb_t)a * b[0] + result[0];
+	d0 = (rsa_limb_t)acc_a * m->n0inv;
+	acc_b = (rsa_dlimb_t)d0 * m->modulus[0] + (rsa_limb_t)acc_a;
+	for (i = 1; i < m->len; i++) {
+		acc_a = (acc_a >> RSA_LIMB_BITS) + (rsa_dlimb_t)a * b[i] +
+				result[i];
+		acc_b = (acc_b >> RSA_LIMB_BITS) +
+				(rsa_dlimb_t)d0 * m->modulus[i] +
+				(rsa_limb_t)acc_a;
+		result[i - 1] = (rsa_limb_t)acc_b;
 	}
 
-	acc_a = (acc_a >> 32) + (acc_b >> 32);
+	acc_a = (acc_a >> RSA_LIMB_BITS) + (acc_b >> RSA_LIMB_BITS);
 
-	result[i - 1] = (uint32_t)acc_a;
+	result[i - 1] = (rsa_limb_t)acc_a;
 
-	if (acc_a >> 32)
-		subtract_modulus(key, result);
+	if (acc_a >> RSA_LIMB_BITS)
+		subtract_modulus(m, result);
 }
 
 /**
@@ -110,20 +147,74 @@ static void montgomery_mul_add_step(const struct rsa_public_key *key,
  *
  * Operation: montgomery result[] = a[] * b[] / n0inv % modulus
  *
- * @key:	RSA key
- * @result:	Place to put result, as little endian word array
- * @a:		Multiplier, as little endian word array
- * @b:		Multiplicand, as little endian word array
+ * @m:		Montgomery constants
+ * @result:	Place to put result, as little endian limb array
+ * @a:		Multiplier, as little endian limb array
+ * @b:		Multiplicand, as little endian limb array
  */
-static void montgomery_mul(const struct rsa_public_key *key,
-		uint32_t result[], uint32_t a[], const uint32_t b[])
+static void montgomery_mul(const struct rsa_mont *m,
+		rsa_limb_t result[], const rsa_limb_t a[], const rsa_limb_t b[])
 {
 	uint i;
 
-	for (i = 0; i < key->len; ++i)
+	for (i = 0; i < m->len; ++i)
 		result[i] = 0;
-	for (i = 0; i < key->len; ++i)
-		montgomery_mul_add_step(key, result, a[i], b);
+	for (i = 0; i < m->len; ++i)
+		montgomery_mul_add_step(m, result, a[i], b);
+}
+
+/**
+ * rsa_mont_init() - Convert key to Montgomery constants in native limbs
+ *
+ * @m:		Montgomery constants to fill in
+ * @key:	RSA key
+ */
+static void rsa_mont_init(struct rsa_mont *m, const struct rsa_public_key *key)
+{
+	rsa_limb_t inv, top;
+	uint i;
+
+	m->len = DIV_ROUND_UP(key->len, RSA_LIMB_WORDS);
+
+	memset(m->modulus, 0, sizeof(m->modulus));
+	memset(m->rr, 0, sizeof(m->rr));
+
+	for (i = 0; i < key->len; i++) {
+		uint shift = (i % RSA_LIMB_WORDS) * 32;
+
+		m->modulus[i / RSA_LIMB_WORDS] |= (rsa_limb_t)key->modulus[i] << shift;
+		m->rr[i / RSA_LIMB_WORDS] |= (rsa_limb_t)key->rr[i] << shift;
+	}
+
+	/*
+	 * Newton iteration for 1 / modulus[0]: an odd number is its own
+	 * inverse modulo 8 and each step doubles the number of valid bits.
+	 */
+	inv = m->modulus[0];
+	for (i = 3; i < RSA_LIMB_BITS; i *= 2)
+		inv *= 2 - m->modulus[0] * inv;
+
+	m->n0inv = -inv;
+
+	/*
+	 * rr is provided for R = 2^(32 * key->len). With a modulus that does
+	 * not fill the last limb, R is larger by 2^32, so R^2 by 2^64.
+	 */
+	for (i = key->len * 32; i < m->len * RSA_LIMB_BITS; i += 32) {
+		uint j, k;
+
+		for (k = 0; k < 64; k++) {
+			top = m->rr[m->len - 1] >> (RSA_LIMB_BITS - 1);
+
+			for (j = m->len - 1; j > 0; j--)
+				m->rr[j] = m->rr[j] << 1 |
+					   m->rr[j - 1] >> (RSA_LIMB_BITS - 1);
+			m->rr[0] <<= 1;
+
+			if (top || greater_equal_modulus(m, m->rr))
+				subtract_modulus(m, m->rr);
+		}
+	}
 }
 
 /**
@@ -165,7 +256,20 @@ static int num_public_exponent_bits(const struct rsa_public_key *key,
 static int is_public_exponent_bit_set(const struct rsa_public_key *key,
 		int pos)
 {
-	return key->exponent & (1ULL << pos);
+	return (key->exponent >> pos) & 1;
+}
+
+/**
+ * pow_mod_window_bits() - Sliding window size for the public exponent
+ *
+ * @num_bits:	Number of bits in the public exponent
+ *
+ * Precomputing the odd powers only pays off for long exponents. The
+ * common 65537 is best served by plain square-and-multiply (window of 1).
+ */
+static int pow_mod_window_bits(int num_bits)
+{
+	return num_bits > 23 ? RSA_MAX_WINDOW_BITS : 1;
 }
 
 /**
@@ -177,11 +281,15 @@ static int is_public_exponent_bit_set(const struct rsa_public_key *key,
 static int pow_mod(const struct rsa_public_key *key, void *__inout)
 {
 	uint32_t *inout = __inout;
-	uint32_t *result, *ptr;
+	uint32_t *ptr;
+	const struct rsa_mont *m = key->mont;
+	struct rsa_mont mont;
 	uint i;
-	int j, k;
-	uint32_t val[RSA_MAX_KEY_BITS / 32], acc[RSA_MAX_KEY_BITS / 32], tmp[RSA_MAX_KEY_BITS / 32];
-	uint32_t a_scaled[RSA_MAX_KEY_BITS / 32];
+	int j, k, l, w;
+	rsa_limb_t val[RSA_MAX_LIMBS], buf1[RSA_MAX_LIMBS], buf2[RSA_MAX_LIMBS];
+	rsa_limb_t table[1 << (RSA_MAX_WINDOW_BITS - 1)][RSA_MAX_LIMBS];
+	rsa_limb_t *acc = buf1, *tmp = buf2;
+	bool first = true, scaled = true;
 
 	/* Sanity check for stack size - key->len is in 32-bit words */
 	if (key->len > RSA_MAX_KEY_BITS / 32) {
@@ -190,11 +298,16 @@ static int pow_mod(const struct rsa_public_key *key, void *__inout)
 		return -EINVAL;
 	}
 
-	result = tmp;  /* Re-use location. */
+	if (!m) {
+		rsa_mont_init(&mont, key);
+		m = &mont;
+	}
 
-	/* Convert from big endian byte array to little endian word array. */
+	/* Convert from big endian byte array to little endian limb array. */
+	memset(val, 0, m->len * sizeof(val[0]));
 	for (i = 0, ptr = inout + key->len - 1; i < key->len; i++, ptr--)
-		val[i] = get_unaligned_be32(ptr);
+		val[i / RSA_LIMB_WORDS] |= (rsa_limb_t)get_unaligned_be32(ptr) <<
+					   ((i % RSA_LIMB_WORDS) * 32);
 
 	if (0 != num_public_exponent_bits(key, &k))
 		return -EINVAL;
@@ -210,35 +323,73 @@ static int pow_mod(const struct rsa_public_key *key, void *__inout)
 		return -EINVAL;
 	}
 
-	/* the bit at e[k-1] is 1 by definition, so start with: C := M */
-	montgomery_mul(key, acc, val, key->rr); /* acc = a * RR / R mod n */
-	/* retain scaled version for intermediate use */
-	memcpy(a_scaled, acc, key->len * sizeof(a_scaled[0]));
+	w = pow_mod_window_bits(k);
+
+	/* table[u] = a^(2u+1) * R mod n */
+	montgomery_mul(m, table[0], val, m->rr); /* a * RR / R mod n */
+	if (w > 1) {
+		montgomery_mul(m, tmp, table[0], table[0]);
+		for (i = 1; i < 1 << (w - 1); i++)
+			montgomery_mul(m, table[i], table[i - 1], tmp);
+	}
+
+	/* left-to-right, the window starting at e[k-1] is the first one */
+	for (j = k - 1; j >= 0; j = l - 1) {
+		uint u = 0;
+
+		if (!is_public_exponent_bit_set(key, j)) {
+			montgomery_mul(m, tmp, acc, acc); /* tmp = acc^2 / R mod n */
+			swap(acc, tmp);
+			l = j;
+			continue;
+		}
 
-	for (j = k - 2; j > 0; --j) {
-		montgomery_mul(key, tmp, acc, acc); /* tmp = acc^2 / R mod n */
+		/* the longest window e[j..l] ending in a set bit */
+		l = max(j - w + 1, 0);
+		while (!is_public_exponent_bit_set(key, l))
+			l++;
+
+		for (i = j; (int)i >= l; i--) {
+			u = u << 1 | is_public_exponent_bit_set(key, i);
+			if (!first) {
+				montgomery_mul(m, tmp, acc, acc);
+				swap(acc, tmp);
+			}
+		}
 
-		if (is_public_exponent_bit_set(key, j)) {
-			/* acc = tmp * val / R mod n */
-			montgomery_mul(key, acc, tmp, a_scaled);
+		if (first) {
+			memcpy(acc, table[u >> 1], m->len * sizeof(acc[0]));
+			first = false;
+		} else if (l == 0 && u == 1) {
+			/*
+			 * e[0] is always 1. Multiplying by the unscaled value
+			 * also converts out of the Montgomery domain:
+			 * acc = tmp * a / R mod M
+			 */
+			montgomery_mul(m, tmp, acc, val);
+			swap(acc, tmp);
+			scaled = false;
 		} else {
-			/* e[j] == 0, copy tmp back to acc for next operation */
-			memcpy(acc, tmp, key->len * sizeof(acc[0]));
+			montgomery_mul(m, tmp, acc, table[u >> 1]);
+			swap(acc, tmp);
 		}
 	}
 
-	/* the bit at e[0] is always 1 */
-	montgomery_mul(key, tmp, acc, acc); /* tmp = acc^2 / R mod n */
-	montgomery_mul(key, acc, tmp, val); /* acc = tmp * a / R mod M */
-	memcpy(result, acc, key->len * sizeof(result[0]));
+	if (scaled) {
+		memset(val, 0, m->len * sizeof(val[0]));
+		val[0] = 1;
+		montgomery_mul(m, tmp, acc, val); /* acc = acc / R mod n */
+		swap(acc, tmp);
+	}
 
 	/* Make sure result < mod; result is at most 1x mod too large. */
-	if (greater_equal_modulus(key, result))
-		subtract_modulus(key, result);
+	if (greater_equal_modulus(m, acc))
+		subtract_modulus(m, acc);
 
 	/* Convert to bigendian byte array */
 	for (i = key->len - 1, ptr = inout; (int)i >= 0; i--, ptr++)
-		put_unaligned_be32(result[i], ptr);
+		put_unaligned_be32(acc[i / RSA_LIMB_WORDS] >>
+				   ((i % RSA_LIMB_WORDS) * 32), ptr);
 	return 0;
 }
 
@@ -432,6 +583,9 @@ struct public_key *rsa_of_read_key(struct device_node *node)
 	rsa_convert_big_endian(rsa->modulus, modulus, rsa->len);
 	rsa_convert_big_endian(rsa->rr, rr, rsa->len);
 
+	rsa->mont = xmalloc(sizeof(*rsa->mont));
+	rsa_mont_init(rsa->mont, rsa);
+
 	err = 0;
 out:
 	if (err) {
@@ -446,6 +600,7 @@ void rsa_key_free(struct rsa_public_key *key)
 {
 	free(key->modulus);
 	free(key->rr);
+	free(key->mont);
 	free(key);
 }
 
@@ -457,6 +612,9 @@ struct rsa_public_key *rsa_key_dup(const struct rsa_public_key *key)
 	new->modulus = xmemdup(key->modulus, key->len * sizeof(uint32_t));
 	new->rr = xmemdup(key->rr, key->len  * sizeof(uint32_t));
 
+	new->mont = xmalloc(sizeof(*new->mont));
+	rsa_mont_init(new->mont, new);
+
 	return new;
 }
 
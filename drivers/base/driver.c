@@ -30,6 +30,8 @@
 #include <pinctrl.h>
 #include <featctrl.h>
 #include <linux/clk/clk-conf.h>
+#include <clock.h>
+#include <linux/math64.h>
 
 #ifdef CONFIG_DEBUG_PROBES
 #define pr_report_probe		pr_info
@@ -47,6 +49,24 @@ LIST_HEAD(active_device_list);
 EXPORT_SYMBOL(active_device_list);
 static LIST_HEAD(deferred);
 
+/*
+ * Bookkeeping for the device currently being probed. Probes nest when a
+ * driver registers child devices, so the frames form a stack.
+ */
+struct probe_frame {
+	struct device_node *supplier;	/* last unbound supplier looked up */
+	u64 child_ns;			/* time spent in nested probes */
+	struct probe_frame *parent;
+};
+
+static struct probe_frame *probing;
+
+static struct {
+	unsigned int ok, deferred, failed;
+	u64 ok_ns, deferred_ns, failed_ns;
+	unsigned int retries, retries_skipped;
+} probe_stats;
+
 static LIST_HEAD(device_alias_list);
 
 struct device *find_device(const char *str)
@@ -115,9 +135,66 @@ static void dev_report_permanent_probe_deferral(struct device *dev)
 		dev_err(dev, "probe permanently deferred\n");
 }
 
+/*
+ * A supplier node is bound when the device instantiated for it, or if it
+ * has none, the device for its nearest ancestor (e.g. a PMIC providing
+ * regulator subnodes) has a driver.
+ */
+static bool of_supplier_is_bound(struct device_node *np)
+{
+	for (; np && np->parent; np = np->parent) {
+		if (np->dev)
+			return np->dev->driver != NULL;
+	}
+
+	return false;
+}
+
+/**
+ * device_probe_note_supplier - record a supplier the probing device waits for
+ * @np: device node of the supplier
+ *
+ * Called from of_device_ensure_probed() when deep probe is not in use. If the
+ * current probe returns -EPROBE_DEFER afterwards, the device is only retried
+ * once the last such supplier that was not bound at lookup time has been
+ * bound.
+ */
+void device_probe_note_supplier(struct device_node *np)
+{
+	if (!probing || !np)
+		return;
+
+	if (!of_device_is_available(np) || of_supplier_is_bound(np))
+		return;
+
+	probing->supplier = np;
+}
+
+static void device_probe_account(int ret, u64 ns)
+{
+	switch (ret) {
+	case 0:
+		probe_stats.ok++;
+		probe_stats.ok_ns += ns;
+		break;
+	case -EPROBE_DEFER:
+		probe_stats.deferred++;
+		probe_stats.deferred_ns += ns;
+		break;
+	default:
+		probe_stats.failed++;
+		probe_stats.failed_ns += ns;
+		break;
+	}
+}
+
 int device_probe(struct device *dev)
 {
 	static int depth = 0;
+	struct probe_frame frame = {
+		.parent = probing,
+	};
+	u64 start, ns;
 	int ret;
 
 	ret = of_feature_controller_check(dev->of_node);
@@ -137,6 +214,9 @@ int device_probe(struct device *dev)
 
 	list_add(&dev->active, &active_device_list);
 
+	probing = &frame;
+	start = get_time_ns();
+
 	if (dev->bus->probe)
 		ret = dev->bus->probe(dev);
 	else if (dev->driver->probe)
@@ -144,8 +224,20 @@ int device_probe(struct device *dev)
 	else
 		ret = 0;
 
+	ns = get_time_ns() - start;
+	probing = frame.parent;
+	if (probing)
+		probing->child_ns += ns;
+
+	/* account nested probes only once, to themselves */
+	ns = ns > frame.child_ns ? ns - frame.child_ns : 0;
+	device_probe_account(ret, ns);
+
 	depth--;
 
+	pr_report_probe("%*sprobe<- %s: %d (%llu us)\n", (depth + 1) * 4, "",
+			dev_name(dev), ret, div_u64(ns, NSEC_PER_USEC));
+
 	switch (ret) {
 	case 0:
 		return 0;
@@ -160,8 +252,13 @@ int device_probe(struct device *dev)
 		}
 
 		list_move(&dev->active, &deferred);
+		dev->deferred_supplier = frame.supplier;
 
-		dev_dbg(dev, "probe deferred\n");
+		if (frame.supplier)
+			dev_dbg(dev, "probe deferred, waiting for %pOF\n",
+				frame.supplier);
+		else
+			dev_dbg(dev, "probe deferred\n");
 		return -EPROBE_DEFER;
 	case -ENODEV:
 	case -ENXIO:
@@ -366,42 +463,77 @@ void free_device(struct device *dev)
 }
 EXPORT_SYMBOL(free_device);
 
+static bool device_reprobe(struct device *dev)
+{
+	struct driver *drv;
+
+	list_del(&dev->active);
+	INIT_LIST_HEAD(&dev->active);
+
+	probe_stats.retries++;
+
+	dev_dbg(dev, "re-probe device\n");
+	bus_for_each_driver(dev->bus, drv) {
+		if (!match(drv, dev))
+			return true;
+	}
+
+	return false;
+}
+
 /*
  * Loop over list of deferred devices as long as at least one
  * device is successfully probed. Devices that again request
  * deferral are re-added to deferred list in device_probe().
- * For devices finally left in deferred list -EPROBE_DEFER
- * becomes a fatal error.
+ *
+ * A device that recorded the supplier it is waiting for is only
+ * retried once that supplier is bound. As the recorded supplier is
+ * a heuristic, all remaining devices are retried unconditionally
+ * before giving up. For devices finally left in deferred list
+ * -EPROBE_DEFER becomes a fatal error.
  */
 static int device_probe_deferred(void)
 {
 	struct device *dev, *tmp;
-	struct driver *drv;
-	bool success;
+	bool success, all = false;
 
 	do {
 		success = false;
 
 		if (list_empty(&deferred))
-			return 0;
+			break;
 
 		list_for_each_entry_safe(dev, tmp, &deferred, active) {
-			list_del(&dev->active);
-			INIT_LIST_HEAD(&dev->active);
+			if (!all && dev->deferred_supplier &&
+			    !of_supplier_is_bound(dev->deferred_supplier)) {
+				probe_stats.retries_skipped++;
+				continue;
+			}
 
-			dev_dbg(dev, "re-probe device\n");
-			bus_for_each_driver(dev->bus, drv) {
-				if (match(drv, dev))
-					continue;
+			if (device_reprobe(dev))
 				success = true;
-				break;
-			}
+		}
+
+		if (!success && !all) {
+			all = true;
+			success = true;
+		} else if (success) {
+			all = false;
 		}
 	} while (success);
 
 	list_for_each_entry(dev, &deferred, active)
 		dev_report_permanent_probe_deferral(dev);
 
+	pr_report_probe("probe: %u bound (%llu ms), %u deferred (%llu ms), "
+			"%u failed (%llu ms), %u retries, %u skipped\n",
+			probe_stats.ok, div_u64(probe_stats.ok_ns, NSEC_PER_MSEC),
+			probe_stats.deferred,
+			div_u64(probe_stats.deferred_ns, NSEC_PER_MSEC),
+			probe_stats.failed,
+			div_u64(probe_stats.failed_ns, NSEC_PER_MSEC),
+			probe_stats.retries, probe_stats.retries_skipped);
+
 	return 0;
 }
 late_initcall(device_probe_deferred);
@@ -8,57 +8,136 @@
 #include <driver.h>
 #include <block.h>
 #include <disks.h>
+#include <dma.h>
+#include <linux/sizes.h>
 #include <linux/virtio_types.h>
 #include <linux/virtio.h>
 #include <linux/virtio_ring.h>
 #include <uapi/linux/virtio_blk.h>
 
+/*
+ * Upper limit for the data of a single request. Larger transfers are split
+ * into several requests which are in flight at the same time.
+ */
+#define VIRTIO_BLK_REQ_MAX_SIZE		SZ_1M
+#define VIRTIO_BLK_MAX_REQS		32
+#define VIRTIO_BLK_MAX_SEGS		64
+
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	struct scatterlist hdr_sg, status_sg;
+	struct scatterlist data_sg[VIRTIO_BLK_MAX_SEGS];
+};
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
 	struct virtio_device *vdev;
 	struct block_device blk;
+
+	u32 seg_max;		/* maximum number of data segments per request */
+	u32 size_max;		/* maximum size of a data segment */
+	blkcnt_t req_blocks;	/* maximum number of blocks per request */
+
+	struct virtio_blk_req *reqs;
+	unsigned int num_reqs;
+	unsigned int free_reqs[VIRTIO_BLK_MAX_REQS];
+	unsigned int num_free_reqs;
 };
 
-static int virtio_blk_do_req(struct virtio_blk_priv *priv, void *buffer,
-			     sector_t sector, blkcnt_t blkcnt, u32 type)
+static int virtio_blk_queue_req(struct virtio_blk_priv *priv,
+				struct virtio_blk_req *req, void *buffer,
+				sector_t sector, blkcnt_t blkcnt, u32 type)
 {
-	unsigned int num_out = 0, num_in = 0;
-	struct scatterlist hdr_sg, data_sg, status_sg, *sgs[3];
-	u8 status = VIRTIO_BLK_S_IOERR;
-	int ret;
+	unsigned int num_out = 0, num_in = 0, nsegs = 0;
+	struct scatterlist *sgs[3];
+	size_t len = blkcnt << SECTOR_SHIFT;
 
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(priv->vdev, type),
-		.sector = cpu_to_virtio64(priv->vdev, sector),
-	};
+	req->out_hdr.type = cpu_to_virtio32(priv->vdev, type);
+	req->out_hdr.ioprio = 0;
+	req->out_hdr.sector = cpu_to_virtio64(priv->vdev, sector);
+	req->status = VIRTIO_BLK_S_IOERR;
 
-	sg_init_one(&hdr_sg, &out_hdr, sizeof(out_hdr));
-	sgs[num_out++] = &hdr_sg;
+	sg_init_one(&req->hdr_sg, &req->out_hdr, sizeof(req->out_hdr));
+	sgs[num_out++] = &req->hdr_sg;
 
-	sg_init_one(&data_sg, buffer, blkcnt * 512);
+	sg_init_table(req->data_sg, priv->seg_max);
+	while (len) {
+		size_t now = min_t(size_t, len, priv->size_max);
+
+		sg_set_buf(&req->data_sg[nsegs++], buffer, now);
+		buffer += now;
+		len -= now;
+	}
+	sg_mark_end(&req->data_sg[nsegs - 1]);
 
 	switch(type) {
 	case VIRTIO_BLK_T_OUT:
-		sgs[num_out++] = &data_sg;
+		sgs[num_out++] = req->data_sg;
 		break;
 	case VIRTIO_BLK_T_IN:
-		sgs[num_out + num_in++] = &data_sg;
+		sgs[num_out + num_in++] = req->data_sg;
 		break;
 	}
 
-	sg_init_one(&status_sg, &status, sizeof(status));
-	sgs[num_out + num_in++] = &status_sg;
+	sg_init_one(&req->status_sg, &req->status, sizeof(req->status));
+	sgs[num_out + num_in++] = &req->status_sg;
 
-	ret = virtqueue_add_sgs(priv->vq, sgs, num_out, num_in, &out_hdr);
-	if (ret)
-		return ret;
+	return virtqueue_add_sgs(priv->vq, sgs, num_out, num_in, req);
+}
+
+static int virtio_blk_do_req(struct virtio_blk_priv *priv, void *buffer,
+			     sector_t sector, blkcnt_t blkcnt, u32 type)
+{
+	struct virtio_blk_req *req;
+	unsigned int inflight = 0;
+	int ret = 0;
+
+	while ((blkcnt && !ret) || inflight) {
+		/* Fill the ring with as many requests as possible... */
+		while (blkcnt && !ret && priv->num_free_reqs) {
+			blkcnt_t now = min(blkcnt, priv->req_blocks);
+			unsigned int idx;
+			int err;
+
+			idx = priv->free_reqs[priv->num_free_reqs - 1];
+			req = &priv->reqs[idx];
+
+			err = virtio_blk_queue_req(priv, req, buffer, sector,
+						   now, type);
+			if (err == -ENOSPC && inflight)
+				break;
+			if (err) {
+				ret = err;
+				break;
+			}
+
+			priv->num_free_reqs--;
+			inflight++;
 
-	virtqueue_kick(priv->vq);
+			buffer += now << SECTOR_SHIFT;
+			sector += now;
+			blkcnt -= now;
+		}
 
-	if (!virtqueue_get_buf_timeout(priv->vq, NULL, NSEC_PER_SEC))
-		return -ETIMEDOUT;
+		if (!inflight)
+			break;
 
-	return status == VIRTIO_BLK_S_OK ? 0 : -EIO;
+		/* ...and notify the device only once for all of them */
+		virtqueue_kick(priv->vq);
+
+		req = virtqueue_get_buf_timeout(priv->vq, NULL, NSEC_PER_SEC);
+		if (!req)
+			return -ETIMEDOUT;
+
+		inflight--;
+		priv->free_reqs[priv->num_free_reqs++] = req - priv->reqs;
+
+		if (req->status != VIRTIO_BLK_S_OK && !ret)
+			ret = -EIO;
+	}
+
+	return ret;
 }
 
 static int virtio_blk_read(struct block_device *blk, void *buffer,
@@ -87,7 +166,7 @@ static int virtio_blk_probe(struct virtio_device *vdev)
 	struct virtio_blk_priv *priv;
 	u64 cap;
 	int devnum;
-	int ret;
+	int ret, i;
 
 	priv = xzalloc(sizeof(*priv));
 
@@ -98,6 +177,41 @@ static int virtio_blk_probe(struct virtio_device *vdev)
 	priv->vdev = vdev;
 	vdev->priv = priv;
 
+	/*
+	 * Without VIRTIO_BLK_F_SEG_MAX a request may only have a single data
+	 * segment, without VIRTIO_BLK_F_SIZE_MAX its size isn't limited.
+	 * Each request needs two descriptors on top for header and status.
+	 */
+	ret = virtio_cread_feature(vdev, VIRTIO_BLK_F_SEG_MAX,
+				   struct virtio_blk_config, seg_max,
+				   &priv->seg_max);
+	if (ret || !priv->seg_max)
+		priv->seg_max = 1;
+	priv->seg_max = min3(priv->seg_max, (u32)VIRTIO_BLK_MAX_SEGS,
+			     virtqueue_get_vring_size(priv->vq) - 2);
+
+	ret = virtio_cread_feature(vdev, VIRTIO_BLK_F_SIZE_MAX,
+				   struct virtio_blk_config, size_max,
+				   &priv->size_max);
+	if (ret || !priv->size_max)
+		priv->size_max = VIRTIO_BLK_REQ_MAX_SIZE;
+	priv->size_max = ALIGN_DOWN(max_t(u32, priv->size_max, SECTOR_SIZE),
+				    SECTOR_SIZE);
+
+	priv->req_blocks = min_t(u64, (u64)priv->seg_max * priv->size_max,
+				 VIRTIO_BLK_REQ_MAX_SIZE) >> SECTOR_SHIFT;
+
+	priv->num_reqs = clamp_t(unsigned int,
+				 virtqueue_get_vring_size(priv->vq) / (priv->seg_max + 2),
+				 1, VIRTIO_BLK_MAX_REQS);
+	priv->reqs = dma_alloc(priv->num_reqs * sizeof(*priv->reqs));
+	for (i = 0; i < priv->num_reqs; i++)
+		priv->free_reqs[i] = i;
+	priv->num_free_reqs = priv->num_reqs;
+
+	dev_dbg(&vdev->dev, "%u requests in flight, %u segments of %u bytes each\n",
+		priv->num_reqs, priv->seg_max, priv->size_max);
+
 	devnum = cdev_find_free_index("virtioblk");
 	priv->blk.cdev.name = xasprintf("virtioblk%d", devnum);
 	cdev_set_of_node(&priv->blk.cdev, vdev->dev.device_node);
@@ -119,6 +233,7 @@ static void virtio_blk_remove(struct virtio_device *vdev)
 	blockdevice_unregister(&priv->blk);
 	vdev->config->del_vqs(vdev);
 
+	dma_free(priv->reqs);
 	free(priv);
 }
 
@@ -127,10 +242,19 @@ static const struct virtio_device_id id_table[] = {
         { 0 },
 };
 
+static const u32 features[] = {
+	VIRTIO_BLK_F_SEG_MAX,
+	VIRTIO_BLK_F_SIZE_MAX,
+};
+
 static struct virtio_driver virtio_blk = {
         .driver.name	= "virtio_blk",
         .id_table	= id_table,
         .probe		= virtio_blk_probe,
 	.remove		= virtio_blk_remove,
+	.feature_table			= features,
+	.feature_table_size		= ARRAY_SIZE(features),
+	.feature_table_legacy		= features,
+	.feature_table_size_legacy	= ARRAY_SIZE(features),
 };
 device_virtio_driver(virtio_blk);
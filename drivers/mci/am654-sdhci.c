@@ -648,7 +648,11 @@ static int am654_sdhci_probe(struct device *dev)
 
 	dev->priv = plat;
 
-	return mci_register(&plat->mci);
+	ret = mci_register(&plat->mci);
+	if (ret)
+		sdhci_cleanup_host(&plat->sdhci);
+
+	return ret;
 }
 
 static const struct of_device_id am654_sdhci_ids[] = {
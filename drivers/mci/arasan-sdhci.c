@@ -808,7 +808,11 @@ static int arasan_sdhci_probe(struct device *dev)
 
 	dev->priv = arasan_sdhci;
 
-	return mci_register(&arasan_sdhci->mci);
+	ret = mci_register(&arasan_sdhci->mci);
+	if (ret)
+		sdhci_cleanup_host(&arasan_sdhci->sdhci);
+
+	return ret;
 }
 
 static __maybe_unused struct of_device_id arasan_sdhci_compatible[] = {
@@ -364,6 +364,7 @@ static int dwcmshc_probe(struct device *dev)
 	return ret;
 
 err_register:
+	sdhci_cleanup_host(&host->sdhci);
 	clk_disable(clk);
 	clk_put(clk);
 err_clk_get:
@@ -451,7 +451,16 @@ static int esdhc_init(struct mci_host *mci, struct device *dev)
 			SDHCI_INT_XFER_COMPLETE | SDHCI_INT_CARD_INT |
 			SDHCI_INT_TIMEOUT | SDHCI_INT_CRC | SDHCI_INT_END_BIT |
 			SDHCI_INT_INDEX | SDHCI_INT_DATA_TIMEOUT |
-			SDHCI_INT_DATA_CRC | SDHCI_INT_DATA_END_BIT | SDHCI_INT_DMA);
+			SDHCI_INT_DATA_CRC | SDHCI_INT_DATA_END_BIT | SDHCI_INT_DMA |
+			SDHCI_INT_ADMA_ERROR);
+
+	/*
+	 * errata ERR004536 fix for MX6Q TO1.2 and MX6DL TO1.1, it's
+	 * harmless for MX6SL. Without it ADMA reads fail with a length
+	 * mismatch error when the AHB read access is slow.
+	 */
+	if (host->socdata->flags & ESDHC_FLAG_ERR004536)
+		esdhc_setbits32(host, ESDHC_ERR004536_CTRL, ESDHC_ERR004536_FIX);
 
 	/* Put the PROCTL reg back to the default */
 	sdhci_write32(&host->sdhci, SDHCI_HOST_CONTROL__POWER_CONTROL__BLOCK_GAP_CONTROL,
@@ -620,6 +629,13 @@ static int fsl_esdhc_probe(struct device *dev)
 	if (!usdhc_setup_tuning(host))
 		host->sdhci.quirks2 |= SDHCI_QUIRK2_BROKEN_HS200;
 
+	/*
+	 * Only the uSDHC accessors translate the shifted DMA select bits in
+	 * the protocol control register, stay with SDMA on the others.
+	 */
+	if (!esdhc_is_usdhc(host))
+		host->sdhci.quirks |= SDHCI_QUIRK_BROKEN_ADMA;
+
 	ret = sdhci_setup_host(&host->sdhci);
 	if (ret)
 		goto err_clk_disable;
@@ -643,11 +659,12 @@ static int fsl_esdhc_probe(struct device *dev)
 
 	ret = mci_register(&host->mci);
 	if (ret)
-		goto err_release_res;
+		goto err_cleanup_host;
 
 	return 0;
 
-err_release_res:
+err_cleanup_host:
+	sdhci_cleanup_host(&host->sdhci);
 	release_region(iores);
 err_clk_disable:
 	clk_disable(host->clk);
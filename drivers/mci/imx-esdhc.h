@@ -102,6 +102,10 @@
 #define  ESDHC_TUNE_CTRL_MIN		0
 #define  ESDHC_TUNE_CTRL_MAX		((1 << 7) - 1)
 
+/* undocumented register holding the ERR004536 workaround bit */
+#define ESDHC_ERR004536_CTRL		0x6c
+#define  ESDHC_ERR004536_FIX		BIT(7)
+
 /* VENDOR SPEC register */
 #define ESDHC_VENDOR_SPEC		0xc0
 #define  ESDHC_VENDOR_SPEC_SDIO_QUIRK	(1 << 1)
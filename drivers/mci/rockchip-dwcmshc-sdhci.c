@@ -61,7 +61,8 @@
 						SDHCI_INT_DATA_AVAIL | \
 						SDHCI_INT_DATA_TIMEOUT | \
 						SDHCI_INT_DATA_CRC | \
-						SDHCI_INT_DATA_END_BIT
+						SDHCI_INT_DATA_END_BIT | \
+						SDHCI_INT_ADMA_ERROR
 
 #define SDHCI_DWCMSHC_INT_CMD_MASK		SDHCI_INT_CMD_COMPLETE | \
 						SDHCI_INT_TIMEOUT | \
@@ -348,7 +349,11 @@ static int rk_sdhci_probe(struct device *dev)
 
 	dev->priv = host;
 
-	return mci_register(&host->mci);
+	ret = mci_register(&host->mci);
+	if (ret)
+		sdhci_cleanup_host(&host->sdhci);
+
+	return ret;
 }
 
 static __maybe_unused struct of_device_id rk_sdhci_compatible[] = {
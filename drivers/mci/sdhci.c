@@ -6,6 +6,7 @@
 #include <io.h>
 #include <dma.h>
 #include <linux/bitfield.h>
+#include <linux/log2.h>
 
 #include "sdhci.h"
 
@@ -446,7 +447,7 @@ void sdhci_setup_data_pio(struct sdhci *sdhci, struct mci_data *data)
 		      SDHCI_TRANSFER_BLOCK_SIZE(data->blocksize) | data->blocks << 16);
 }
 
-static void sdhci_config_dma(struct sdhci *host)
+static void sdhci_config_dma(struct sdhci *host, bool adma)
 {
 	u8 ctrl;
 	u16 ctrl2;
@@ -457,6 +458,16 @@ static void sdhci_config_dma(struct sdhci *host)
 	ctrl = sdhci_read8(host, SDHCI_HOST_CONTROL);
 	/* Note if DMA Select is zero then SDMA is selected */
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	if (adma) {
+		/*
+		 * In v4 mode 64-bit ADMA2 is selected with ADMA2 and the
+		 * 64-bit addressing bit in Host Control 2.
+		 */
+		if (host->flags & SDHCI_USE_64_BIT_DMA && !host->v4_mode)
+			ctrl |= SDHCI_CTRL_ADMA64;
+		else
+			ctrl |= SDHCI_CTRL_ADMA32;
+	}
 	sdhci_write8(host, SDHCI_HOST_CONTROL, ctrl);
 
 	if (host->flags & SDHCI_USE_64_BIT_DMA) {
@@ -473,6 +484,81 @@ static void sdhci_config_dma(struct sdhci *host)
 	}
 }
 
+static void sdhci_adma_write_desc(struct sdhci *host, void **desc,
+				  dma_addr_t addr, int len, unsigned int cmd)
+{
+	struct sdhci_adma2_64_desc *dma_desc = *desc;
+
+	/* 32-bit and 64-bit descriptors have these members in same position */
+	dma_desc->cmd = cpu_to_le16(cmd);
+	dma_desc->len = cpu_to_le16(len);
+	dma_desc->addr_lo = cpu_to_le32(lower_32_bits(addr));
+
+	if (host->flags & SDHCI_USE_64_BIT_DMA)
+		dma_desc->addr_hi = cpu_to_le32(upper_32_bits(addr));
+
+	*desc += host->desc_sz;
+}
+
+/*
+ * Build the ADMA2 descriptor table for a mapped buffer. The table is
+ * allocated on first use and grown as needed, so that a request of any size
+ * is transferred in one go without any CPU intervention.
+ */
+static int sdhci_adma_table_pre(struct sdhci *host, dma_addr_t addr,
+				unsigned int nbytes)
+{
+	struct device *dev = sdhci_dev(host);
+	struct sdhci_adma2_64_desc *last;
+	unsigned int ndesc, len;
+	size_t sz;
+	void *desc;
+
+	if (IN_PBL)
+		return -ENOSYS;
+
+	/* ADMA2 needs 32-bit aligned data buffers */
+	if (!IS_ALIGNED(addr, 4))
+		return -EINVAL;
+
+	ndesc = DIV_ROUND_UP((addr & (SDHCI_ADMA2_MAX_LEN - 1)) + nbytes,
+			     SDHCI_ADMA2_MAX_LEN);
+	sz = ndesc * host->desc_sz;
+
+	if (sz > host->adma_table_sz) {
+		if (host->adma_table)
+			dma_free_coherent(dev, host->adma_table,
+					  host->adma_addr, host->adma_table_sz);
+
+		sz = max_t(size_t, PAGE_SIZE, roundup_pow_of_two(sz));
+		host->adma_table = dma_alloc_coherent(dev, sz, &host->adma_addr);
+		if (!host->adma_table) {
+			host->adma_table_sz = 0;
+			return -ENOMEM;
+		}
+
+		host->adma_table_sz = sz;
+	}
+
+	desc = host->adma_table;
+
+	while (nbytes) {
+		len = min_t(unsigned int, nbytes, SDHCI_ADMA2_MAX_LEN -
+			    (addr & (SDHCI_ADMA2_MAX_LEN - 1)));
+
+		sdhci_adma_write_desc(host, &desc, addr, len, ADMA2_TRAN_VALID);
+
+		addr += len;
+		nbytes -= len;
+	}
+
+	/* Mark the last descriptor as the end of the table */
+	last = desc - host->desc_sz;
+	last->cmd |= cpu_to_le16(ADMA2_END);
+
+	return 0;
+}
+
 void sdhci_setup_data_dma(struct sdhci *sdhci, struct mci_data *data,
 			  dma_addr_t *dma)
 {
@@ -504,7 +590,14 @@ void sdhci_setup_data_dma(struct sdhci *sdhci, struct mci_data *data,
 		return;
 	}
 
-	sdhci_config_dma(sdhci);
+	if (sdhci->flags & SDHCI_USE_ADMA &&
+	    !sdhci_adma_table_pre(sdhci, *dma, nbytes)) {
+		sdhci_config_dma(sdhci, true);
+		sdhci_set_adma_addr(sdhci, sdhci->adma_addr);
+		return;
+	}
+
+	sdhci_config_dma(sdhci, false);
 	sdhci_set_sdma_addr(sdhci, *dma);
 }
 
@@ -563,7 +656,17 @@ int sdhci_transfer_data_dma(struct sdhci *sdhci, struct mci_cmd *cmd,
 			goto out;
 		}
 
+		if (irqstat & SDHCI_INT_ADMA_ERROR) {
+			dev_err(dev, "ADMA error: 0x%02x\n",
+				sdhci_read8(sdhci, SDHCI_ADMA_ERROR));
+			ret = -EIO;
+			goto out;
+		}
+
 		/*
+		 * With ADMA2 the whole transfer is described by the descriptor
+		 * table and the DMA interrupt is never raised. For SDMA:
+		 *
 		 * We currently don't do anything fancy with DMA
 		 * boundaries, but as we can't disable the feature
 		 * we need to at least restart the transfer.
@@ -1028,6 +1131,17 @@ int sdhci_setup_host(struct sdhci *host)
 	if (sdhci_can_64bit_dma(host))
 		host->flags |= SDHCI_USE_64_BIT_DMA;
 
+	if (!IN_PBL && host->version >= SDHCI_SPEC_200 &&
+	    host->caps & SDHCI_CAN_DO_ADMA2 &&
+	    !(host->quirks & SDHCI_QUIRK_BROKEN_ADMA)) {
+		host->flags |= SDHCI_USE_ADMA;
+
+		if (host->flags & SDHCI_USE_64_BIT_DMA)
+			host->desc_sz = SDHCI_ADMA2_64_DESC_SZ(host);
+		else
+			host->desc_sz = SDHCI_ADMA2_32_DESC_SZ;
+	}
+
 	if (host->quirks2 & SDHCI_QUIRK2_NO_1_8_V) {
 		host->caps1 &= ~(SDHCI_SUPPORT_SDR104 | SDHCI_SUPPORT_SDR50 |
 				 SDHCI_SUPPORT_DDR50);
@@ -1082,3 +1196,21 @@ int sdhci_setup_host(struct sdhci *host)
 
 	return 0;
 }
+
+/**
+ * sdhci_cleanup_host - release resources allocated by the SDHCI core
+ * @host: the sdhci host
+ *
+ * Frees the ADMA2 descriptor table. To be called by drivers when probing
+ * fails after sdhci_setup_host().
+ */
+void sdhci_cleanup_host(struct sdhci *host)
+{
+	if (!host->adma_table)
+		return;
+
+	dma_free_coherent(sdhci_dev(host), host->adma_table, host->adma_addr,
+			  host->adma_table_sz);
+	host->adma_table = NULL;
+	host->adma_table_sz = 0;
+}
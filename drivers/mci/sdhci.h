@@ -106,6 +106,7 @@
 #define  SDHCI_RESET_DATA			BIT(2)
 #define SDHCI_INT_STATUS					0x30
 #define SDHCI_INT_NORMAL_STATUS					0x30
+#define  SDHCI_INT_ADMA_ERROR			BIT(25)
 #define  SDHCI_INT_DATA_END_BIT			BIT(22)
 #define  SDHCI_INT_DATA_CRC			BIT(21)
 #define  SDHCI_INT_DATA_TIMEOUT			BIT(20)
@@ -202,9 +203,41 @@
 
 #define  SDHCI_CLOCK_MUL_SHIFT	16
 
+#define SDHCI_ADMA_ERROR					0x54
 #define SDHCI_ADMA_ADDRESS					0x58
 #define SDHCI_ADMA_ADDRESS_HI					0x5c
 
+/* ADMA2 32-bit descriptor */
+struct sdhci_adma2_32_desc {
+	__le16	cmd;
+	__le16	len;
+	__le32	addr;
+} __packed __aligned(4);
+
+/*
+ * ADMA2 64-bit descriptor. Note 12-byte descriptor can't always be 8-byte
+ * aligned, in v4 mode the descriptor is padded to 16 bytes.
+ */
+struct sdhci_adma2_64_desc {
+	__le16	cmd;
+	__le16	len;
+	__le32	addr_lo;
+	__le32	addr_hi;
+} __packed __aligned(4);
+
+#define SDHCI_ADMA2_32_DESC_SZ	8
+#define SDHCI_ADMA2_64_DESC_SZ(host)	((host)->v4_mode ? 16 : 12)
+
+/*
+ * Maximum length of the data buffer of a single descriptor. Descriptors
+ * don't cross a boundary of this size, which also keeps us clear of the
+ * 128MiB boundary some controllers can't cross.
+ */
+#define SDHCI_ADMA2_MAX_LEN	SZ_32K
+
+#define ADMA2_TRAN_VALID	0x21
+#define ADMA2_END		0x2
+
 #define SDHCI_MMC_BOOT						0xC4
 
 #define SDHCI_MAX_DIV_SPEC_200	256
@@ -247,6 +280,8 @@ struct sdhci {
 	bool v4_mode;		/* Host Version 4 Enable */
 
 	unsigned int quirks;
+/* Controller advertises ADMA2 in its capabilities, but it doesn't work */
+#define SDHCI_QUIRK_BROKEN_ADMA			BIT(6)
 #define SDHCI_QUIRK_MISSING_CAPS		BIT(27)
 	unsigned int quirks2;
 /* The system physically doesn't support 1.8v, even if the host does */
@@ -260,6 +295,11 @@ struct sdhci {
 	bool read_caps;	/* Capability flags have been read */
 	u32 sdma_boundary;
 
+	void *adma_table;	/* ADMA2 descriptor table */
+	dma_addr_t adma_addr;	/* Mapped ADMA2 descriptor table */
+	size_t adma_table_sz;
+	unsigned int desc_sz;	/* ADMA2 descriptor size */
+
 	unsigned int		tuning_count;	/* Timer count for re-tuning */
 	unsigned int		tuning_mode;	/* Re-tuning mode supported by host */
 	unsigned int		tuning_err;	/* Error code for re-tuning */
@@ -351,6 +391,7 @@ void sdhci_enable_clk(struct sdhci *host, u16 clk);
 void sdhci_set_drv_type(struct sdhci *host, unsigned drv_type);
 void sdhci_enable_v4_mode(struct sdhci *host);
 int sdhci_setup_host(struct sdhci *host);
+void sdhci_cleanup_host(struct sdhci *host);
 void __sdhci_read_caps(struct sdhci *host, const u16 *ver,
 			const u32 *caps, const u32 *caps1);
 static inline void sdhci_read_caps(struct sdhci *host)
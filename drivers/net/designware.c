@@ -141,23 +141,23 @@ static void rx_descs_init(struct eth_device *dev)
 	struct dw_eth_dev *priv = dev->priv;
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
 	struct dmamacdescr *desc_table_p = &priv->rx_mac_descrtable_cpu[0];
-	char *rxbuffs = &priv->rxbuffs[0];
 	struct dmamacdescr *desc_p;
 	u32 idx;
 
 	for (idx = 0; idx < CONFIG_RX_DESCR_NUM; idx++) {
 		desc_p = &desc_table_p[idx];
-		desc_p->dmamac_addr = virt_to_phys(&rxbuffs[idx * CONFIG_ETH_BUFSIZE]);
+		desc_p->dmamac_addr = virt_to_phys(priv->rxbuffs[idx]);
 		desc_p->dmamac_next = rx_dma_addr(priv, &desc_table_p[idx + 1]);
 
-		desc_p->dmamac_cntl = MAC_MAX_FRAME_SZ;
+		/* frames up to MAC_MAX_FRAME_SZ fit into one packet buffer */
+		desc_p->dmamac_cntl = min(MAC_MAX_FRAME_SZ, PKTSIZE);
 		if (priv->enh_desc)
 			desc_p->dmamac_cntl |= DESC_ENH_RXCTRL_RXCHAIN;
 		else
 			desc_p->dmamac_cntl |= DESC_RXCTRL_RXCHAIN;
 
 		dma_sync_single_for_device(dev->parent, desc_p->dmamac_addr,
-					CONFIG_ETH_BUFSIZE, DMA_FROM_DEVICE);
+					PKTSIZE, DMA_FROM_DEVICE);
 		desc_p->txrx_status = DESC_RXSTS_OWNBYDMA;
 	}
 
@@ -362,9 +362,21 @@ static void dwc_ether_rx(struct eth_device *dev)
 
 		dma_sync_single_for_cpu(dev->parent, desc_p->dmamac_addr,
 					length, DMA_FROM_DEVICE);
-		net_receive(dev, dmamac_addr(desc_p), length);
-		dma_sync_single_for_device(dev->parent, desc_p->dmamac_addr,
-					   length, DMA_FROM_DEVICE);
+		if (!priv->rx_spare)
+			priv->rx_spare = net_alloc_packet();
+
+		if (net_receive_buf(dev, dmamac_addr(desc_p), dmamac_addr(desc_p),
+				    length, priv->rx_spare)) {
+			/* the buffer was taken over, use the spare */
+			priv->rxbuffs[desc_num] = priv->rx_spare;
+			priv->rx_spare = NULL;
+			desc_p->dmamac_addr = virt_to_phys(priv->rxbuffs[desc_num]);
+			dma_sync_single_for_device(dev->parent, desc_p->dmamac_addr,
+						   PKTSIZE, DMA_FROM_DEVICE);
+		} else {
+			dma_sync_single_for_device(dev->parent, desc_p->dmamac_addr,
+						   length, DMA_FROM_DEVICE);
+		}
 	}
 
 	/*
@@ -486,18 +498,25 @@ struct dw_eth_dev *dwc_drv_probe(struct device *dev)
 		CONFIG_TX_DESCR_NUM * sizeof(struct dmamacdescr),
 		&priv->tx_mac_descrtable_dev);
 
-	if (!priv->tx_mac_descrtable_cpu)
-		return ERR_PTR(-EFAULT);
+	if (!priv->tx_mac_descrtable_cpu) {
+		ret = -EFAULT;
+		goto err_release;
+	}
 
 	priv->rx_mac_descrtable_cpu = dma_alloc_coherent(DMA_DEVICE_BROKEN,
 		CONFIG_RX_DESCR_NUM * sizeof(struct dmamacdescr),
 		&priv->rx_mac_descrtable_dev);
 
-	if (!priv->rx_mac_descrtable_cpu)
-		return ERR_PTR(-EFAULT);
+	if (!priv->rx_mac_descrtable_cpu) {
+		ret = -EFAULT;
+		goto err_free_tx_descs;
+	}
 
 	priv->txbuffs = dma_alloc(TX_TOTAL_BUFSIZE);
-	priv->rxbuffs = dma_alloc(RX_TOTAL_BUFSIZE);
+	priv->rxbuffs = xzalloc(CONFIG_RX_DESCR_NUM * sizeof(*priv->rxbuffs));
+	ret = net_alloc_packets(priv->rxbuffs, CONFIG_RX_DESCR_NUM);
+	if (ret)
+		goto err_free_buffs;
 
 	edev = &priv->netdev;
 	miibus = &priv->miibus;
@@ -521,6 +540,22 @@ struct dw_eth_dev *dwc_drv_probe(struct device *dev)
 	eth_register(edev);
 
 	return priv;
+
+err_free_buffs:
+	free(priv->rxbuffs);
+	dma_free(priv->txbuffs);
+	dma_free_coherent(DMA_DEVICE_BROKEN, priv->rx_mac_descrtable_cpu,
+			  priv->rx_mac_descrtable_dev,
+			  CONFIG_RX_DESCR_NUM * sizeof(struct dmamacdescr));
+err_free_tx_descs:
+	dma_free_coherent(DMA_DEVICE_BROKEN, priv->tx_mac_descrtable_cpu,
+			  priv->tx_mac_descrtable_dev,
+			  CONFIG_TX_DESCR_NUM * sizeof(struct dmamacdescr));
+err_release:
+	release_region(iores);
+	free(priv);
+
+	return ERR_PTR(ret);
 }
 
 void dwc_drv_remove(struct device *dev)
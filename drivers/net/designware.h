@@ -26,7 +26,8 @@ struct dw_eth_dev {
 	dma_addr_t rx_mac_descrtable_dev;
 
 	u8 *txbuffs;
-	u8 *rxbuffs;
+	void **rxbuffs;		/* packet buffer of each rx descriptor */
+	void *rx_spare;		/* replacement for a buffer taken over */
 
 	struct eth_mac_regs *mac_regs_p;
 	struct eth_dma_regs *dma_regs_p;
@@ -64,7 +65,6 @@ void dwc_drv_remove(struct device *dev);
 #define CONFIG_RX_DESCR_NUM	16
 #define CONFIG_ETH_BUFSIZE	2048
 #define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
-#define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
 
 struct eth_mac_regs {
 	u32 conf;		/* 0x00 */
@@ -524,6 +524,53 @@ static int fec_send(struct eth_device *dev, void *eth_data, int data_length)
 	return 0;
 }
 
+static int fec_map_receive_packet(struct fec_priv *fec,
+				  struct buffer_descriptor __iomem *rbd, void *p)
+{
+	dma_addr_t dma;
+
+	/*
+	 * Make sure there are no outstanding writes to the
+	 * region of memory we are going to use as receive
+	 * buffer as well as check that DMA mapping is valid
+	 */
+	dma = dma_map_single(fec->dev, p, FEC_MAX_PKT_SIZE, DMA_FROM_DEVICE);
+	if (dma_mapping_error(fec->dev, dma))
+		return -EFAULT;
+
+	writel(dma, &rbd->data_pointer);
+
+	return 0;
+}
+
+/*
+ * Provide a mapped packet buffer the network stack can swap in when it takes
+ * over a receive buffer. Without one the received frame is copied instead.
+ */
+static void *fec_get_rx_spare(struct fec_priv *fec)
+{
+	dma_addr_t dma;
+	void *p;
+
+	if (fec->rx_spare)
+		return fec->rx_spare;
+
+	p = net_alloc_packet();
+	if (!p)
+		return NULL;
+
+	dma = dma_map_single(fec->dev, p, FEC_MAX_PKT_SIZE, DMA_FROM_DEVICE);
+	if (dma_mapping_error(fec->dev, dma)) {
+		net_free_packet(p);
+		return NULL;
+	}
+
+	fec->rx_spare = p;
+	fec->rx_spare_dma = dma;
+
+	return p;
+}
+
 /**
  * Pull one frame from the card
  * @param[in] dev Our ethernet device to handle
@@ -600,10 +647,18 @@ static void fec_recv(struct eth_device *dev)
 			 * Get buffer address and size
 			 */
 			len = data_length - 4;
-			net_receive(dev, frame, len);
-			dma_sync_single_for_device(fec->dev, (unsigned long)frame,
-						   data_length,
-						   DMA_FROM_DEVICE);
+			if (net_receive_buf(dev, frame, frame, len,
+					    fec_get_rx_spare(fec))) {
+				/* the buffer was taken over, use the spare */
+				dma_unmap_single(fec->dev, readl(&rbd->data_pointer),
+						 FEC_MAX_PKT_SIZE, DMA_FROM_DEVICE);
+				writel(fec->rx_spare_dma, &rbd->data_pointer);
+				fec->rx_spare = NULL;
+			} else {
+				dma_sync_single_for_device(fec->dev, (unsigned long)frame,
+							   data_length,
+							   DMA_FROM_DEVICE);
+			}
 		}
 	}
 	/*
@@ -615,38 +670,56 @@ static void fec_recv(struct eth_device *dev)
 	fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
 }
 
-static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
+static void fec_free_receive_packets(struct fec_priv *fec, int count, int size)
 {
-	void *p;
+	dma_addr_t dma;
 	int i;
 
-
-	p = dma_alloc(size * count);
-	if (!p)
-		return -ENOMEM;
-
 	for (i = 0; i < count; i++) {
-		dma_addr_t dma;
-		/*
-		 * Make sure there are no outstanding writes to the
-		 * region of memory we are going to use as receive
-		 * buffers as well as check that DMA mapping is valid
-		 */
-		dma = dma_map_single(fec->dev, p, size, DMA_FROM_DEVICE);
-		if (dma_mapping_error(fec->dev, dma))
-			return -EFAULT;
-
-		writel(dma, &fec->rbd_base[i].data_pointer);
-		p += size;
+		dma = readl(&fec->rbd_base[i].data_pointer);
+		if (!dma)
+			continue;
+
+		dma_unmap_single(fec->dev, dma, size, DMA_FROM_DEVICE);
+		net_free_packet(phys_to_virt(dma));
+		writel(0, &fec->rbd_base[i].data_pointer);
 	}
 
-	return 0;
+	if (fec->rx_spare) {
+		dma_unmap_single(fec->dev, fec->rx_spare_dma, size,
+				 DMA_FROM_DEVICE);
+		net_free_packet(fec->rx_spare);
+		fec->rx_spare = NULL;
+	}
 }
 
-static void fec_free_receive_packets(struct fec_priv *fec, int count, int size)
+static int fec_alloc_receive_packets(struct fec_priv *fec, int count, int size)
 {
-	void *p = phys_to_virt(fec->rbd_base[0].data_pointer);
-	dma_free(p);
+	void *p;
+	int i, ret;
+
+	/*
+	 * Every descriptor gets its own packet buffer, so that a buffer
+	 * taken over by the network stack can be replaced individually.
+	 */
+	for (i = 0; i < count; i++) {
+		p = net_alloc_packet();
+		if (!p) {
+			ret = -ENOMEM;
+			goto err;
+		}
+
+		ret = fec_map_receive_packet(fec, &fec->rbd_base[i], p);
+		if (ret) {
+			net_free_packet(p);
+			goto err;
+		}
+	}
+
+	return 0;
+err:
+	fec_free_receive_packets(fec, count, size);
+	return ret;
 }
 
 #ifdef CONFIG_OFDEVICE
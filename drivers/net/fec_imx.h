@@ -143,6 +143,8 @@ struct fec_priv {
 	void __iomem *regs;
 	struct buffer_descriptor __iomem *rbd_base;	/* RBD ring                  */
 	int rbd_index;				/* next receive BD to read   */
+	void *rx_spare;				/* mapped replacement RX buffer */
+	dma_addr_t rx_spare_dma;
 	struct buffer_descriptor __iomem *tbd_base;	/* TBD ring                  */
 	int tbd_index;				/* next transmit BD to write */
 	int phy_addr;
@@ -64,6 +64,10 @@ struct macb_device {
 
 	void			*rx_buffer;
 	dma_addr_t		rx_buffer_phys;
+	void			**rx_bufs;	/* GEM: buffer per descriptor */
+	dma_addr_t		*rx_bufs_phys;
+	void			*rx_spare;	/* GEM: mapped replacement */
+	dma_addr_t		rx_spare_phys;
 	void			*tx_buffer;
 	void			*rx_packet_buf;
 	struct macb_dma_desc	*rx_ring;
@@ -172,6 +176,60 @@ static void reclaim_rx_buffers(struct macb_device *macb,
 	macb->rx_tail = new_tail;
 }
 
+static void gem_rx_set_desc(struct macb_device *macb, unsigned int i)
+{
+	dma_addr_t paddr = macb->rx_bufs_phys[i];
+
+	if (i == macb->rx_ring_size - 1)
+		paddr |= MACB_BIT(RX_WRAP);
+
+	writel(paddr, &macb->rx_ring[i].addr);
+}
+
+static int gem_rx_map(struct macb_device *macb, unsigned int i)
+{
+	dma_addr_t paddr;
+
+	paddr = dma_map_single(macb->dev, macb->rx_bufs[i], macb->rx_buffer_size,
+			       DMA_FROM_DEVICE);
+	if (dma_mapping_error(macb->dev, paddr))
+		return -EFAULT;
+
+	macb->rx_bufs_phys[i] = paddr;
+	gem_rx_set_desc(macb, i);
+
+	return 0;
+}
+
+/*
+ * Provide a mapped packet buffer the network stack can swap in when it takes
+ * over a receive buffer. Without one the received frame is copied instead.
+ */
+static void *gem_get_rx_spare(struct macb_device *macb)
+{
+	dma_addr_t paddr;
+	void *p;
+
+	if (macb->rx_spare)
+		return macb->rx_spare;
+
+	p = net_alloc_packet();
+	if (!p)
+		return NULL;
+
+	paddr = dma_map_single(macb->dev, p, macb->rx_buffer_size,
+			       DMA_FROM_DEVICE);
+	if (dma_mapping_error(macb->dev, paddr)) {
+		net_free_packet(p);
+		return NULL;
+	}
+
+	macb->rx_spare = p;
+	macb->rx_spare_phys = paddr;
+
+	return p;
+}
+
 static void gem_recv(struct eth_device *edev)
 {
 	struct macb_device *macb = edev->priv;
@@ -185,12 +243,22 @@ static void gem_recv(struct eth_device *edev)
 
 		status = readl(&macb->rx_ring[macb->rx_tail].ctrl);
 		length = MACB_BFEXT(RX_FRMLEN, status);
-		buffer = macb->rx_buffer_phys + macb->rx_buffer_size * macb->rx_tail;
+		buffer = macb->rx_bufs_phys[macb->rx_tail];
 		dma_sync_single_for_cpu(macb->dev, buffer, length, DMA_FROM_DEVICE);
-		net_receive(edev,
-			    macb->rx_buffer + macb->rx_buffer_size * macb->rx_tail,
-			    length);
-		dma_sync_single_for_device(macb->dev, buffer, length, DMA_FROM_DEVICE);
+		if (net_receive_buf(edev, macb->rx_bufs[macb->rx_tail],
+				    macb->rx_bufs[macb->rx_tail], length,
+				    gem_get_rx_spare(macb))) {
+			/* the buffer was taken over, use the spare */
+			dma_unmap_single(macb->dev, buffer, macb->rx_buffer_size,
+					 DMA_FROM_DEVICE);
+			macb->rx_bufs[macb->rx_tail] = macb->rx_spare;
+			macb->rx_bufs_phys[macb->rx_tail] = macb->rx_spare_phys;
+			macb->rx_spare = NULL;
+			gem_rx_set_desc(macb, macb->rx_tail);
+		} else {
+			dma_sync_single_for_device(macb->dev, buffer, length,
+						   DMA_FROM_DEVICE);
+		}
 		clrbits_le32(&macb->rx_ring[macb->rx_tail].addr, MACB_BIT(RX_USED));
 
 		macb->rx_tail++;
@@ -375,25 +443,34 @@ static int gmac_init_dummy_tx_queues(struct macb_device *macb)
 
 static int macb_init(struct macb_device *macb)
 {
-	unsigned long paddr, val = 0;
-	int i;
+	unsigned long paddr = 0, val = 0;
+	int i, ret;
 
 	/*
 	 * macb_halt should have been called at some point before now,
 	 * so we'll assume the controller is idle.
 	 */
-	macb->rx_buffer_phys = dma_map_single(macb->dev, macb->rx_buffer,
-					      macb->rx_buffer_size * macb->rx_ring_size,
-					      DMA_FROM_DEVICE);
-	if (dma_mapping_error(macb->dev, macb->rx_buffer_phys))
-		return -EFAULT;
+	if (!macb->is_gem) {
+		macb->rx_buffer_phys = dma_map_single(macb->dev, macb->rx_buffer,
+						      macb->rx_buffer_size * macb->rx_ring_size,
+						      DMA_FROM_DEVICE);
+		if (dma_mapping_error(macb->dev, macb->rx_buffer_phys))
+			return -EFAULT;
+
+		paddr = macb->rx_buffer_phys;
+	}
 
 	/* initialize DMA descriptors */
-	paddr = macb->rx_buffer_phys;
 	for (i = 0; i < macb->rx_ring_size; i++) {
-		writel(paddr, &macb->rx_ring[i].addr);
+		if (macb->is_gem) {
+			ret = gem_rx_map(macb, i);
+			if (ret)
+				return ret;
+		} else {
+			writel(paddr, &macb->rx_ring[i].addr);
+			paddr += macb->rx_buffer_size;
+		}
 		writel(0, &macb->rx_ring[i].ctrl);
-		paddr += macb->rx_buffer_size;
 	}
 	setbits_le32(&macb->rx_ring[macb->rx_ring_size - 1].addr, MACB_BIT(RX_WRAP));
 
@@ -449,6 +526,7 @@ static void macb_halt(struct eth_device *edev)
 {
 	struct macb_device *macb = edev->priv;
 	u32 ncr, tsr;
+	int i;
 
 	/* Halt the controller and wait for any ongoing transmission to end. */
 	ncr = macb_readl(macb, NCR);
@@ -462,10 +540,25 @@ static void macb_halt(struct eth_device *edev)
 	/* Disable TX and RX, and clear statistics */
 	macb_writel(macb, NCR, MACB_BIT(CLRSTAT));
 
-	dma_unmap_single(macb->dev, macb->rx_buffer_phys,
-			 macb->rx_buffer_size * macb->rx_ring_size,
-			 DMA_FROM_DEVICE);
-	free(macb->rx_buffer);
+	if (macb->is_gem) {
+		for (i = 0; i < macb->rx_ring_size; i++)
+			dma_unmap_single(macb->dev, macb->rx_bufs_phys[i],
+					 macb->rx_buffer_size, DMA_FROM_DEVICE);
+		net_free_packets(macb->rx_bufs, macb->rx_ring_size);
+		free(macb->rx_bufs);
+		free(macb->rx_bufs_phys);
+		if (macb->rx_spare) {
+			dma_unmap_single(macb->dev, macb->rx_spare_phys,
+					 macb->rx_buffer_size, DMA_FROM_DEVICE);
+			net_free_packet(macb->rx_spare);
+			macb->rx_spare = NULL;
+		}
+	} else {
+		dma_unmap_single(macb->dev, macb->rx_buffer_phys,
+				 macb->rx_buffer_size * macb->rx_ring_size,
+				 DMA_FROM_DEVICE);
+		free(macb->rx_buffer);
+	}
 	dma_free_coherent(DMA_DEVICE_BROKEN,
 			  (void *)macb->rx_ring, macb->rx_ring_phys, RX_RING_BYTES(macb));
 	dma_free_coherent(DMA_DEVICE_BROKEN,
@@ -901,7 +994,24 @@ static int macb_probe(struct device *dev)
 		edev->recv = macb_recv;
 
 	macb_init_rx_buffer_size(macb, PKTSIZE);
-	macb->rx_buffer = dma_alloc(macb->rx_buffer_size * macb->rx_ring_size);
+	if (macb->is_gem) {
+		/*
+		 * GEM receives each frame into a single buffer. Give every
+		 * descriptor its own packet buffer, so the network stack can
+		 * take over received frames without copying them.
+		 */
+		macb->rx_bufs = xzalloc(macb->rx_ring_size * sizeof(*macb->rx_bufs));
+		macb->rx_bufs_phys = xzalloc(macb->rx_ring_size *
+					     sizeof(*macb->rx_bufs_phys));
+		ret = net_alloc_packets(macb->rx_bufs, macb->rx_ring_size);
+		if (ret) {
+			free(macb->rx_bufs);
+			free(macb->rx_bufs_phys);
+			return ret;
+		}
+	} else {
+		macb->rx_buffer = dma_alloc(macb->rx_buffer_size * macb->rx_ring_size);
+	}
 	macb->rx_ring = dma_alloc_coherent(DMA_DEVICE_BROKEN,
 					   RX_RING_BYTES(macb), &macb->rx_ring_phys);
 	macb->tx_ring = dma_alloc_coherent(DMA_DEVICE_BROKEN,
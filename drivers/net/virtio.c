@@ -22,6 +22,9 @@
  */
 #define VIRTIO_NET_RX_BUF_SIZE	1526
 
+/* Maximum number of packets added to the TX virtqueue before kicking it */
+#define VIRTIO_NET_TX_BATCH	8
+
 struct virtio_net_priv {
 	union {
 		struct virtqueue *vqs[2];
@@ -31,7 +34,7 @@ struct virtio_net_priv {
 		};
 	};
 
-	char rx_buff[VIRTIO_NET_NUM_RX_BUFS][VIRTIO_NET_RX_BUF_SIZE];
+	void *rx_spare;		/* replacement for a buffer taken over */
 	bool rx_running;
 	int net_hdr_len;
 	struct eth_device edev;
@@ -43,21 +46,32 @@ static inline struct virtio_net_priv *to_priv(struct eth_device *edev)
 	return container_of(edev, struct virtio_net_priv, edev);
 }
 
+static void virtio_net_add_rx_buf(struct virtio_net_priv *priv, void *buf)
+{
+	struct scatterlist sg;
+
+	BUILD_BUG_ON(VIRTIO_NET_RX_BUF_SIZE > PKTSIZE);
+
+	/* receive buffer length is always 1526 */
+	sg_init_one(&sg, buf, VIRTIO_NET_RX_BUF_SIZE);
+	virtqueue_add_inbuf(priv->rx_vq, &sg, 1, buf);
+}
+
 static int virtio_net_start(struct eth_device *edev)
 {
 	struct virtio_net_priv *priv = to_priv(edev);
-	struct scatterlist sg;
+	void *buf;
 	int i;
 
 	if (!priv->rx_running) {
 
 		/* setup the receive buffer address */
 		for (i = 0; i < VIRTIO_NET_NUM_RX_BUFS; i++) {
-			/* receive buffer length is always 1526 */
-			sg.length = VIRTIO_NET_RX_BUF_SIZE;
+			buf = net_alloc_packet();
+			if (!buf)
+				return -ENOMEM;
 
-			sg_init_one(&sg, priv->rx_buff[i], VIRTIO_NET_RX_BUF_SIZE);
-			virtqueue_add_inbuf(priv->rx_vq, &sg, 1, priv->rx_buff[i]);
+			virtio_net_add_rx_buf(priv, buf);
 		}
 
 		virtqueue_kick(priv->rx_vq);
@@ -69,55 +83,83 @@ static int virtio_net_start(struct eth_device *edev)
 	return 0;
 }
 
-static int virtio_net_send(struct eth_device *edev, void *packet, int length)
+static int virtio_net_send_many(struct eth_device *edev,
+				struct eth_tx_packet *packets, int num)
 {
 	struct virtio_net_priv *priv = to_priv(edev);
-	struct virtio_net_hdr_v1 hdr_v1 = {};
-	struct virtio_net_hdr hdr = {};
-	struct scatterlist sgs[2];
-	int ret;
+	/* all-zero and only read by the device, so shared by all packets */
+	struct virtio_net_hdr_v1 hdr = {};
+	struct scatterlist sgs[VIRTIO_NET_TX_BATCH][2];
+	int i, n, queued, ret = 0;
+
+	while (num) {
+		n = min(num, VIRTIO_NET_TX_BATCH);
+
+		for (queued = 0; queued < n; queued++) {
+			struct scatterlist *sg = sgs[queued];
+
+			sg_init_table(sg, 2);
+			sg_set_buf(&sg[0], &hdr, priv->net_hdr_len);
+			sg_set_buf(&sg[1], packets[queued].data,
+				   packets[queued].length);
+
+			ret = virtqueue_add_outbuf(priv->tx_vq, sg, 2,
+						   &sg[0].address);
+			if (ret)
+				break;
+		}
 
-	sg_init_table(sgs, ARRAY_SIZE(sgs));
+		/* notify the device once for the whole batch */
+		virtqueue_kick(priv->tx_vq);
 
-	if (priv->net_hdr_len == sizeof(struct virtio_net_hdr))
-		sg_set_buf(&sgs[0], &hdr, priv->net_hdr_len);
-	else
-		sg_set_buf(&sgs[0], &hdr_v1, priv->net_hdr_len);
+		for (i = 0; i < queued; i++)
+			if (!virtqueue_get_buf_timeout(priv->tx_vq, NULL,
+						       NSEC_PER_SEC))
+				return -ETIMEDOUT;
 
-	sg_set_buf(&sgs[1], packet, length);
+		if (ret)
+			return ret;
 
-	ret = virtqueue_add_outbuf(priv->tx_vq, sgs, ARRAY_SIZE(sgs), &sgs[0].address);
-	if (ret)
-		return ret;
+		packets += n;
+		num -= n;
+	}
 
-	virtqueue_kick(priv->tx_vq);
+	return 0;
+}
 
-	if (!virtqueue_get_buf_timeout(priv->tx_vq, NULL, NSEC_PER_SEC))
-		return -ETIMEDOUT;
+static int virtio_net_send(struct eth_device *edev, void *packet, int length)
+{
+	struct eth_tx_packet p = {
+		.data = packet,
+		.length = length,
+	};
 
-	return 0;
+	return virtio_net_send_many(edev, &p, 1);
 }
 
 static void virtio_net_recv(struct eth_device *edev)
 {
 	struct virtio_net_priv *priv = to_priv(edev);
-	struct scatterlist sg;
 	unsigned int len;
-	void *buf, *addr;
+	void *addr;
 
 	addr = virtqueue_get_buf(priv->rx_vq, &len);
 	if (!addr)
 		return;
 
-	sg_init_one(&sg, addr, VIRTIO_NET_RX_BUF_SIZE);
-
-	buf = sg.address + priv->net_hdr_len;
 	len -= priv->net_hdr_len;
 
-	net_receive(edev, buf, len);
+	if (!priv->rx_spare)
+		priv->rx_spare = net_alloc_packet();
+
+	/* Put the buffer back to the rx ring, or the spare if it was taken */
+	if (net_receive_buf(edev, addr, addr + priv->net_hdr_len, len,
+			    priv->rx_spare)) {
+		addr = priv->rx_spare;
+		priv->rx_spare = NULL;
+	}
 
-	/* Put the buffer back to the rx ring */
-	virtqueue_add_inbuf(priv->rx_vq, &sg, 1, addr);
+	virtio_net_add_rx_buf(priv, addr);
 }
 
 static void virtio_net_stop(struct eth_device *dev)
@@ -200,6 +242,7 @@ static int virtio_net_probe(struct virtio_device *vdev)
 
 	edev->open = virtio_net_start;
 	edev->send = virtio_net_send;
+	edev->send_many = virtio_net_send_many;
 	edev->recv = virtio_net_recv;
 	edev->halt = virtio_net_stop;
 	edev->get_ethaddr = virtio_net_read_rom_hwaddr;
@@ -315,8 +315,40 @@ static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
 	 */
 	const u32 max_hw_sectors =
 		ns->ctrl->max_hw_sectors >> (ns->lba_shift - 9);
+	struct nvme_batch_cmd *cmds;
+	unsigned int i, num;
 	int ret;
 
+	/*
+	 * Large transfers are split into multiple commands. When the
+	 * transport supports it, hand them over in one go so the
+	 * controller can work on them in parallel.
+	 */
+	if (num_blocks > max_hw_sectors && ns->ctrl->ops->submit_cmds) {
+		blkcnt_t left = num_blocks;
+
+		num = DIV_ROUND_UP(num_blocks, max_hw_sectors);
+		cmds = xzalloc(num * sizeof(*cmds));
+
+		for (i = 0; i < num; i++) {
+			const u32 chunk = min_t(blkcnt_t, left, max_hw_sectors);
+			const blkcnt_t done = num_blocks - left;
+
+			cmds[i].cmd.rw.opcode = cmnd->rw.opcode;
+			nvme_setup_rw(ns, &cmds[i].cmd, block + done, chunk);
+			cmds[i].buffer = buffer + (done << ns->lba_shift);
+			cmds[i].buffer_len = chunk << ns->lba_shift;
+
+			left -= chunk;
+		}
+
+		ret = ns->ctrl->ops->submit_cmds(ns->ctrl, cmds, num, 0,
+						 NVME_QID_IO);
+		free(cmds);
+
+		goto out;
+	}
+
 	if (num_blocks > max_hw_sectors) {
 		while (num_blocks) {
 			const u32 chunk = min_t(blkcnt_t, num_blocks,
@@ -328,7 +360,7 @@ static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
 				break;
 
 			num_blocks -= chunk;
-			buffer += chunk;
+			buffer += chunk << ns->lba_shift;
 			block += chunk;
 		}
 
@@ -340,7 +372,7 @@ static int nvme_submit_sync_rw(struct nvme_ns *ns, struct nvme_command *cmnd,
 	ret = __nvme_submit_sync_cmd(ns->ctrl, cmnd, NULL, buffer,
 				     num_blocks << ns->lba_shift,
 				     0, NVME_QID_IO);
-
+out:
 	if (ret) {
 		dev_err(ns->ctrl->dev,
 			"I/O failed: block: %llu, num blocks: %llu, status code type: %xh, status code %02xh\n",
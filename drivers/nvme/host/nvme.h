@@ -28,6 +28,15 @@ struct nvme_request {
 	enum dma_data_direction dma_dir;
 };
 
+/*
+ * One command of a batch passed to nvme_ctrl_ops::submit_cmds
+ */
+struct nvme_batch_cmd {
+	struct nvme_command cmd;
+	void *buffer;
+	unsigned int buffer_len;
+};
+
 struct nvme_ctrl {
 	const struct nvme_ctrl_ops *ops;
 	struct device *dev;
@@ -78,6 +87,14 @@ struct nvme_ctrl_ops {
 			       void *buffer,
 			       unsigned bufflen,
 			       unsigned timeout, int qid);
+	/*
+	 * Optional: submit @num commands keeping as many of them in flight as
+	 * the queue allows. Returns 0, a negative error code or the first
+	 * NVMe status reported by a failing command.
+	 */
+	int (*submit_cmds)(struct nvme_ctrl *ctrl,
+			   struct nvme_batch_cmd *cmds, unsigned int num,
+			   unsigned timeout, int qid);
 };
 
 static inline bool nvme_ctrl_ready(struct nvme_ctrl *ctrl)
@@ -15,17 +15,28 @@
 
 #define NVME_MAX_KB_SZ	4096
 
-static int io_queue_depth = 2;
+static int io_queue_depth = 64;
 
 struct nvme_dev;
 
+/*
+ * PRP list of a single command slot. Each slot in a queue has its own
+ * list so that several data transfers can be in flight at the same time.
+ */
+struct nvme_prp_list {
+	__le64 *prps;
+	dma_addr_t dma;
+	unsigned int size;
+};
+
 /*
  * An NVM Express queue.  Each device has at least two (one for admin
  * commands and one for I/O commands).
  */
 struct nvme_queue {
 	struct nvme_dev *dev;
-	struct nvme_request *req;
+	struct nvme_request **reqs;	/* in-flight requests, indexed by tag */
+	struct nvme_prp_list *prp_lists;
 	struct nvme_command *sq_cmds;
 	volatile struct nvme_completion *cqes;
 	dma_addr_t sq_dma_addr;
@@ -54,9 +65,6 @@ struct nvme_dev {
 	void __iomem *bar;
 	bool subsystem;
 	struct nvme_ctrl ctrl;
-	__le64 *prp_pool;
-	unsigned int prp_pool_size;
-	dma_addr_t prp_dma;
 };
 
 static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
@@ -65,6 +73,7 @@ static inline struct nvme_dev *to_nvme_dev(struct nvme_ctrl *ctrl)
 }
 
 static int nvme_pci_setup_prps(struct nvme_dev *dev,
+			       struct nvme_prp_list *pl,
 			       const struct nvme_request *req,
 			       struct nvme_rw_command *cmnd)
 {
@@ -73,37 +82,48 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 	dma_addr_t dma_addr = req->buffer_dma_addr;
 	u32 offset = dma_addr & (page_size - 1);
 	u64 prp1 = dma_addr;
+	u64 prp2;
 	__le64 *prp_list;
 	int i, nprps;
 	dma_addr_t prp_dma;
 
-
 	length -= (page_size - offset);
 	if (length <= 0) {
-		prp_dma = 0;
+		prp2 = 0;
 		goto done;
 	}
 
 	dma_addr += (page_size - offset);
 
 	if (length <= page_size) {
-		prp_dma = dma_addr;
+		prp2 = dma_addr;
 		goto done;
 	}
 
+	/*
+	 * The last entry of every full list page chains to the next page,
+	 * so allocate whole pages holding page_size / 8 - 1 data entries.
+	 */
 	nprps = DIV_ROUND_UP(length, page_size);
-	if (nprps > dev->prp_pool_size) {
-		dma_free_coherent(DMA_DEVICE_BROKEN,
-				  dev->prp_pool, dev->prp_dma,
-				  dev->prp_pool_size * sizeof(u64));
-		dev->prp_pool_size = nprps;
-		dev->prp_pool = dma_alloc_coherent(DMA_DEVICE_BROKEN,
-						   nprps * sizeof(u64),
-						   &dev->prp_dma);
+	nprps = DIV_ROUND_UP(nprps, (page_size >> 3) - 1) * (page_size >> 3);
+	if (nprps > pl->size) {
+		if (pl->prps)
+			dma_free_coherent(DMA_DEVICE_BROKEN, pl->prps, pl->dma,
+					  pl->size * sizeof(u64));
+		pl->prps = dma_alloc_coherent(DMA_DEVICE_BROKEN,
+					      nprps * sizeof(u64), &pl->dma);
+		if (!pl->prps) {
+			pl->size = 0;
+			return -ENOMEM;
+		}
+		pl->size = nprps;
 	}
 
-	prp_list = dev->prp_pool;
-	prp_dma  = dev->prp_dma;
+	prp_list = pl->prps;
+	prp_dma  = pl->dma;
+
+	/* prp2 points to the first list page, further pages are chained */
+	prp2 = prp_dma;
 
 	i = 0;
 	for (;;) {
@@ -125,13 +145,16 @@ static int nvme_pci_setup_prps(struct nvme_dev *dev,
 
 done:
 	cmnd->dptr.prp1 = cpu_to_le64(prp1);
-	cmnd->dptr.prp2 = cpu_to_le64(prp_dma);
+	cmnd->dptr.prp2 = cpu_to_le64(prp2);
 
 	return 0;
 }
 
-static int nvme_map_data(struct nvme_dev *dev, struct nvme_request *req)
+static int nvme_map_data(struct nvme_dev *dev, struct nvme_prp_list *pl,
+			 struct nvme_request *req)
 {
+	int ret;
+
 	if (!req->buffer || !req->buffer_len)
 		return 0;
 
@@ -140,7 +163,12 @@ static int nvme_map_data(struct nvme_dev *dev, struct nvme_request *req)
 	if (dma_mapping_error(dev->dev, req->buffer_dma_addr))
 		return -EFAULT;
 
-	return nvme_pci_setup_prps(dev, req, &req->cmd->rw);
+	ret = nvme_pci_setup_prps(dev, pl, req, &req->cmd->rw);
+	if (ret)
+		dma_unmap_single(dev->dev, req->buffer_dma_addr,
+				 req->buffer_len, req->dma_dir);
+
+	return ret;
 }
 
 static void nvme_unmap_data(struct nvme_dev *dev, struct nvme_request *req)
@@ -171,6 +199,9 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	if (!nvmeq->sq_cmds)
 		goto free_cqdma;
 
+	nvmeq->reqs = xzalloc(depth * sizeof(*nvmeq->reqs));
+	nvmeq->prp_lists = xzalloc(depth * sizeof(*nvmeq->prp_lists));
+
 	nvmeq->dev = dev;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
@@ -285,19 +316,52 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 }
 
 /**
- * nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
+ * nvme_queue_cmd() - Copy a command into a queue without ringing the doorbell
  * @nvmeq: The queue to use
  * @cmd: The command to send
  */
-static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+static void nvme_queue_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 {
 	memcpy(&nvmeq->sq_cmds[nvmeq->sq_tail], cmd, sizeof(*cmd));
 
 	if (++nvmeq->sq_tail == nvmeq->q_depth)
 		nvmeq->sq_tail = 0;
+}
+
+static inline void nvme_ring_sq_doorbell(struct nvme_queue *nvmeq)
+{
 	writel(nvmeq->sq_tail, nvmeq->q_db);
 }
 
+/**
+ * nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
+ * @nvmeq: The queue to use
+ * @cmd: The command to send
+ */
+static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
+{
+	nvme_queue_cmd(nvmeq, cmd);
+	nvme_ring_sq_doorbell(nvmeq);
+}
+
+/*
+ * Find a free command slot. Completions may arrive out of order, so
+ * skip tags that are still in flight.
+ */
+static int nvme_get_tag(struct nvme_queue *nvmeq)
+{
+	int i;
+
+	for (i = 0; i < nvmeq->q_depth; i++) {
+		u16 tag = nvmeq->counter++ % nvmeq->q_depth;
+
+		if (!nvmeq->reqs[tag])
+			return tag;
+	}
+
+	return -EBUSY;
+}
+
 /* We read the CQE phase first to check if the rest of the entry is valid */
 static inline bool nvme_cqe_pending(struct nvme_queue *nvmeq)
 {
@@ -312,22 +376,27 @@ static inline void nvme_ring_cq_doorbell(struct nvme_queue *nvmeq)
 	writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
 }
 
-static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
+static inline struct nvme_request *nvme_handle_cqe(struct nvme_queue *nvmeq,
+						   u16 idx)
 {
 	volatile struct nvme_completion *cqe = &nvmeq->cqes[idx];
-	struct nvme_request *req = nvmeq->req;
+	struct nvme_request *req;
 
 	if (unlikely(cqe->command_id >= nvmeq->q_depth)) {
 		dev_warn(nvmeq->dev->ctrl.dev,
 			"invalid id %d completed on queue %d\n",
 			cqe->command_id, le16_to_cpu(cqe->sq_id));
-		return;
+		return NULL;
 	}
 
-	if (WARN_ON(cqe->command_id != req->cmd->common.command_id))
-		return;
+	req = nvmeq->reqs[cqe->command_id];
+	if (!req)
+		return NULL;
 
+	nvmeq->reqs[cqe->command_id] = NULL;
 	nvme_end_request(req, cqe->status, cqe->result);
+
+	return req;
 }
 
 static void nvme_complete_cqes(struct nvme_queue *nvmeq, u16 start, u16 end)
@@ -379,20 +448,8 @@ static bool nvme_poll(struct nvme_queue *nvmeq, unsigned int tag)
 	return found;
 }
 
-static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
-				    struct nvme_command *cmd,
-				    union nvme_result *result,
-				    void *buffer,
-				    unsigned int buffer_len,
-				    unsigned timeout, int qid)
+static int nvme_pci_dma_dir(struct nvme_command *cmd, int qid)
 {
-	struct nvme_dev *dev = to_nvme_dev(ctrl);
-	struct nvme_queue *nvmeq = &dev->queues[qid];
-	struct nvme_request req = { };
-	const u16 tag = nvmeq->counter++ & (nvmeq->q_depth - 1);
-	enum dma_data_direction dma_dir;
-	int ret;
-
 	switch (qid) {
 	case NVME_QID_ADMIN:
 		switch (cmd->common.opcode) {
@@ -402,31 +459,47 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 		case nvme_admin_delete_cq:
 		case nvme_admin_sanitize_nvm:
 		case nvme_admin_set_features:
-			dma_dir = DMA_TO_DEVICE;
-			break;
+			return DMA_TO_DEVICE;
 		case nvme_admin_identify:
 		case nvme_admin_get_log_page:
-			dma_dir = DMA_FROM_DEVICE;
-			break;
+			return DMA_FROM_DEVICE;
 		default:
 			return -EINVAL;
 		}
-		break;
 	case NVME_QID_IO:
 		switch (cmd->rw.opcode) {
 		case nvme_cmd_write:
-			dma_dir = DMA_TO_DEVICE;
-			break;
+			return DMA_TO_DEVICE;
 		case nvme_cmd_read:
-			dma_dir = DMA_FROM_DEVICE;
-			break;
+			return DMA_FROM_DEVICE;
 		default:
 			return -EINVAL;
 		}
-		break;
 	default:
 		return -EINVAL;
 	}
+}
+
+static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
+				    struct nvme_command *cmd,
+				    union nvme_result *result,
+				    void *buffer,
+				    unsigned int buffer_len,
+				    unsigned timeout, int qid)
+{
+	struct nvme_dev *dev = to_nvme_dev(ctrl);
+	struct nvme_queue *nvmeq = &dev->queues[qid];
+	struct nvme_request req = { };
+	int tag, dma_dir;
+	int ret;
+
+	dma_dir = nvme_pci_dma_dir(cmd, qid);
+	if (dma_dir < 0)
+		return dma_dir;
+
+	tag = nvme_get_tag(nvmeq);
+	if (tag < 0)
+		return tag;
 
 	cmd->common.command_id = tag;
 
@@ -437,17 +510,17 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 	req.buffer_len = buffer_len;
 	req.dma_dir    = dma_dir;
 
-	ret = nvme_map_data(dev, &req);
+	ret = nvme_map_data(dev, &nvmeq->prp_lists[tag], &req);
 	if (ret) {
 		dev_err(dev->dev, "Failed to map request data\n");
 		return ret;
 	}
 
+	nvmeq->reqs[tag] = &req;
 	nvme_submit_cmd(nvmeq, cmd);
 
-	nvmeq->req = &req;
 	ret = wait_on_timeout(timeout, nvme_poll(nvmeq, tag));
-	nvmeq->req = NULL;
+	nvmeq->reqs[tag] = NULL;
 
 	nvme_unmap_data(dev, &req);
 
@@ -457,6 +530,120 @@ static int nvme_pci_submit_sync_cmd(struct nvme_ctrl *ctrl,
 	return ret ?: req.status;
 }
 
+/*
+ * Submit a batch of commands to an I/O queue. The submission queue is
+ * filled with as many commands as it can hold before the doorbell is
+ * rung once, then completions are reaped in batches and the freed slots
+ * are refilled until all commands have completed.
+ */
+static int nvme_pci_submit_cmds(struct nvme_ctrl *ctrl,
+				struct nvme_batch_cmd *cmds, unsigned int num,
+				unsigned timeout, int qid)
+{
+	struct nvme_dev *dev = to_nvme_dev(ctrl);
+	struct nvme_queue *nvmeq = &dev->queues[qid];
+	struct nvme_request *reqs;
+	unsigned int submitted = 0, completed = 0;
+	int ret = 0;
+
+	if (qid == NVME_QID_ADMIN || !nvmeq->q_depth)
+		return -EINVAL;
+
+	timeout = timeout ?: ADMIN_TIMEOUT;
+
+	reqs = xzalloc(num * sizeof(*reqs));
+
+	while (completed < submitted || (submitted < num && !ret)) {
+		unsigned int queued = 0;
+		u16 start, end;
+
+		/*
+		 * Keep one slot free: a full submission queue is
+		 * indistinguishable from an empty one.
+		 */
+		while (submitted < num && !ret &&
+		       submitted - completed < nvmeq->q_depth - 1) {
+			struct nvme_batch_cmd *bc = &cmds[submitted];
+			struct nvme_request *req = &reqs[submitted];
+			int tag, dma_dir;
+
+			dma_dir = nvme_pci_dma_dir(&bc->cmd, qid);
+			if (dma_dir < 0) {
+				ret = dma_dir;
+				break;
+			}
+
+			tag = nvme_get_tag(nvmeq);
+			if (tag < 0) {
+				ret = tag;
+				break;
+			}
+
+			bc->cmd.common.command_id = tag;
+
+			req->cmd        = &bc->cmd;
+			req->buffer     = bc->buffer;
+			req->buffer_len = bc->buffer_len;
+			req->dma_dir    = dma_dir;
+
+			ret = nvme_map_data(dev, &nvmeq->prp_lists[tag], req);
+			if (ret) {
+				dev_err(dev->dev, "Failed to map request data\n");
+				break;
+			}
+
+			nvmeq->reqs[tag] = req;
+			nvme_queue_cmd(nvmeq, &bc->cmd);
+			submitted++;
+			queued++;
+		}
+
+		if (queued)
+			nvme_ring_sq_doorbell(nvmeq);
+
+		if (completed == submitted)
+			break;
+
+		if (wait_on_timeout(timeout, nvme_cqe_pending(nvmeq))) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+
+		nvme_process_cq(nvmeq, &start, &end, -1);
+
+		for (; start != end; start = (start + 1) % nvmeq->q_depth) {
+			struct nvme_request *req = nvme_handle_cqe(nvmeq, start);
+
+			if (!req)
+				continue;
+
+			nvme_unmap_data(dev, req);
+			completed++;
+
+			if (req->status && !ret)
+				ret = req->status;
+		}
+	}
+
+	if (ret == -ETIMEDOUT) {
+		unsigned int i;
+
+		/* forget about the requests that never completed */
+		for (i = 0; i < nvmeq->q_depth; i++) {
+			struct nvme_request *req = nvmeq->reqs[i];
+
+			if (req >= reqs && req < reqs + num) {
+				nvmeq->reqs[i] = NULL;
+				nvme_unmap_data(dev, req);
+			}
+		}
+	}
+
+	free(reqs);
+
+	return ret;
+}
+
 static int nvme_pci_configure_admin_queue(struct nvme_dev *dev)
 {
 	int result;
@@ -615,6 +802,7 @@ static const struct nvme_ctrl_ops nvme_pci_ctrl_ops = {
 	.reg_write32		= nvme_pci_reg_write32,
 	.reg_read64		= nvme_pci_reg_read64,
 	.submit_sync_cmd	= nvme_pci_submit_sync_cmd,
+	.submit_cmds		= nvme_pci_submit_cmds,
 };
 
 static void nvme_dev_map(struct nvme_dev *dev)
@@ -494,8 +494,14 @@ int of_device_ensure_probed(struct device_node *np)
 {
 	struct device *dev;
 
-	if (!np || !deep_probe_is_supported())
+	if (!np)
+		return 0;
+
+	if (!deep_probe_is_supported()) {
+		/* let deferred probe know what we are waiting for */
+		device_probe_note_supplier(np);
 		return 0;
+	}
 
 	dev = of_device_create_on_demand(np);
 	if (IS_ERR_OR_NULL(dev))
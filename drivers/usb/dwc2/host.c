@@ -776,6 +776,8 @@ int dwc2_register_host(struct dwc2 *dwc2)
 	host->hw_dev = dwc2->dev;
 	host->init = dwc2_host_init;
 	host->submit_bulk_msg = dwc2_submit_bulk_msg;
+	/* dwc2_submit_packet() splits into channel sized chunks itself */
+	host->max_bulk_len = INT_MAX;
 	host->submit_control_msg = dwc2_submit_control_msg;
 	host->submit_int_msg = dwc2_submit_int_msg;
 
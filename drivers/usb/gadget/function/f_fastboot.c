@@ -163,6 +163,7 @@ static void rx_handler_command(struct usb_ep *ep, struct usb_request *req);
 static int fastboot_write_usb(struct fastboot *fb, const char *buffer,
 			      unsigned int buffer_size);
 static void fastboot_start_download_usb(struct fastboot *fb);
+static void fastboot_resume_download_usb(struct fastboot *fb);
 
 struct fastboot_work {
 	struct work_struct work;
@@ -231,6 +232,7 @@ static int fastboot_bind(struct usb_configuration *c, struct usb_function *f)
 
 	f_fb->fastboot.write = fastboot_write_usb;
 	f_fb->fastboot.start_download = fastboot_start_download_usb;
+	f_fb->fastboot.resume_download = fastboot_resume_download_usb;
 
 	f_fb->fastboot.files = opts->common.files;
 	f_fb->fastboot.cmd_exec = opts->common.cmd_exec;
@@ -483,12 +485,25 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 		req->length = EP_BUFFER_SIZE;
 
 		fastboot_download_finished(&f_fb->fastboot);
+	} else if (ret == FASTBOOT_DOWNLOAD_STALL) {
+		/* requeued in fastboot_resume_download_usb() */
+		return;
 	}
 
 	req->actual = 0;
 	usb_ep_queue(ep, req);
 }
 
+static void fastboot_resume_download_usb(struct fastboot *fb)
+{
+	struct f_fastboot *f_fb = container_of(fb, struct f_fastboot, fastboot);
+	struct usb_request *req = f_fb->out_req;
+
+	req->length = rx_bytes_expected(f_fb);
+	req->actual = 0;
+	usb_ep_queue(f_fb->out_ep, req);
+}
+
 static void fastboot_start_download_usb(struct fastboot *fb)
 {
 	struct f_fastboot *f_fb = container_of(fb, struct f_fastboot, fastboot);
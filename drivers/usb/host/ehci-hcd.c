@@ -1385,6 +1385,8 @@ struct ehci_host *ehci_register(struct device *dev, struct ehci_data *data)
 	host->submit_int_msg = submit_int_msg;
 	host->submit_control_msg = submit_control_msg;
 	host->submit_bulk_msg = submit_bulk_msg;
+	/* a single qTD with five page pointers, buffer may be unaligned */
+	host->max_bulk_len = 4 * SZ_4K;
 
 	if (ehci->flags & EHCI_HAS_TT) {
 		ehci_reset(ehci);
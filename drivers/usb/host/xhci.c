@@ -24,6 +24,7 @@
 #include <init.h>
 #include <io.h>
 #include <linux/err.h>
+#include <linux/sizes.h>
 #include <linux/usb/usb.h>
 #include <linux/usb/xhci.h>
 #include <asm/unaligned.h>
@@ -1388,6 +1389,8 @@ int xhci_register(struct xhci_ctrl *ctrl)
 	host->submit_int_msg = xhci_submit_int_msg;
 	host->submit_control_msg = xhci_submit_control_msg;
 	host->submit_bulk_msg = xhci_submit_bulk_msg;
+	/* limited by the bounce buffer, see xhci_bulk_tx() */
+	host->max_bulk_len = SZ_64K;
 	host->alloc_device = xhci_alloc_device;
 	host->update_hub_device = xhci_update_hub_device;
 
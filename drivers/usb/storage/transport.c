@@ -131,17 +131,26 @@ int usb_stor_Bulk_transport(struct us_blk_dev *usb_blkdev,
 
 	mdelay(1);
 
+	/*
+	 * The host controller may not be able to transfer the whole payload
+	 * at once. Split it into several bulk transfers, the device doesn't
+	 * care as long as all but the last are multiples of the packet size.
+	 */
 	data_actlen = 0;
-	if (datalen) {
+	while (data_actlen < datalen) {
 		unsigned int pipe = dir_in ? pipein : pipeout;
-		result = usb_bulk_msg(us->pusb_dev, pipe, data,
-		                      datalen, &data_actlen, USB_BULK_TO);
+		u32 len = min(datalen - data_actlen, us->max_bulk_len);
+
+		result = usb_bulk_msg(us->pusb_dev, pipe, data + data_actlen,
+		                      len, &actlen, USB_BULK_TO);
 		dev_dbg(dev, "Bulk data transfer result 0x%x\n", result);
 		/* special handling of STALL in DATA phase */
 		if ((result < 0) && (us->pusb_dev->status & USB_ST_STALLED)) {
 			dev_dbg(dev, "DATA: stall\n");
 			/* clear the STALL on the endpoint */
 			result = usb_stor_Bulk_clear_endpt_stall(us, pipe);
+			if (result >= 0)
+				break;
 		}
 		if (result < 0) {
 			dev_dbg(dev, "Device status: %lx\n", us->pusb_dev->status);
@@ -149,6 +158,12 @@ int usb_stor_Bulk_transport(struct us_blk_dev *usb_blkdev,
 			ret = USB_STOR_TRANSPORT_FAILED;
 			goto fail;
 		}
+
+		data_actlen += actlen;
+
+		/* a short packet ends the data stage */
+		if (actlen < len)
+			break;
 	}
 
 	/* STATUS phase + error handling */
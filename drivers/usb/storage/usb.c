@@ -16,6 +16,8 @@
 #include <linux/usb/usb.h>
 #include <linux/usb/usb_defs.h>
 
+#include <linux/sizes.h>
+
 #include <asm/unaligned.h>
 
 #include "usb.h"
@@ -63,6 +65,10 @@ static const char *usb_stor_opcode_name(u8 opcode)
 		return "SCSI_READ10";
 	case SCSI_WRITE10:
 		return "SCSI_WRITE10";
+	case SCSI_READ16:
+		return "SCSI_READ16";
+	case SCSI_WRITE16:
+		return "SCSI_WRITE16";
 	};
 
 	return "UNKNOWN";
@@ -235,7 +241,7 @@ static int read_capacity_10(struct us_blk_dev *usb_blkdev)
 }
 
 static int usb_stor_io_16(struct us_blk_dev *usb_blkdev, u8 opcode,
-			  sector_t start, u8 *data, u16 blocks)
+			  sector_t start, u8 *data, u32 blocks)
 {
 	u8 cmd[16];
 
@@ -266,7 +272,22 @@ static int usb_stor_io_10(struct us_blk_dev *usb_blkdev, u8 opcode,
  * Disk driver interface
  ***********************************************************************/
 
-#define US_MAX_IO_BLK 32
+/*
+ * Maximum number of sectors per SCSI command. Many USB mass storage bridges
+ * fail or hang on larger transfers, so use the same limits as Linux does.
+ * The data stage is split into transfers the host controller can handle in
+ * usb_stor_Bulk_transport().
+ */
+#define US_MAX_IO_BLK		240
+#define US_MAX_IO_BLK_SS	2048
+
+static u32 usb_stor_max_io_blk(struct us_data *us)
+{
+	if (us->pusb_dev->speed >= USB_SPEED_SUPER)
+		return US_MAX_IO_BLK_SS;
+
+	return US_MAX_IO_BLK;
+}
 
 /* Read / write a chunk of sectors on media */
 static int usb_stor_blk_io(struct block_device *disk_dev,
@@ -280,11 +301,17 @@ static int usb_stor_blk_io(struct block_device *disk_dev,
 	struct device *dev = &us->pusb_dev->dev;
 	int result;
 
-	/* ensure unit ready */
-	dev_dbg(dev, "Testing for unit ready\n");
-	if (usb_stor_test_unit_ready(pblk_dev, 0)) {
-		dev_dbg(dev, "Device NOT ready\n");
-		return -EIO;
+	/*
+	 * The unit was ready after init. Only check again once a command
+	 * failed, e.g. because the medium was changed.
+	 */
+	if (pblk_dev->check_ready) {
+		dev_dbg(dev, "Testing for unit ready\n");
+		if (usb_stor_test_unit_ready(pblk_dev, 0)) {
+			dev_dbg(dev, "Device NOT ready\n");
+			return -EIO;
+		}
+		pblk_dev->check_ready = false;
 	}
 
 	/* read / write the requested data */
@@ -293,7 +320,7 @@ static int usb_stor_blk_io(struct block_device *disk_dev,
 		sector_count, sector_start);
 
 	while (sector_count > 0) {
-		u16 n = min_t(blkcnt_t, sector_count, US_MAX_IO_BLK);
+		u32 n = min_t(blkcnt_t, sector_count, usb_stor_max_io_blk(us));
 
 		if (disk_dev->num_blocks > 0xffffffff) {
 			result = usb_stor_io_16(pblk_dev,
@@ -310,6 +337,7 @@ static int usb_stor_blk_io(struct block_device *disk_dev,
 
 		if (result) {
 			dev_dbg(dev, "I/O error at sector %llu\n", sector_start);
+			pblk_dev->check_ready = true;
 			break;
 		}
 
@@ -531,7 +559,7 @@ static int usb_stor_probe(struct usb_device *usbdev,
 	struct device *dev = &usbdev->dev;
 	struct us_data *us;
 	int result;
-	int ifno;
+	int ifno, mps;
 	struct usb_interface *intf;
 
 	dev_dbg(dev, "Supported USB Mass Storage device detected\n");
@@ -572,6 +600,17 @@ static int usb_stor_probe(struct usb_device *usbdev,
 	if (result)
 		goto BadDevice;
 
+	/*
+	 * Without knowing better stick to the transfer size this driver
+	 * always used. Keep it a multiple of the packet size, only the last
+	 * transfer of a data stage may be short.
+	 */
+	us->max_bulk_len = min_t(size_t, usbdev->host->max_bulk_len ?: SZ_16K,
+				 SZ_1G);
+	mps = usb_maxpacket(usbdev, usb_rcvbulkpipe(usbdev, us->recv_bulk_ep));
+	if (mps)
+		us->max_bulk_len = rounddown(us->max_bulk_len, mps);
+
 	/* register a disk device for each LUN */
 	usb_stor_scan(usbdev, us);
 
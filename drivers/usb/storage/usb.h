@@ -51,6 +51,8 @@ struct us_data {
 
 	unsigned char		max_lun;
 
+	u32			max_bulk_len;	/* per bulk transfer in the data stage */
+
 	char			*transport_name;
 
 	trans_cmnd		*transport;	/* transport function */
@@ -65,6 +67,7 @@ struct us_blk_dev {
 	struct us_data		*us;		/* LUN's enclosing dev */
 	struct block_device	blk;		/* the blockdevice for the dev */
 	unsigned char 		lun;		/* the LUN of this blk dev */
+	bool			check_ready;	/* TEST UNIT READY before next I/O */
 	struct list_head	list;		/* siblings */
 };
 
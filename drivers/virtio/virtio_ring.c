@@ -75,7 +75,12 @@ int virtqueue_add_sgs(struct virtqueue *vq, struct scatterlist *sgs[],
 
 	desc = vq->vring.desc;
 	i = head;
-	descs_used = total_sg;
+
+	/* Each of the sgs may be a chained list of several entries */
+	descs_used = 0;
+	for (n = 0; n < total_sg; n++)
+		for (sg = sgs[n]; sg; sg = sg_next(sg))
+			descs_used++;
 
 	if (vq->num_free < descs_used) {
 		vq_debug(vq, "Can't add buf len %i - avail = %i\n",
@@ -107,7 +112,6 @@ int virtqueue_add_sgs(struct virtqueue *vq, struct scatterlist *sgs[],
 
 	for (; n < (out_sgs + in_sgs); n++) {
 		for (sg = sgs[n]; sg; sg = sg_next(sg)) {
-			struct scatterlist *sg = sgs[n];
 			dma_addr_t addr = vring_map_one_sg(vq, sg, DMA_FROM_DEVICE);
 			if (vring_mapping_error(vq, addr))
 				goto unmap_release;
@@ -161,8 +165,9 @@ int virtqueue_add_sgs(struct virtqueue *vq, struct scatterlist *sgs[],
 
 unmap_release:
 	err_idx = i;
+	i = head;
 
-	for (n = 0; n < total_sg; n++) {
+	for (n = 0; n < descs_used; n++) {
 		if (i == err_idx)
 			break;
 		vring_unmap_one(vq, &desc[i]);
@@ -151,7 +151,76 @@ static int ext4fs_get_indir_block(struct ext2fs_node *node,
 	return 0;
 }
 
-long int read_allocated_block(struct ext2fs_node *node, int fileblock)
+/* uninitialized extents have ee_len > EXT4_INIT_MAX_LEN and read as zeroes */
+#define EXT4_INIT_MAX_LEN	(1 << 15)
+
+/*
+ * Look up the extent containing @fileblock and store it in the extent cache
+ * of @node. Holes are cached as extents with a physical start of 0.
+ */
+static int ext4fs_lookup_extent(struct ext2fs_node *node, uint32_t fileblock)
+{
+	struct ext4_extent_cache *ec = &node->extent_cache;
+	struct ext2_inode *inode = &node->inode;
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	uint32_t startblock, len;
+	uint64_t start;
+	int i;
+
+	if (!node->extent_buf) {
+		node->extent_buf = malloc(EXT2_BLOCK_SIZE(node->data));
+		if (!node->extent_buf)
+			return -ENOMEM;
+	}
+
+	ext_block = ext4fs_get_extent_block(node->data, node->extent_buf,
+			(struct ext4_extent_header *)inode->b.blocks.dir_blocks,
+			fileblock, LOG2_EXT2_BLOCK_SIZE(node->data));
+	if (!ext_block) {
+		pr_err("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		startblock = le32_to_cpu(extent[i].ee_block);
+		len = le16_to_cpu(extent[i].ee_len);
+
+		if (startblock > fileblock) {
+			/* Sparse file */
+			ec->lblk = fileblock;
+			ec->len = startblock - fileblock;
+			ec->pblk = 0;
+			return 0;
+		}
+
+		if (len > EXT4_INIT_MAX_LEN) {
+			len -= EXT4_INIT_MAX_LEN;
+			start = 0;
+		} else {
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) + le32_to_cpu(extent[i].ee_start_lo);
+		}
+
+		if (fileblock - startblock < len) {
+			ec->lblk = startblock;
+			ec->len = len;
+			ec->pblk = start;
+			return 0;
+		}
+	}
+
+	/* behind the last extent of this leaf, the next one may start anywhere */
+	ec->lblk = fileblock;
+	ec->len = 1;
+	ec->pblk = 0;
+
+	return 0;
+}
+
+static long int ext4fs_map_indirect(struct ext2fs_node *node, uint32_t fileblock)
 {
 	long int blknr;
 	int blksz;
@@ -159,7 +228,6 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	struct ext2_inode *inode = &node->inode;
 	struct ext2_data *data = node->data;
 	int ret;
@@ -168,50 +236,6 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	blksz = EXT2_BLOCK_SIZE(node->data);
 	log2_blksz = LOG2_EXT2_BLOCK_SIZE(node->data);
 
-	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		char *buf = zalloc(blksz);
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-
-		if (!buf)
-			return -ENOMEM;
-
-		ext_block = ext4fs_get_extent_block(node->data, buf,
-				(struct ext4_extent_header *)inode->b.blocks.dir_blocks,
-				fileblock, log2_blksz);
-		if (!ext_block) {
-			pr_err("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
-
-			if (startblock > fileblock) {
-				/* Sparse file */
-				free(buf);
-				return 0;
-			}
-
-			if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				free(buf);
-				return (fileblock - startblock) + start;
-			}
-		}
-
-		free(buf);
-		return 0;
-	}
-
 	if (fileblock < INDIRECT_BLOCKS) {
 		/* Direct blocks. */
 		blknr = le32_to_cpu(inode->b.blocks.dir_blocks[fileblock]);
@@ -267,6 +291,60 @@ long int read_allocated_block(struct ext2fs_node *node, int fileblock)
 	return blknr;
 }
 
+/**
+ * ext4fs_map_blocks - map file blocks to filesystem blocks
+ * @node: The file
+ * @fileblock: The first block in the file
+ * @blknr: Returns the filesystem block @fileblock is stored in, 0 for a hole
+ * @count: In: the number of blocks the caller is interested in. Out: the
+ *         number of blocks following @fileblock which are stored
+ *         contiguously on disk starting at @blknr, or are a hole.
+ *
+ * Return: 0 for success or a negative error code
+ */
+int ext4fs_map_blocks(struct ext2fs_node *node, uint32_t fileblock,
+		      sector_t *blknr, uint32_t *count)
+{
+	struct ext4_extent_cache *ec = &node->extent_cache;
+	uint32_t max = *count, n;
+	long int ret;
+
+	if (le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL) {
+		if (!ec->len || fileblock < ec->lblk ||
+		    fileblock - ec->lblk >= ec->len) {
+			ret = ext4fs_lookup_extent(node, fileblock);
+			if (ret)
+				return ret;
+		}
+
+		n = fileblock - ec->lblk;
+
+		*blknr = ec->pblk ? ec->pblk + n : 0;
+		*count = min(max, ec->len - n);
+
+		return 0;
+	}
+
+	ret = ext4fs_map_indirect(node, fileblock);
+	if (ret < 0)
+		return ret;
+
+	*blknr = ret;
+
+	for (n = 1; n < max; n++) {
+		ret = ext4fs_map_indirect(node, fileblock + n);
+		if (ret < 0)
+			return ret;
+
+		if (*blknr ? ret != *blknr + n : ret != 0)
+			break;
+	}
+
+	*count = n;
+
+	return 0;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -568,5 +646,6 @@ void ext4fs_umount(struct ext_filesystem *fs)
 	free(fs->data->indir1.data);
 	free(fs->data->indir2.data);
 	free(fs->data->indir3.data);
+	free(fs->data->diropen.extent_buf);
 	free(fs->data);
 }
@@ -38,26 +38,26 @@
 
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 {
-	if ((node != &node->data->diropen) && (node != currroot))
+	if ((node != &node->data->diropen) && (node != currroot)) {
+		free(node->extent_buf);
 		free(node);
+	}
 }
 
 /*
- * Taken from openmoko-kernel mailing list: By Andy green
- * Optimized read file API : collects and defers contiguous sector
- * reads into one potentially more efficient larger sequential read action
+ * Read physically contiguous blocks with a single device read, so that the
+ * block layer can transfer them in one go.
  */
 loff_t ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		unsigned int len, char *buf)
 {
-	loff_t i;
-	blkcnt_t blockcnt;
 	int log2blocksize = LOG2_EXT2_BLOCK_SIZE(node->data);
 	const int blockshift = log2blocksize + DISK_SECTOR_BITS;
 	const int blocksize = 1 << blockshift;
 	loff_t filesize = ext4_isize(node);
-	ssize_t ret;
 	struct ext_filesystem *fs = node->data->fs;
+	unsigned int remaining;
+	ssize_t ret;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len + pos > filesize)
@@ -66,44 +66,35 @@ loff_t ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 	if (filesize <= pos)
 		return -EINVAL;
 
-	blockcnt = ((len + pos) + blocksize - 1) >> blockshift;
+	remaining = len;
 
-	for (i = pos >> blockshift; i < blockcnt; i++) {
+	while (remaining) {
+		uint32_t fileblock = pos >> blockshift;
+		unsigned int blockoff = pos & (blocksize - 1);
+		uint32_t count;
 		sector_t blknr;
-		loff_t blockoff = pos - (blocksize * i);
-		loff_t blockend = blocksize;
-		loff_t skipfirst = 0;
-
-		ret = read_allocated_block(node, i);
-		if (ret < 0)
-			return ret;
+		size_t now;
 
-		blknr = ret << log2blocksize;
+		count = ((u64)blockoff + remaining + blocksize - 1) >> blockshift;
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		ret = ext4fs_map_blocks(node, fileblock, &blknr, &count);
+		if (ret)
+			return ret;
 
-		/* First block. */
-		if (i == pos >> blockshift) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
-		}
+		now = min_t(u64, remaining, (u64)count * blocksize - blockoff);
 
 		if (blknr) {
-			ret = ext4fs_devread(fs, blknr, skipfirst, blockend, buf);
+			ret = ext4fs_devread(fs, blknr << log2blocksize,
+					     blockoff, now, buf);
 			if (ret)
 				return ret;
 		} else {
-			memset(buf, 0, blockend);
+			memset(buf, 0, now);
 		}
 
-		buf += blocksize - skipfirst;
+		buf += now;
+		pos += now;
+		remaining -= now;
 	}
 
 	return len;
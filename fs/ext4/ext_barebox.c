@@ -71,8 +71,17 @@ static struct inode *ext_alloc_inode(struct super_block *sb)
 	return &node->i;
 }
 
+static void ext_destroy_inode(struct inode *inode)
+{
+	struct ext2fs_node *node = to_ext2_node(inode);
+
+	free(node->extent_buf);
+	free(node);
+}
+
 static const struct super_operations ext_ops = {
 	.alloc_inode = ext_alloc_inode,
+	.destroy_inode = ext_destroy_inode,
 };
 
 struct inode *ext_get_inode(struct super_block *sb, int ino);
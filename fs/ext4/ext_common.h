@@ -209,12 +209,21 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+/* The extent (or hole) of a file looked up last */
+struct ext4_extent_cache {
+	uint32_t lblk;
+	uint32_t len;
+	sector_t pblk;
+};
+
 struct ext2fs_node {
 	struct inode i;
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	struct ext4_extent_cache extent_cache;
+	char *extent_buf;
 };
 
 struct ext4fs_indir_block {
@@ -13,7 +13,7 @@
 #include "ff.h"
 #include "diskio.h"
 
-DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, BYTE count)
+DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, UINT count)
 {
 	int ret = pbl_bio_read(fat->userdata, sector, buf, count);
 	return ret != count ? ret : 0;
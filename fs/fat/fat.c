@@ -36,12 +36,12 @@ struct fat_priv {
 
 /* ---------------------------------------------------------------*/
 
-DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, BYTE count)
+DRESULT disk_read(FATFS *fat, BYTE *buf, DWORD sector, UINT count)
 {
 	struct fat_priv *priv = fat->userdata;
 	int ret;
 
-	debug("%s: sector: %ld count: %d\n", __func__, sector, count);
+	debug("%s: sector: %ld count: %u\n", __func__, sector, count);
 
 	ret = cdev_read(priv->cdev, buf, count << 9, (loff_t)sector * 512, 0);
 	if (ret != count << 9)
@@ -258,6 +258,9 @@ int move_window (
 			fs->wflag = 0;
 			if (wsect < (fs->fatbase + fs->fsize)) {	/* In FAT area */
 				BYTE nf;
+#if _FAT_CACHE_SECTORS
+				fs->fatcache_n = 0;	/* Drop the now outdated copy */
+#endif
 				for (nf = fs->n_fats; nf > 1; nf--) {	/* Reflect the change to all FAT copies */
 					wsect += fs->fsize;
 					disk_write(fs, fs->win, wsect, 1);
@@ -325,6 +328,48 @@ static DWORD clust2sect (	/* !=0: Sector number, 0: Failed - invalid cluster# */
 	return clst * fs->csize + fs->database;
 }
 
+#if _FAT_CACHE_SECTORS
+/*
+ * Get a FAT sector for reading. Several sectors are read at once, so that
+ * following a cluster chain doesn't need a disk access for each entry.
+ */
+static BYTE *fat_sector (	/* NULL: Disk error, Else: Pointer to the sector data */
+	FATFS *fs,	/* File system object */
+	DWORD sect	/* Sector number in the FAT */
+)
+{
+	UINT n;
+
+	/* The window may hold a modified copy of the sector */
+	if (fs->winsect == sect)
+		return fs->win;
+
+	if (sect - fs->fatcache_sect >= fs->fatcache_n) {
+		n = fs->fatbase + fs->fsize - sect;
+		if (n > _FAT_CACHE_SECTORS)
+			n = _FAT_CACHE_SECTORS;
+		fs->fatcache_n = 0;
+		if (disk_read(fs, fs->fatcache, sect, n) != RES_OK)
+			return NULL;
+		fs->fatcache_sect = sect;
+		fs->fatcache_n = n;
+	}
+
+	return fs->fatcache + (sect - fs->fatcache_sect) * SS(fs);
+}
+#else
+static BYTE *fat_sector (
+	FATFS *fs,
+	DWORD sect
+)
+{
+	if (move_window(fs, sect))
+		return NULL;
+
+	return fs->win;
+}
+#endif
+
 /*
  * FAT access - Read value of a FAT entry
  */
@@ -343,24 +388,28 @@ static DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, Else:Cluster
 	switch (fs->fs_type) {
 	case FS_FAT12 :
 		bc = (UINT)clst; bc += bc / 2;
-		if (move_window(fs, fs->fatbase + (bc / SS(fs))))
+		p = fat_sector(fs, fs->fatbase + (bc / SS(fs)));
+		if (!p)
 			break;
-		wc = fs->win[bc % SS(fs)]; bc++;
-		if (move_window(fs, fs->fatbase + (bc / SS(fs))))
+		wc = p[bc % SS(fs)]; bc++;
+		p = fat_sector(fs, fs->fatbase + (bc / SS(fs)));
+		if (!p)
 			break;
-		wc |= fs->win[bc % SS(fs)] << 8;
+		wc |= p[bc % SS(fs)] << 8;
 		return (clst & 1) ? (wc >> 4) : (wc & 0xFFF);
 
 	case FS_FAT16 :
-		if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 2))))
+		p = fat_sector(fs, fs->fatbase + (clst / (SS(fs) / 2)));
+		if (!p)
 			break;
-		p = &fs->win[clst * 2 % SS(fs)];
+		p += clst * 2 % SS(fs);
 		return LD_WORD(p);
 
 	case FS_FAT32 :
-		if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4))))
+		p = fat_sector(fs, fs->fatbase + (clst / (SS(fs) / 4)));
+		if (!p)
 			break;
-		p = &fs->win[clst * 4 % SS(fs)];
+		p += clst * 4 % SS(fs);
 		return LD_DWORD(p) & 0x0FFFFFFF;
 	}
 
@@ -1689,6 +1738,9 @@ static int chk_mounted (	/* 0(0): successful, !=0: any error occurred */
 #endif
 	fs->fs_type = fmt; /* FAT sub-type */
 	fs->winsect = 0; /* Invalidate sector cache */
+#if _FAT_CACHE_SECTORS
+	fs->fatcache_n = 0;
+#endif
 	fs->wflag = 0;
 
 	return 0;
@@ -1706,6 +1758,150 @@ int f_mount (
 	return chk_mounted(fs, 0);
 }
 
+#if _USE_FASTSEEK
+/*
+ * Create the cluster link map of a file opened read-only. It consists of
+ * pairs of the number of clusters in a fragment and its first cluster,
+ * terminated by a 0. The chain is walked no further than the file size
+ * allows, so a cyclic or cross-linked chain is reported instead of
+ * looping forever.
+ */
+static int create_clmt (	/* 0: Map created or not used, -ERESTARTSYS: Broken chain, -EIO: Disk error */
+	FIL *fp		/* Pointer to the file object */
+)
+{
+	FATFS *fs = fp->fs;
+	DWORD cl, pcl, ncl, left, bcs, *tbl = NULL, *ntbl;
+	UINT n = 0, max = 0;
+	int res;
+
+	if ((fp->flag & FA_WRITE) || !fp->sclust) {
+		fp->cltbl_tried = 1;
+		return 0;
+	}
+
+	bcs = (DWORD)fs->csize * SS(fs);
+	left = fp->fsize / bcs + (fp->fsize % bcs ? 1 : 0);	/* Clusters used by the file */
+
+	cl = fp->sclust;
+	do {
+		ncl = 0;
+		do {
+			if (cl < 2 || cl >= fs->n_fatent || !left) {
+				res = -ERESTARTSYS;
+				goto err;
+			}
+			pcl = cl;
+			ncl++;
+			left--;
+			cl = get_fat(fs, cl);
+			if (cl == 0xFFFFFFFF) {
+				res = -EIO;
+				goto err;
+			}
+		} while (cl == pcl + 1);
+
+		if (n + 3 > max) {
+			max = max ? max * 2 : 16;
+			ntbl = realloc(tbl, max * sizeof(*tbl));
+			if (!ntbl) {	/* Fall back to following the FAT */
+				free(tbl);
+				fp->cltbl_tried = 1;
+				return 0;
+			}
+			tbl = ntbl;
+		}
+
+		tbl[n++] = ncl;
+		tbl[n++] = pcl - ncl + 1;
+	} while (cl < fs->n_fatent);
+
+	tbl[n] = 0;
+	fp->cltbl = tbl;
+	fp->cltbl_tried = 1;
+
+	return 0;
+err:
+	free(tbl);
+	ABORT(fs, res);
+}
+
+/*
+ * Get the cluster containing the file offset from the cluster link map
+ */
+static DWORD clmt_clust (	/* <2: Cluster is not in the map, Else: Cluster# */
+	FIL *fp,	/* Pointer to the file object */
+	DWORD ofs	/* File offset */
+)
+{
+	DWORD cl, ncl, *tbl = fp->cltbl;
+
+	cl = ofs / SS(fp->fs) / fp->fs->csize;	/* Cluster order from top of the file */
+	for (;;) {
+		ncl = *tbl++;
+		if (!ncl)
+			return 0;
+		if (cl < ncl)
+			break;
+		cl -= ncl;
+		tbl++;
+	}
+
+	return cl + *tbl;
+}
+#endif
+
+/*
+ * Get the cluster following @clst in the file, which starts at file offset
+ * @ofs. Uses the cluster link map if there is one.
+ */
+static DWORD next_clust (	/* See get_fat() */
+	FIL *fp,	/* Pointer to the file object */
+	DWORD clst,	/* Current cluster */
+	DWORD ofs	/* File offset of the next cluster */
+)
+{
+#if _USE_FASTSEEK
+	int res;
+
+	if (!fp->cltbl_tried) {
+		res = create_clmt(fp);
+		if (res)
+			return res == -EIO ? 0xFFFFFFFF : 1;
+	}
+	if (fp->cltbl)
+		return clmt_clust(fp, ofs);
+#endif
+	return get_fat(fp->fs, clst);
+}
+
+/*
+ * Get the number of sectors from sector @csect in the current cluster on
+ * which are stored contiguously, up to @cc. Advances fp->clust to the
+ * cluster containing the last of these sectors.
+ */
+static UINT contiguous_sectors (
+	FIL *fp,	/* Pointer to the file object */
+	BYTE csect,	/* Sector offset in the current cluster */
+	UINT cc		/* Number of sectors wanted */
+)
+{
+	FATFS *fs = fp->fs;
+	UINT n = fs->csize - csect;
+	DWORD clst = fp->clust, next;
+
+	while (n < cc) {
+		next = next_clust(fp, clst, fp->fptr + n * SS(fs));
+		if (next != clst + 1)
+			return n;
+		clst = next;
+		fp->clust = clst;
+		n += fs->csize;
+	}
+
+	return cc;
+}
+
 /*
  * Open or Create a File
  */
@@ -1813,6 +2009,10 @@ int f_open (
 		fp->fptr = 0;			/* File pointer */
 		fp->dsect = 0;
 		fp->fs = dj.fs;
+#if _USE_FASTSEEK
+		fp->cltbl = NULL;
+		fp->cltbl_tried = 0;
+#endif
 	}
 
 	return res;
@@ -1853,7 +2053,7 @@ int f_read (
 				if (fp->fptr == 0) {		/* On the top of the file? */
 					clst = fp->sclust;	/* Follow from the origin */
 				} else {			/* Middle or end of the file */
-						clst = get_fat(fp->fs, fp->clust);	/* Follow cluster chain on the FAT */
+					clst = next_clust(fp, fp->clust, fp->fptr);	/* Follow cluster chain */
 				}
 				if (clst < 2)
 					ABORT(fp->fs, -ERESTARTSYS);
@@ -1867,9 +2067,9 @@ int f_read (
 			sect += csect;
 			cc = btr / SS(fp->fs);		/* When remaining bytes >= sector size, */
 			if (cc) {			/* Read maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
-					cc = fp->fs->csize - csect;
-				if (disk_read(fp->fs, rbuff, sect, (BYTE)cc) != RES_OK)
+				if (csect + cc > fp->fs->csize)	/* Continue in following clusters if contiguous */
+					cc = contiguous_sectors(fp, csect, cc);
+				if (disk_read(fp->fs, rbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, -EIO);
 #if defined FS_FAT_WRITE
 				/* Replace one of the read sectors with cached data if it contains a dirty sector */
@@ -2054,6 +2254,10 @@ int f_close (
 	FIL *fp		/* Pointer to the file object to be closed */
 )
 {
+#if _USE_FASTSEEK
+	free(fp->cltbl);
+	fp->cltbl = NULL;
+#endif
 #ifndef FS_FAT_WRITE
 	fp->fs = 0;	/* Discard file object */
 	return 0;
@@ -2112,6 +2316,25 @@ int f_lseek (
 			fp->clust = clst;
 		}
 		if (clst != 0) {
+#if _USE_FASTSEEK
+			if (ofs > bcs && !(fp->flag & FA_WRITE)) {
+				if (!fp->cltbl_tried) {
+					res = create_clmt(fp);
+					if (res)
+						ABORT(fp->fs, res);
+				}
+				if (fp->cltbl) {	/* Jump to the target cluster */
+					nsect = (ofs - 1) / bcs * bcs;
+					clst = clmt_clust(fp, fp->fptr + nsect);
+					if (clst <= 1)
+						ABORT(fp->fs, -ERESTARTSYS);
+					fp->clust = clst;
+					fp->fptr += nsect;
+					ofs -= nsect;
+					nsect = 0;
+				}
+			}
+#endif
 			while (ofs > bcs) {	/* Cluster following loop */
 #ifdef FS_FAT_WRITE
 				if (fp->flag & FA_WRITE) {	/* Check if in write mode or not */
@@ -87,6 +87,11 @@ typedef struct {
 	DWORD	database;	/* Data start sector */
 	DWORD	winsect;	/* Current sector appearing in the win[] */
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and Data on tiny cfg) */
+#if _FAT_CACHE_SECTORS
+	DWORD	fatcache_sect;	/* First sector in fatcache[] */
+	UINT	fatcache_n;	/* Number of valid sectors in fatcache[] */
+	BYTE	fatcache[_FAT_CACHE_SECTORS * _MAX_SS];	/* FAT sectors for get_fat() */
+#endif
 	void	*userdata;	/* User data, ff core does not touch this */
 	struct list_head dirtylist;
 } FATFS;
@@ -110,6 +115,7 @@ typedef struct {
 #endif
 #if _USE_FASTSEEK
 	DWORD*	cltbl;		/* Pointer to the cluster link map table (null on file open) */
+	BYTE	cltbl_tried;	/* Creating the cluster link map has been attempted */
 #endif
 #if _FS_SHARE
 	UINT	lockid;		/* File lock ID (index of file semaphore table) */
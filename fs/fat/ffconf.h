@@ -33,8 +33,19 @@
 /* To enable f_forward function, set _USE_FORWARD to 1 and set _FS_TINY to 1. */
 
 
+#ifdef __PBL__
 #define	_USE_FASTSEEK	0	/* 0:Disable or 1:Enable */
-/* To enable fast seek feature, set _USE_FASTSEEK to 1. */
+#define	_FAT_CACHE_SECTORS	0
+#else
+#define	_USE_FASTSEEK	1
+#define	_FAT_CACHE_SECTORS	16
+#endif
+/* To enable fast seek feature, set _USE_FASTSEEK to 1. Files opened read-only
+/  then get a cluster link map built on first use, so that seeking doesn't need
+/  to follow the cluster chain on the FAT.
+/  _FAT_CACHE_SECTORS is the number of FAT sectors read at once and cached for
+/  following cluster chains. 0 uses the sector window in the file system object.
+*/
 
 
 
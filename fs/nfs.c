@@ -29,7 +29,6 @@
 #include <init.h>
 #include <linux/stat.h>
 #include <linux/err.h>
-#include <kfifo.h>
 #include <linux/sizes.h>
 #include <byteorder.h>
 #include <globalvar.h>
@@ -56,6 +55,7 @@
 #define NFSPROC3_READLINK	5
 #define NFSPROC3_READ		6
 #define NFSPROC3_READDIR	16
+#define NFSPROC3_READDIRPLUS	17
 
 #define NFS3_FHSIZE      64
 #define NFS3_COOKIEVERFSIZE	8
@@ -123,6 +123,35 @@ struct rpc_reply {
 #define NFS_TIMEOUT	(100 * MSECOND)
 #define NFS_MAX_RESEND	100
 
+/*
+ * A READ reply carries the RPC reply header, the NFS status, the file
+ * attributes, count, eof and the length of the data. The data itself
+ * has to fit into the remaining UDP payload of a single datagram. With
+ * IP fragment reassembly that may be larger than a frame, in which case
+ * use the 32KiB Linux uses as maximum for NFS over UDP.
+ */
+#define NFS_READ_REPLY_OVERHEAD	(sizeof(struct rpc_reply) + 4 + 4 + 84 + 12)
+#ifdef CONFIG_NET_IP_FRAG
+#define NFS_UDP_PAYLOAD_MAX	(0xffff - sizeof(struct iphdr) - sizeof(struct udphdr))
+#define NFS_RSIZE_MAX		SZ_32K
+#else
+#define NFS_UDP_PAYLOAD_MAX	(1500 - sizeof(struct iphdr) - sizeof(struct udphdr))
+#define NFS_RSIZE_MAX		ALIGN_DOWN(NFS_UDP_PAYLOAD_MAX - NFS_READ_REPLY_OVERHEAD, 4)
+#endif
+
+/*
+ * Number of READ requests in flight, limited so that no more than
+ * NFS_READ_BYTES_MAX are outstanding at once. A lost frame costs the
+ * whole reply, and the poll driven rx rings of the network drivers
+ * only hold a few dozen frames.
+ */
+#define NFS_READ_WINDOW		8
+#define NFS_READ_BYTES_MAX	SZ_64K
+
+/* size and lifetime of the cache of looked up file handles and attributes */
+#define NFS_LOOKUP_CACHE_MAX	256
+#define NFS_LOOKUP_CACHE_TIMEOUT	(3 * SECOND)
+
 struct nfs_fh {
 	unsigned short size;
 	unsigned char data[NFS3_FHSIZE];
@@ -131,7 +160,44 @@ struct nfs_fh {
 struct packet {
 	struct list_head list;
 	int len;
-	char data[];
+	char *data;
+	void *rxbuf;	/* network buffer @data points into, if taken over */
+	char buf[];
+};
+
+enum nfs_read_state {
+	NFS_READ_FREE,
+	NFS_READ_PENDING,
+	NFS_READ_DONE,
+};
+
+/*
+ * An outstanding READ request. Replies are matched by the RPC xid in
+ * nfs_handler() and the data is copied straight to @dst.
+ */
+struct nfs_read_slot {
+	enum nfs_read_state state;
+	uint32_t xid;
+	uint64_t offset;
+	uint32_t count;
+	void *dst;
+	uint64_t sent;
+	int tries;
+	int ret;	/* number of bytes received or negative error code */
+	bool eof;
+};
+
+/*
+ * A cached result of a LOOKUP or an entry of a READDIRPLUS reply, keyed
+ * by the parent directory's handle and the entry name.
+ */
+struct nfs_lookup_entry {
+	struct list_head list;
+	struct nfs_fh dir;
+	char *name;
+	struct nfs_fh fh;
+	uint32_t fattr[21];	/* struct fattr3 as received */
+	uint64_t time;
 };
 
 struct nfs_priv {
@@ -143,13 +209,19 @@ struct nfs_priv {
 	uint16_t nfs_port;
 	unsigned manual_nfs_port:1;
 	uint32_t rpc_id;
+	uint32_t rsize;
+	unsigned int read_window;	/* READ requests in flight, <= NFS_READ_WINDOW */
 	struct nfs_fh rootfh;
 	struct list_head packets;
+	/* non NULL while nfs_read() has requests in flight */
+	struct nfs_read_slot *read_slots;
+	struct list_head lookup_cache;
+	unsigned int lookup_cache_len;
+	unsigned no_readdirplus:1;
+	uint32_t rpc_calls;
 };
 
 struct file_priv {
-	struct kfifo *fifo;
-	void *buf;
 	struct nfs_priv *npriv;
 	struct nfs_fh fh;
 };
@@ -262,6 +334,7 @@ struct nfs_dir {
 	uint64_t cookie;
 	char cookieverf[NFS3_COOKIEVERFSIZE];
 	struct nfs_fh fh;
+	bool plus;
 };
 
 struct nfserror {
@@ -455,26 +528,25 @@ static int rpc_check_reply(struct packet *pkt, int rpc_prog,
 static void nfs_free_packet(struct packet *packet)
 {
 	list_del(&packet->list);
+	net_free_packet(packet->rxbuf);
 	free(packet);
 }
 
 /*
- * rpc_req - synchronous RPC request
+ * rpc_send - send a RPC call without waiting for the reply
+ *
+ * Every call put on the wire is counted in rpc_calls, retransmissions
+ * included.
  */
-static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
-			      int rpc_proc, uint32_t *data, int datalen)
+static int rpc_send(struct nfs_priv *npriv, int rpc_prog, int rpc_proc,
+		    uint32_t rpc_id, uint32_t *data, int datalen)
 {
 	struct rpc_call pkt;
 	unsigned short dport;
-	int ret;
 	unsigned char *payload = net_udp_get_payload(npriv->con);
-	int nfserr;
-	int tries = 0;
-	struct packet *packet;
-
-	npriv->rpc_id++;
+	int ret;
 
-	pkt.id = hton32(npriv->rpc_id);
+	pkt.id = hton32(rpc_id);
 	pkt.type = hton32(MSG_CALL);
 	pkt.rpcvers = hton32(2);	/* use RPC version 2 */
 	pkt.prog = hton32(rpc_prog);
@@ -498,11 +570,31 @@ static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
 
 	npriv->con->udp->uh_dport = hton16(dport);
 
+	ret = net_udp_send(npriv->con,
+			   sizeof(pkt) + datalen * sizeof(uint32_t));
+	if (!ret)
+		npriv->rpc_calls++;
+
+	return ret;
+}
+
+/*
+ * rpc_req - synchronous RPC request
+ */
+static struct packet *rpc_req(struct nfs_priv *npriv, int rpc_prog,
+			      int rpc_proc, uint32_t *data, int datalen)
+{
+	int ret;
+	int nfserr;
+	int tries = 0;
+	struct packet *packet;
+
+	npriv->rpc_id++;
+
 	nfs_timer_start = get_time_ns();
 
 again:
-	ret = net_udp_send(npriv->con,
-			sizeof(pkt) + datalen * sizeof(uint32_t));
+	ret = rpc_send(npriv, rpc_prog, rpc_proc, npriv->rpc_id, data, datalen);
 	if (ret) {
 		if (is_timeout(nfs_timer_start, NFS_TIMEOUT)) {
 			tries++;
@@ -711,6 +803,78 @@ static uint32_t *nfs_read_post_op_attr(uint32_t *p, struct inode *inode)
 	return p;
 }
 
+static bool nfs_fh_equal(const struct nfs_fh *a, const struct nfs_fh *b)
+{
+	return a->size == b->size && !memcmp(a->data, b->data, a->size);
+}
+
+static void nfs_lookup_cache_del(struct nfs_priv *npriv,
+				 struct nfs_lookup_entry *e)
+{
+	list_del(&e->list);
+	free(e->name);
+	free(e);
+	npriv->lookup_cache_len--;
+}
+
+static void nfs_lookup_cache_clear(struct nfs_priv *npriv)
+{
+	struct nfs_lookup_entry *e, *tmp;
+
+	list_for_each_entry_safe(e, tmp, &npriv->lookup_cache, list)
+		nfs_lookup_cache_del(npriv, e);
+}
+
+static struct nfs_lookup_entry *nfs_lookup_cache_find(struct nfs_priv *npriv,
+		const struct nfs_fh *dir, const char *name)
+{
+	struct nfs_lookup_entry *e, *tmp;
+
+	list_for_each_entry_safe(e, tmp, &npriv->lookup_cache, list) {
+		if (!nfs_fh_equal(&e->dir, dir) || strcmp(e->name, name))
+			continue;
+
+		if (is_timeout(e->time, NFS_LOOKUP_CACHE_TIMEOUT)) {
+			nfs_lookup_cache_del(npriv, e);
+			return NULL;
+		}
+
+		list_move(&e->list, &npriv->lookup_cache);
+		return e;
+	}
+
+	return NULL;
+}
+
+/*
+ * nfs_lookup_cache_add - remember the handle and attributes of a directory entry
+ *
+ * @fattr points to a struct fattr3 in network byte order.
+ */
+static void nfs_lookup_cache_add(struct nfs_priv *npriv,
+		const struct nfs_fh *dir, const char *name,
+		const struct nfs_fh *fh, const uint32_t *fattr)
+{
+	struct nfs_lookup_entry *e;
+
+	e = nfs_lookup_cache_find(npriv, dir, name);
+	if (!e) {
+		if (npriv->lookup_cache_len == NFS_LOOKUP_CACHE_MAX)
+			nfs_lookup_cache_del(npriv, list_last_entry(&npriv->lookup_cache,
+						struct nfs_lookup_entry, list));
+
+		e = xzalloc(sizeof(*e));
+		e->dir = *dir;
+		e->name = xstrdup(name);
+		list_add(&e->list, &npriv->lookup_cache);
+		npriv->lookup_cache_len++;
+	}
+
+	e->fh = *fh;
+	memcpy(e->fattr, fattr, sizeof(e->fattr));
+	e->time = get_time_ns();
+}
+
 /*
  * nfs_mount_req - Mount an NFS Filesystem
  */
@@ -865,6 +1029,9 @@ static int nfs_lookup_req(struct nfs_priv *npriv, struct nfs_fh *fh,
 	memcpy(ninode->fh.data, p, ninode->fh.size);
 	p += DIV_ROUND_UP(ninode->fh.size, 4);
 
+	if (ntoh32(net_read_uint32(p)))
+		nfs_lookup_cache_add(npriv, fh, filename, &ninode->fh, p + 1);
+
 	nfs_read_post_op_attr(p, inode);
 
 	nfs_free_packet(nfs_packet);
@@ -874,7 +1041,7 @@ static int nfs_lookup_req(struct nfs_priv *npriv, struct nfs_fh *fh,
 
 /*
  * returns with dir->stream pointing to the first entry
- * of dirlist3 res.resok.reply
+ * of dirlist3 res.resok.reply (or dirlistplus3 for READDIRPLUS)
  */
 static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 {
@@ -920,8 +1087,21 @@ static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 	 * default:
 	 * 	READDIR3resfail resfail;
 	 * };
+	 *
+	 * READDIRPLUS additionally passes the maximum size of the directory
+	 * information (dircount) before count and returns entryplus3 entries:
+	 *
+	 * struct entryplus3 {
+	 * 	fileid3 fileid;
+	 * 	filename3 name;
+	 * 	cookie3 cookie;
+	 * 	post_op_attr name_attributes;
+	 * 	post_op_fh3 name_handle;
+	 * 	entryplus3 *nextentry;
+	 * };
 	 */
 
+again:
 	p = &(data[0]);
 	p = rpc_add_credentials(p);
 
@@ -931,9 +1111,27 @@ static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 	memcpy(p, dir->cookieverf, NFS3_COOKIEVERFSIZE);
 	p += NFS3_COOKIEVERFSIZE / 4;
 
-	p = nfs_add_uint32(p, 1024); /* count */
+	if (dir->plus) {
+		p = nfs_add_uint32(p, 512); /* dircount */
+		/* maxcount, the reply must fit into a single datagram */
+		p = nfs_add_uint32(p, NFS_UDP_PAYLOAD_MAX - sizeof(struct rpc_reply) - 4);
+	} else {
+		p = nfs_add_uint32(p, 1024); /* count */
+	}
 
-	nfs_packet = rpc_req(npriv, PROG_NFS, NFSPROC3_READDIR, data, p - data);
+	nfs_packet = rpc_req(npriv, PROG_NFS,
+			     dir->plus ? NFSPROC3_READDIRPLUS : NFSPROC3_READDIR,
+			     data, p - data);
+	if (dir->plus && (PTR_ERR(nfs_packet) == -NFS3ERR_NOTSUPP ||
+			  PTR_ERR(nfs_packet) == -EINVAL)) {
+		/*
+		 * The server doesn't support READDIRPLUS (or rejected the
+		 * procedure on RPC level), don't try again.
+		 */
+		npriv->no_readdirplus = 1;
+		dir->plus = false;
+		goto again;
+	}
 	if (IS_ERR(nfs_packet))
 		return NULL;
 
@@ -941,6 +1139,7 @@ static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 	status = ntoh32(net_read_uint32(p++));
 	if (status != NFS3_OK) {
 		pr_err("Readdir failed: %s\n", nfserrstr(status, NULL));
+		nfs_free_packet(nfs_packet);
 		return NULL;
 	}
 
@@ -971,16 +1170,12 @@ static void *nfs_readdirattr_req(struct nfs_priv *npriv, struct nfs_dir *dir)
 }
 
 /*
- * nfs_read_req - Read File on NFS Server
+ * nfs_read_send - send the READ call for a slot
  */
-static int nfs_read_req(struct file_priv *priv, uint64_t offset,
-		uint32_t readlen)
+static int nfs_read_send(struct file_priv *priv, struct nfs_read_slot *slot)
 {
-	uint32_t data[1024];
-	uint32_t *p, status;
-	int len, ret;
-	struct packet *nfs_packet;
-	uint32_t rlen, eof;
+	uint32_t data[32];
+	uint32_t *p;
 
 	/*
 	 * struct READ3args {
@@ -988,7 +1183,31 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	offset3 offset;
 	 * 	count3 count;
 	 * };
-	 *
+	 */
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	p = nfs_add_fh3(p, &priv->fh);
+	p = nfs_add_uint64(p, slot->offset);
+	p = nfs_add_uint32(p, slot->count);
+
+	slot->sent = get_time_ns();
+
+	return rpc_send(priv->npriv, PROG_NFS, NFSPROC3_READ, slot->xid,
+			data, p - &(data[0]));
+}
+
+/*
+ * nfs_read_reply - handle the reply to an outstanding READ call
+ */
+static void nfs_read_reply(struct nfs_read_slot *slot, void *pkt, unsigned len)
+{
+	struct xdr_stream xdr;
+	struct rpc_reply rpc;
+	uint32_t status, rlen;
+	__be32 *p;
+
+	/*
 	 * struct READ3resok {
 	 * 	post_op_attr file_attributes;
 	 * 	count3 count;
@@ -1007,51 +1226,74 @@ static int nfs_read_req(struct file_priv *priv, uint64_t offset,
 	 * 	READ3resfail resfail;
 	 * };
 	 */
-	p = &(data[0]);
-	p = rpc_add_credentials(p);
-
-	p = nfs_add_fh3(p, &priv->fh);
-	p = nfs_add_uint64(p, offset);
-	p = nfs_add_uint32(p, readlen);
+	slot->state = NFS_READ_DONE;
 
-	len = p - &(data[0]);
+	memcpy(&rpc, pkt, sizeof(rpc));
+	if (rpc.rstatus || rpc.verifier || rpc.astatus) {
+		slot->ret = -EINVAL;
+		return;
+	}
 
-	nfs_packet = rpc_req(priv->npriv, PROG_NFS, NFSPROC3_READ, data, len);
-	if (IS_ERR(nfs_packet))
-		return PTR_ERR(nfs_packet);
+	xdr_init(&xdr, pkt + sizeof(rpc), len - sizeof(rpc));
 
-	p = (void *)nfs_packet->data + sizeof(struct rpc_reply);
-	status = ntoh32(net_read_uint32(p++));
+	p = xdr_inline_decode(&xdr, 4);
+	if (!p)
+		goto out_overflow;
+	status = ntoh32(net_read_uint32(p));
 	if (status != NFS3_OK) {
-		pr_err("Read failed: %s\n", nfserrstr(status, &ret));
-		return ret;
+		pr_err("Read failed: %s\n", nfserrstr(status, &slot->ret));
+		return;
 	}
 
-	p = nfs_read_post_op_attr(p, NULL);
+	/* post_op_attr */
+	p = xdr_inline_decode(&xdr, 4);
+	if (!p)
+		goto out_overflow;
+	if (ntoh32(net_read_uint32(p)) && !xdr_inline_decode(&xdr, 84))
+		goto out_overflow;
 
+	/* count, eof and the length of the opaque data which equals count */
+	p = xdr_inline_decode(&xdr, 12);
+	if (!p)
+		goto out_overflow;
 	rlen = ntoh32(net_read_uint32(p));
+	slot->eof = ntoh32(net_read_uint32(p + 1));
 
-	/* skip over count */
-	p += 1;
-
-	eof = ntoh32(net_read_uint32(p));
+	if (rlen > slot->count)
+		goto out_overflow;
 
-	/*
-	 * skip over eof and count embedded in the representation of data
-	 * assuming it equals rlen above.
-	 */
-	p += 2;
+	p = xdr_inline_decode(&xdr, rlen);
+	if (!p)
+		goto out_overflow;
 
-	if (readlen && !rlen && !eof) {
-		nfs_free_packet(nfs_packet);
-		return -EIO;
+	if (slot->count && !rlen && !slot->eof) {
+		slot->ret = -EIO;
+		return;
 	}
 
-	kfifo_put(priv->fifo, (char *)p, rlen);
+	memcpy(slot->dst, p, rlen);
+	slot->ret = rlen;
 
-	nfs_free_packet(nfs_packet);
+	return;
 
-	return 0;
+out_overflow:
+	pr_err("%s: premature end of packet\n", __func__);
+	slot->ret = -EIO;
+}
+
+static struct nfs_read_slot *nfs_read_find_slot(struct nfs_priv *npriv,
+						uint32_t xid)
+{
+	int i;
+
+	for (i = 0; i < NFS_READ_WINDOW; i++) {
+		struct nfs_read_slot *slot = &npriv->read_slots[i];
+
+		if (slot->state == NFS_READ_PENDING && slot->xid == xid)
+			return slot;
+	}
+
+	return NULL;
 }
 
 static void nfs_handler(void *ctx, char *p, unsigned len)
@@ -1059,9 +1301,38 @@ static void nfs_handler(void *ctx, char *p, unsigned len)
 	char *pkt = net_eth_to_udp_payload(p);
 	struct nfs_priv *npriv = ctx;
 	struct packet *packet;
+	void *rxbuf;
+
+	if (npriv->read_slots) {
+		unsigned udplen = net_eth_to_udplen(p);
+		struct nfs_read_slot *slot;
+
+		/*
+		 * Only READ calls are outstanding, so anything which does not
+		 * match one of them is a late duplicate and can be dropped.
+		 */
+		if (udplen < sizeof(struct rpc_reply))
+			return;
+
+		slot = nfs_read_find_slot(npriv, ntoh32(net_read_uint32(pkt)));
+		if (slot)
+			nfs_read_reply(slot, pkt, udplen);
+
+		return;
+	}
 
-	packet = xmalloc(sizeof(*packet) + len);
-	memcpy(packet->data, pkt, len);
+	len = net_eth_to_udplen(p);
+
+	rxbuf = net_rx_buf_take(pkt);
+	if (rxbuf) {
+		packet = xmalloc(sizeof(*packet));
+		packet->data = pkt;
+	} else {
+		packet = xmalloc(sizeof(*packet) + len);
+		memcpy(packet->buf, pkt, len);
+		packet->data = packet->buf;
+	}
+	packet->rxbuf = rxbuf;
 	packet->len = len;
 
 	list_add_tail(&packet->list, &npriv->packets);
@@ -1074,9 +1345,6 @@ static int nfs_truncate(struct device *dev, struct file *f, loff_t size)
 
 static void nfs_do_close(struct file_priv *priv)
 {
-	if (priv->fifo)
-		kfifo_free(priv->fifo);
-
 	free(priv);
 }
 
@@ -1169,12 +1437,6 @@ static int nfs_open(struct inode *inode, struct file *file)
 	priv->npriv = npriv;
 	file->private_data = priv;
 
-	priv->fifo = kfifo_alloc(1024);
-	if (!priv->fifo) {
-		free(priv);
-		return -ENOMEM;
-	}
-
 	return 0;
 }
 
@@ -1193,27 +1455,160 @@ static int nfs_write(struct device *_dev, struct file *file, const void *inbuf,
 	return -ENOSYS;
 }
 
+/*
+ * Read a file by keeping up to read_window READ calls of rsize bytes
+ * in flight. Replies may arrive in any order, but only the contiguous
+ * part from the start of the buffer is returned. A short read ends the
+ * request and the remaining data is requested again by the next call.
+ */
 static int nfs_read(struct device *dev, struct file *file, void *buf, size_t insize)
 {
 	struct file_priv *priv = file->private_data;
+	struct nfs_priv *npriv = priv->npriv;
+	struct nfs_read_slot slots[NFS_READ_WINDOW] = {};
+	size_t issued = 0, done = 0;
+	int i, ret = 0;
 
-	if (insize > 1024)
-		insize = 1024;
+	npriv->read_slots = slots;
 
-	if (insize && !kfifo_len(priv->fifo)) {
-		int ret = nfs_read_req(priv, file->f_pos, insize);
-		if (ret)
-			return ret;
+	while (done < insize) {
+		struct nfs_read_slot *slot;
+
+		for (i = 0; i < npriv->read_window && issued < insize; i++) {
+			slot = &slots[i];
+			if (slot->state != NFS_READ_FREE)
+				continue;
+
+			slot->xid = ++npriv->rpc_id;
+			slot->offset = file->f_pos + issued;
+			slot->count = min_t(size_t, npriv->rsize, insize - issued);
+			slot->dst = buf + issued;
+			slot->tries = 0;
+			slot->state = NFS_READ_PENDING;
+
+			/* a failed send is handled like a lost packet */
+			nfs_read_send(priv, slot);
+
+			issued += slot->count;
+		}
+
+		net_poll();
+
+		if (ctrlc()) {
+			ret = -EINTR;
+			break;
+		}
+
+		for (i = 0; i < NFS_READ_WINDOW; i++) {
+			slot = &slots[i];
+			if (slot->state != NFS_READ_PENDING ||
+			    !is_timeout(slot->sent, NFS_TIMEOUT))
+				continue;
+
+			if (++slot->tries == NFS_MAX_RESEND) {
+				ret = -ETIMEDOUT;
+				goto out;
+			}
+
+			nfs_read_send(priv, slot);
+		}
+
+		/* retire completed requests in order */
+		for (i = 0; i < NFS_READ_WINDOW; i++) {
+			slot = &slots[i];
+			if (slot->state != NFS_READ_DONE ||
+			    slot->offset != file->f_pos + done)
+				continue;
+
+			if (slot->ret < 0) {
+				ret = slot->ret;
+				goto out;
+			}
+
+			done += slot->ret;
+			slot->state = NFS_READ_FREE;
+
+			if (slot->ret < slot->count || slot->eof)
+				goto out;
+
+			/* start over, the next slot in order may be before this one */
+			i = -1;
+		}
 	}
 
-	return kfifo_get(priv->fifo, buf, insize);
+out:
+	npriv->read_slots = NULL;
+
+	if (done)
+		return done;
+
+	return ret;
 }
 
 static int nfs_lseek(struct device *dev, struct file *file, loff_t pos)
 {
-	struct file_priv *priv = file->private_data;
+	return 0;
+}
+
+/*
+ * Decode the attributes and handle of an entryplus3 and put them into the
+ * lookup cache, so that a following lookup of the entry needs no RPC.
+ */
+static int nfs_readdirplus_entry(struct nfs_priv *npriv, struct nfs_dir *ndir,
+				 const char *name, unsigned int *type)
+{
+	struct xdr_stream *xdr = &ndir->stream;
+	uint32_t *fattr = NULL;
+	struct nfs_fh fh;
+	__be32 *p;
+
+	/* name_attributes */
+	p = xdr_inline_decode(xdr, 4);
+	if (!p)
+		return -EIO;
+
+	if (net_read_uint32(p)) {
+		fattr = xdr_inline_decode(xdr, 84);
+		if (!fattr)
+			return -EIO;
+
+		switch (ntoh32(net_read_uint32(fattr))) {
+		case NF3REG:
+			*type = DT_REG;
+			break;
+		case NF3DIR:
+			*type = DT_DIR;
+			break;
+		case NF3LNK:
+			*type = DT_LNK;
+			break;
+		}
+	}
+
+	/* name_handle */
+	p = xdr_inline_decode(xdr, 4);
+	if (!p)
+		return -EIO;
+
+	if (!net_read_uint32(p))
+		return 0;
+
+	p = xdr_inline_decode(xdr, 4);
+	if (!p)
+		return -EIO;
+
+	fh.size = ntoh32(net_read_uint32(p));
+	if (fh.size > NFS3_FHSIZE)
+		return -EIO;
+
+	p = xdr_inline_decode(xdr, fh.size);
+	if (!p)
+		return -EIO;
+
+	memcpy(fh.data, p, fh.size);
 
-	kfifo_reset(priv->fifo);
+	if (fattr && strcmp(name, ".") && strcmp(name, ".."))
+		nfs_lookup_cache_add(npriv, &ndir->fh, name, &fh, fattr);
 
 	return 0;
 }
@@ -1231,6 +1626,7 @@ static int nfs_iterate(struct file *file, struct dir_context *ctx)
 
 	ndir = xzalloc(sizeof(*ndir));
 	ndir->fh = nfsi(dir)->fh;
+	ndir->plus = !npriv->no_readdirplus;
 
 	while (1) {
 		/* cookie == 0 and cookieverf == 0 means start of dir */
@@ -1245,6 +1641,7 @@ static int nfs_iterate(struct file *file, struct dir_context *ctx)
 
 		while (1) {
 			char name[256];
+			unsigned int type = DT_UNKNOWN;
 
 			p = xdr_inline_decode(xdr, 4);
 			if (!p)
@@ -1273,13 +1670,19 @@ static int nfs_iterate(struct file *file, struct dir_context *ctx)
 			if (ret)
 				goto out;
 
-			dir_emit(ctx, name, len, 0, DT_UNKNOWN);
-
 			p = xdr_inline_decode(xdr, 8);
 			if (!p)
 				goto err_eop;
 
 			ndir->cookie = ntoh64(net_read_uint64(p));
+
+			if (ndir->plus) {
+				ret = nfs_readdirplus_entry(npriv, ndir, name, &type);
+				if (ret)
+					goto err_eop;
+			}
+
+			dir_emit(ctx, name, len, 0, type);
 		}
 		free(buf);
 	}
@@ -1363,14 +1766,21 @@ static struct dentry *nfs_lookup(struct inode *dir, struct dentry *dentry,
 	struct nfs_inode *ndir = nfsi(dir);
 	struct inode *inode = new_inode(dir->i_sb);
 	struct nfs_priv *npriv = ndir->npriv;
+	struct nfs_lookup_entry *e;
 	int ret;
 
 	if (!inode)
 		return NULL;
 
-	ret = nfs_lookup_req(npriv, &ndir->fh, dentry->name, inode);
-	if (ret)
-		return NULL;
+	e = nfs_lookup_cache_find(npriv, &ndir->fh, dentry->name);
+	if (e) {
+		nfs_set_fh(inode, &e->fh);
+		nfs_fattr3_to_stat(e->fattr, inode);
+	} else {
+		ret = nfs_lookup_req(npriv, &ndir->fh, dentry->name, inode);
+		if (ret)
+			return NULL;
+	}
 
 	nfs_init_inode(npriv, inode, inode->i_mode);
 
@@ -1440,11 +1850,13 @@ static int nfs_probe(struct device *dev)
 	char *tmp = xstrdup(fsdev->backingstore);
 	char *path;
 	struct inode *inode;
+	unsigned long long rsize;
 	int ret;
 
 	dev->priv = npriv;
 
 	INIT_LIST_HEAD(&npriv->packets);
+	INIT_LIST_HEAD(&npriv->lookup_cache);
 
 	debug("nfs: mount: %s\n", fsdev->backingstore);
 
@@ -1512,6 +1924,16 @@ static int nfs_probe(struct device *dev)
 	debug("mount port: %hu\n", npriv->mount_port);
 	debug("nfs port: %d\n", npriv->nfs_port);
 
+	rsize = NFS_RSIZE_MAX;
+	parseopt_llu_suffix(fsdev->options, "rsize", &rsize);
+	npriv->rsize = clamp_t(unsigned long long, rsize, 4, NFS_RSIZE_MAX);
+	npriv->rsize = ALIGN_DOWN(npriv->rsize, 4);
+	npriv->read_window = clamp_t(unsigned int,
+				     NFS_READ_BYTES_MAX / npriv->rsize,
+				     1, NFS_READ_WINDOW);
+
+	debug("rsize: %u, read window: %u\n", npriv->rsize, npriv->read_window);
+
 	ret = nfs_mount_req(npriv);
 	if (ret) {
 		printf("mounting failed with %d\n", ret);
@@ -1520,6 +1942,8 @@ static int nfs_probe(struct device *dev)
 
 	nfs_set_rootarg(npriv, fsdev);
 
+	dev_add_param_uint32_ro(dev, "rpc_calls", &npriv->rpc_calls, "%u");
+
 	free(tmp);
 
 	sb->s_op = &nfs_ops;
@@ -1549,6 +1973,7 @@ static void nfs_remove(struct device *dev)
 
 	nfs_umount_req(npriv);
 
+	nfs_lookup_cache_clear(npriv);
 	net_unregister(npriv->con);
 	free(npriv->path);
 	free(npriv);
@@ -29,8 +29,7 @@
 
 struct ramfs_chunk {
 	unsigned long ofs;
-	int size;
-	struct list_head list;
+	unsigned long size;
 	char data[];
 };
 
@@ -45,9 +44,15 @@ struct ramfs_inode {
 	/* bytes currently allocated for this inode */
 	unsigned long alloc_size;
 
-	struct list_head data;
+	/* the chunks holding the data, sorted by offset */
+	struct ramfs_chunk **chunks;
+	unsigned int num_chunks;
+
+	/* index of the chunk used last */
+	unsigned int current_chunk;
 
-	struct ramfs_chunk *current_chunk;
+	/* memmap() has handed out a pointer to the data */
+	bool mapped;
 };
 
 static inline struct ramfs_inode *to_ramfs_inode(struct inode *inode)
@@ -184,30 +189,52 @@ static const struct inode_operations ramfs_dir_inode_operations =
 	.create = ramfs_create,
 };
 
+static bool ramfs_chunk_contains(struct ramfs_chunk *data, unsigned long pos)
+{
+	return pos >= data->ofs && pos - data->ofs < data->size;
+}
+
 static struct ramfs_chunk *ramfs_find_chunk(struct ramfs_inode *node,
-					    unsigned long pos, int *ofs, int *len)
+					    unsigned long pos, unsigned long *ofs,
+					    unsigned long *len)
 {
-	struct ramfs_chunk *data, *cur = node->current_chunk;
+	struct ramfs_chunk *data;
+	unsigned int i = node->current_chunk, lo, hi, mid;
 
-	if (cur && pos >= cur->ofs)
-		data = cur;
-	else
-		data = list_first_entry(&node->data, struct ramfs_chunk, list);
+	/* sequential accesses stay in the current chunk or move to the next one */
+	if (i >= node->num_chunks || !ramfs_chunk_contains(node->chunks[i], pos))
+		i++;
 
-	list_for_each_entry_from(data, &node->data, list) {
-		if (data->ofs + data->size > pos) {
-			*ofs = pos - data->ofs;
-			*len = data->size - *ofs;
+	if (i >= node->num_chunks || !ramfs_chunk_contains(node->chunks[i], pos)) {
+		lo = 0;
+		hi = node->num_chunks;
 
-			node->current_chunk = data;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			data = node->chunks[mid];
 
-			return data;
+			if (data->ofs + data->size <= pos)
+				lo = mid + 1;
+			else
+				hi = mid;
 		}
+
+		if (lo == node->num_chunks) {
+			pr_err("%s: no chunk for pos %ld found\n", __func__, pos);
+			return NULL;
+		}
+
+		i = lo;
 	}
 
-	pr_err("%s: no chunk for pos %ld found\n", __func__, pos);
+	data = node->chunks[i];
+
+	*ofs = pos - data->ofs;
+	*len = data->size - *ofs;
+
+	node->current_chunk = i;
 
-	return NULL;
+	return data;
 }
 
 static int ramfs_read(struct device *_dev, struct file *f, void *buf, size_t insize)
@@ -215,9 +242,9 @@ static int ramfs_read(struct device *_dev, struct file *f, void *buf, size_t ins
 	struct inode *inode = f->f_inode;
 	struct ramfs_inode *node = to_ramfs_inode(inode);
 	struct ramfs_chunk *data;
-	int ofs, len, now;
+	unsigned long ofs, len, now;
 	unsigned long pos = f->f_pos;
-	int size = insize;
+	size_t size = insize;
 
 	pr_vdebug("%s: %p %zu @ %lld\n", __func__, node, insize, f->f_pos);
 
@@ -226,9 +253,9 @@ static int ramfs_read(struct device *_dev, struct file *f, void *buf, size_t ins
 		if (!data)
 			return -EINVAL;
 
-		pr_vdebug("%s: pos: %lu ofs: %d len: %d\n", __func__, pos, ofs, len);
+		pr_vdebug("%s: pos: %lu ofs: %lu len: %lu\n", __func__, pos, ofs, len);
 
-		now = min(size, len);
+		now = min_t(unsigned long, size, len);
 
 		memcpy(buf, data->data + ofs, now);
 
@@ -246,9 +273,9 @@ static int ramfs_write(struct device *_dev, struct file *f, const void *buf,
 	struct inode *inode = f->f_inode;
 	struct ramfs_inode *node = to_ramfs_inode(inode);
 	struct ramfs_chunk *data;
-	int ofs, len, now;
+	unsigned long ofs, len, now;
 	unsigned long pos = f->f_pos;
-	int size = insize;
+	size_t size = insize;
 
 	pr_vdebug("%s: %p %zu @ %lld\n", __func__, node, insize, f->f_pos);
 
@@ -257,9 +284,9 @@ static int ramfs_write(struct device *_dev, struct file *f, const void *buf,
 		if (!data)
 			return -EINVAL;
 
-		pr_vdebug("%s: pos: %lu ofs: %d len: %d\n", __func__, pos, ofs, len);
+		pr_vdebug("%s: pos: %lu ofs: %lu len: %lu\n", __func__, pos, ofs, len);
 
-		now = min(size, len);
+		now = min_t(unsigned long, size, len);
 
 		memcpy(data->data + ofs, buf, now);
 
@@ -271,38 +298,118 @@ static int ramfs_write(struct device *_dev, struct file *f, const void *buf,
 	return insize;
 }
 
+/*
+ * Free the chunks beyond @size. Allocated space beyond the file size is
+ * always kept zeroed, so that growing the file within the allocated space
+ * doesn't reveal old data.
+ */
 static void ramfs_truncate_down(struct ramfs_inode *node, unsigned long size)
 {
-	struct ramfs_chunk *data, *tmp;
+	struct ramfs_chunk *data;
 
-	list_for_each_entry_safe(data, tmp, &node->data, list) {
-		if (data->ofs >= size) {
-			list_del(&data->list);
-			node->alloc_size -= data->size;
-			ramfs_put_chunk(data);
-		}
+	while (node->num_chunks) {
+		data = node->chunks[node->num_chunks - 1];
+		if (data->ofs < size)
+			break;
+
+		node->num_chunks--;
+		node->alloc_size -= data->size;
+		ramfs_put_chunk(data);
 	}
 
-	node->current_chunk = NULL;
+	if (node->num_chunks) {
+		data = node->chunks[node->num_chunks - 1];
+		if (size < node->size)
+			memset(data->data + size - data->ofs, 0,
+			       min(node->size, data->ofs + data->size) - size);
+	} else {
+		free(node->chunks);
+		node->chunks = NULL;
+		node->mapped = false;
+	}
+
+	node->current_chunk = 0;
+}
+
+static int ramfs_add_chunk(struct ramfs_inode *node, struct ramfs_chunk *data)
+{
+	struct ramfs_chunk **chunks;
+
+	chunks = realloc(node->chunks, (node->num_chunks + 1) * sizeof(*chunks));
+	if (!chunks)
+		return -ENOMEM;
+
+	data->ofs = node->alloc_size;
+
+	chunks[node->num_chunks++] = data;
+	node->chunks = chunks;
+	node->alloc_size += data->size;
+
+	return 0;
+}
+
+/*
+ * A file consisting of a single chunk is grown with realloc() to keep it
+ * contiguous so that it can be memmapped. Not possible once the data has
+ * been mapped as realloc() may move it.
+ */
+static int ramfs_grow_chunk(struct ramfs_inode *node, unsigned long add)
+{
+	struct ramfs_chunk *data;
+
+	if (node->num_chunks != 1 || node->mapped)
+		return -EINVAL;
+
+	data = node->chunks[0];
+
+	data = realloc(data, struct_size(data, data, data->size + add));
+	if (!data)
+		return -ENOMEM;
+
+	memset(data->data + data->size, 0, add);
+	data->size += add;
+
+	node->chunks[0] = data;
+	node->alloc_size += add;
+
+	return 0;
 }
 
 static int ramfs_truncate_up(struct ramfs_inode *node, unsigned long size)
 {
-	struct ramfs_chunk *data, *tmp;
-	LIST_HEAD(list);
+	struct ramfs_chunk *data;
+	unsigned long old_alloc_size = node->alloc_size;
 	unsigned long add = size - node->alloc_size;
-	unsigned long chunksize = add;
-	unsigned long alloc_size = 0;
+	unsigned long chunksize;
 
 	if (node->alloc_size >= size)
 		return 0;
 
+	/*
+	 * Allocate a quarter more than we currently have, so that a file
+	 * written sequentially in small pieces ends up in a small number of
+	 * chunks and is not copied too often by ramfs_grow_chunk().
+	 */
+	chunksize = max(add, node->alloc_size / 4);
+
+	if (!ramfs_grow_chunk(node, chunksize))
+		return 0;
+
+	data = ramfs_get_chunk(chunksize);
+	if (data) {
+		if (!ramfs_add_chunk(node, data))
+			return 0;
+		ramfs_put_chunk(data);
+	}
+
 	/*
 	 * We first try to allocate all space we need in a single chunk.
 	 * This may fail because of fragmented memory, so in case we cannot
 	 * allocate memory we successively decrease the chunk size until
 	 * we have enough allocations made.
 	 */
+	chunksize = add;
+
 	while (1) {
 		unsigned long now = min(chunksize, add);
 
@@ -318,11 +425,10 @@ static int ramfs_truncate_up(struct ramfs_inode *node, unsigned long size)
 			continue;
 		}
 
-		data->ofs = node->alloc_size + alloc_size;
-
-		alloc_size += data->size;
-
-		list_add_tail(&data->list, &list);
+		if (ramfs_add_chunk(node, data)) {
+			ramfs_put_chunk(data);
+			goto out;
+		}
 
 		if (add <= data->size)
 			break;
@@ -330,17 +436,10 @@ static int ramfs_truncate_up(struct ramfs_inode *node, unsigned long size)
 		add -= data->size;
 	}
 
-	list_splice_tail(&list, &node->data);
-
-	node->alloc_size += alloc_size;
-
 	return 0;
 
 out:
-	list_for_each_entry_safe(data, tmp, &list, list) {
-		list_del(&data->list);
-		ramfs_put_chunk(data);
-	}
+	ramfs_truncate_down(node, old_alloc_size);
 
 	return -ENOSPC;
 }
@@ -377,21 +476,62 @@ static int ramfs_truncate(struct device *dev, struct file *f, loff_t size)
 	return 0;
 }
 
+/* Move the data of a file spread over several chunks into a single one */
+static int ramfs_coalesce(struct ramfs_inode *node)
+{
+	struct ramfs_chunk *data, *chunk;
+	unsigned long now;
+	unsigned int i;
+
+	data = ramfs_get_chunk(node->size);
+	if (!data)
+		return -ENOMEM;
+
+	for (i = 0; i < node->num_chunks; i++) {
+		chunk = node->chunks[i];
+
+		if (chunk->ofs < node->size) {
+			now = min(chunk->size, node->size - chunk->ofs);
+			memcpy(data->data + chunk->ofs, chunk->data, now);
+		}
+
+		ramfs_put_chunk(chunk);
+	}
+
+	data->ofs = 0;
+	node->chunks[0] = data;
+	node->num_chunks = 1;
+	node->current_chunk = 0;
+	node->alloc_size = data->size;
+
+	return 0;
+}
+
 static int ramfs_memmap(struct device *_dev, struct file *f, void **map, int flags)
 {
 	struct inode *inode = f->f_inode;
 	struct ramfs_inode *node = to_ramfs_inode(inode);
-	struct ramfs_chunk *data;
+	int ret;
 
-	if (list_empty(&node->data))
+	if (!node->num_chunks)
 		return -EINVAL;
 
-	if (!list_is_singular(&node->data))
-		return -EINVAL;
+	if (node->num_chunks > 1) {
+		/*
+		 * Coalescing frees the old chunks, which an earlier mapping
+		 * may still point to.
+		 */
+		if (node->mapped)
+			return -EBUSY;
 
-	data = list_first_entry(&node->data, struct ramfs_chunk, list);
+		ret = ramfs_coalesce(node);
+		if (ret)
+			return ret;
+	}
 
-	*map = data->data;
+	node->mapped = true;
+
+	*map = node->chunks[0]->data;
 
 	return 0;
 }
@@ -402,8 +542,6 @@ static struct inode *ramfs_alloc_inode(struct super_block *sb)
 
 	node = xzalloc(sizeof(*node));
 
-	INIT_LIST_HEAD(&node->data);
-
 	return &node->inode;
 }
 
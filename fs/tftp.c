@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <globalvar.h>
+#include <magicvar.h>
 #include <init.h>
 #include <linux/bitmap.h>
 #include <linux/stat.h>
@@ -74,9 +75,11 @@
 
 #define TFTP_BLOCK_SIZE		512	/* default TFTP block size */
 #define TFTP_MTU_SIZE		1432	/* MTU based block size */
+#define TFTP_MAX_BLOCK_SIZE	65464	/* maximum block size (RFC 2348) */
 #define TFTP_MAX_WINDOW_SIZE	CONFIG_FS_TFTP_MAX_WINDOW_SIZE
 
-/* allocate this number of blocks more than needed in the fifo */
+/* allocate this number of blocks more than needed in the fifo and keep
+   as many received blocks queued before acknowledging new ones */
 #define TFTP_EXTRA_BLOCKS	2
 
 /* marker for an emtpy 'tftp_cache' */
@@ -95,12 +98,23 @@
 
 static int g_tftp_window_size = DIV_ROUND_UP(TFTP_MAX_WINDOW_SIZE, 2);
 
+/*
+ * Blocks larger than the MTU arrive as IP fragments. A lost fragment
+ * loses the whole block, so don't go all the way to the maximum by
+ * default.
+ */
+static int g_tftp_block_size = IS_ENABLED(CONFIG_NET_IP_FRAG) ?
+				SZ_16K : TFTP_MTU_SIZE;
+
 struct tftp_block {
 	uint16_t id;
 	uint16_t len;
+	uint16_t ofs;		/* bytes already consumed by tftp_read() */
 
 	struct list_head list;
-	uint8_t data[];
+	void *rxbuf;		/* network buffer holding 'data', if taken over */
+	uint8_t const *data;
+	uint8_t buf[];
 };
 
 struct tftp_cache {
@@ -125,6 +139,8 @@ struct file_priv {
 	unsigned int windowsize;
 	bool is_getattr;
 	struct tftp_cache cache;
+	struct list_head rx_blocks;	/* received blocks not read yet */
+	size_t rx_len;			/* bytes in 'rx_blocks' */
 };
 
 struct tftp_priv {
@@ -157,12 +173,50 @@ static bool in_window(uint16_t block, uint16_t start, uint16_t end)
 		(end   <= start && start <= block));
 }
 
-static void tftp_window_cache_free(struct tftp_cache *cache)
+/* keep the received data; without copying if the network buffer can be
+   taken over */
+static struct tftp_block *tftp_block_new(uint16_t id, void const *data,
+					 size_t len)
+{
+	struct tftp_block *block;
+	void *rxbuf;
+
+	rxbuf = net_rx_buf_take(data);
+	if (rxbuf) {
+		block = xzalloc(sizeof(*block));
+		block->data = data;
+	} else {
+		block = xzalloc(sizeof(*block) + len);
+		memcpy(block->buf, data, len);
+		block->data = block->buf;
+	}
+
+	block->rxbuf = rxbuf;
+	block->id = id;
+	block->len = len;
+
+	return block;
+}
+
+static void tftp_block_free(struct tftp_block *block)
+{
+	net_free_packet(block->rxbuf);
+	free(block);
+}
+
+static void tftp_blocks_free(struct list_head *blocks)
 {
 	struct tftp_block *block, *tmp;
 
-	list_for_each_entry_safe(block, tmp, &cache->blocks, list)
-		free(block);
+	list_for_each_entry_safe(block, tmp, blocks, list) {
+		list_del(&block->list);
+		tftp_block_free(block);
+	}
+}
+
+static void tftp_window_cache_free(struct tftp_cache *cache)
+{
+	tftp_blocks_free(&cache->blocks);
 }
 
 static int tftp_window_cache_insert(struct tftp_cache *cache, uint16_t id,
@@ -179,10 +233,7 @@ static int tftp_window_cache_insert(struct tftp_cache *cache, uint16_t id,
 		break;
 	}
 
-	new = xzalloc(sizeof(*new) + len);
-	memcpy(new->data, data, len);
-	new->id = id;
-	new->len = len;
+	new = tftp_block_new(id, data, len);
 	list_add_tail(&new->list, &block->list);
 
 	return 0;
@@ -205,6 +256,18 @@ static char const * const tftp_states[] = {
 	[STATE_START] = "START",
 };
 
+static int tftp_max_blocksize(const struct file_priv *priv)
+{
+	/*
+	 * Outgoing datagrams are never fragmented and incoming ones can only
+	 * be reassembled with IP fragment support.
+	 */
+	if (priv->push || !IS_ENABLED(CONFIG_NET_IP_FRAG))
+		return TFTP_MTU_SIZE;
+
+	return clamp(g_tftp_block_size, 8, TFTP_MAX_BLOCK_SIZE);
+}
+
 static int tftp_send(struct file_priv *priv)
 {
 	unsigned char *xp;
@@ -249,7 +312,8 @@ static int tftp_send(struct file_priv *priv)
 				'\0',	/* "blksize" */
 				/* use only a minimal blksize for getattr
 				   operations, */
-				priv->is_getattr ? TFTP_BLOCK_SIZE : TFTP_MTU_SIZE);
+				priv->is_getattr ? TFTP_BLOCK_SIZE :
+						   tftp_max_blocksize(priv));
 		pkt++;
 
 		if (!priv->push)
@@ -360,7 +424,7 @@ static int tftp_parse_oack(struct file_priv *priv, unsigned char *pkt, int len)
 		s = val + strlen(val) + 1;
 	}
 
-	if (priv->blocksize > TFTP_MTU_SIZE ||
+	if (priv->blocksize > tftp_max_blocksize(priv) ||
 	    priv->windowsize > TFTP_MAX_WINDOW_SIZE ||
 	    priv->windowsize == 0) {
 		pr_warn("tftp: invalid oack response\n");
@@ -380,14 +444,14 @@ static int tftp_allocate_transfer(struct file_priv *priv)
 	debug_assert(!priv->fifo);
 	debug_assert(!priv->buf);
 
-	/* multiplication is safe; both operands were checked in tftp_parse_oack()
-	   and are small integers */
-	priv->fifo = kfifo_alloc(priv->blocksize *
-				 (priv->windowsize + TFTP_EXTRA_BLOCKS));
-	if (!priv->fifo)
-		goto err;
-
 	if (priv->push) {
+		/* multiplication is safe; both operands were checked in
+		   tftp_parse_oack() and are small integers */
+		priv->fifo = kfifo_alloc(priv->blocksize *
+					 (priv->windowsize + TFTP_EXTRA_BLOCKS));
+		if (!priv->fifo)
+			goto err;
+
 		priv->buf = xmalloc(priv->blocksize);
 		if (!priv->buf) {
 			kfifo_free(priv->fifo);
@@ -407,27 +471,16 @@ static int tftp_allocate_transfer(struct file_priv *priv)
 	return priv->err;
 }
 
-static void tftp_put_data(struct file_priv *priv, uint16_t block,
-			  void const *pkt, size_t len)
+/* queue the next block for tftp_read(); 'block' must not be on a list */
+static void tftp_put_data(struct file_priv *priv, struct tftp_block *block)
 {
-	unsigned int sz;
-
-	if (len > priv->blocksize) {
-		pr_warn("tftp: oversized packet (%zu > %d) received\n",
-			len, priv->blocksize);
-		return;
-	}
+	size_t len = block->len;
 
-	priv->last_block = block;
+	priv->last_block = block->id;
+	priv->rx_len += len;
+	list_add_tail(&block->list, &priv->rx_blocks);
 
-	sz = kfifo_put(priv->fifo, pkt, len);
-
-	if (sz != len) {
-		pr_err("tftp: not enough room in kfifo (only %u out of %zu written)\n",
-		       sz, len);
-		priv->err = -ENOMEM;
-		priv->state = STATE_DONE;
-	} else if (len < priv->blocksize) {
+	if (len < priv->blocksize) {
 		tftp_send(priv);
 		priv->err = 0;
 		priv->state = STATE_DONE;
@@ -454,18 +507,16 @@ static void tftp_apply_window_cache(struct file_priv *priv)
 		if (is_block_before(block->id, priv->last_block + 1)) {
 			/* shouldn't happen, but be sure */
 			list_del(&block->list);
-			free(block);
+			tftp_block_free(block);
 			continue;
 		}
 
 		if (block->id != (uint16_t)(priv->last_block + 1))
 			return;
 
-		tftp_put_data(priv, block->id, block->data, block->len);
-
 		list_del(&block->list);
 
-		free(block);
+		tftp_put_data(priv, block);
 	}
 }
 
@@ -475,13 +526,19 @@ static void tftp_handle_data(struct file_priv *priv, uint16_t block,
 	uint16_t exp_block;
 	int rc;
 
+	if (len > priv->blocksize) {
+		pr_warn("tftp: oversized packet (%zu > %d) received\n",
+			len, priv->blocksize);
+		return;
+	}
+
 	exp_block = priv->last_block + 1;
 
 	if (exp_block == block) {
-		/* datagram over network is the expected one; put it in the
-		   fifo directly and try to apply cached items then */
+		/* datagram over network is the expected one; queue it
+		   directly and try to apply cached items then */
 		tftp_timer_reset(priv);
-		tftp_put_data(priv, block, data, len);
+		tftp_put_data(priv, tftp_block_new(block, data, len));
 		tftp_apply_window_cache(priv);
 	} else if (!in_window(block, exp_block, priv->ack_block)) {
 		/* completely unexpected and unrelated to actual window;
@@ -670,6 +727,7 @@ static struct file_priv *tftp_do_open(struct device *dev,
 	unsigned short port = TFTP_PORT;
 
 	priv = xzalloc(sizeof(*priv));
+	INIT_LIST_HEAD(&priv->rx_blocks);
 
 	switch (accmode & O_ACCMODE) {
 	case O_RDONLY:
@@ -755,6 +813,7 @@ static struct file_priv *tftp_do_open(struct device *dev,
 out1:
 	net_unregister(priv->tftp_con);
 out:
+	tftp_blocks_free(&priv->rx_blocks);
 	if (priv->fifo)
 		kfifo_free(priv->fifo);
 
@@ -810,7 +869,9 @@ static int tftp_do_close(struct file_priv *priv)
 
 	net_unregister(priv->tftp_con);
 	tftp_window_cache_free(&priv->cache);
-	kfifo_free(priv->fifo);
+	tftp_blocks_free(&priv->rx_blocks);
+	if (priv->fifo)
+		kfifo_free(priv->fifo);
 	free(priv->filename);
 	free(priv->buf);
 	free(priv);
@@ -861,6 +922,30 @@ static int tftp_write(struct device *_dev, struct file *f, const void *inbuf,
 	return insize;
 }
 
+static size_t tftp_get_data(struct file_priv *priv, void *buf, size_t size)
+{
+	struct tftp_block *block, *tmp;
+	size_t now, done = 0;
+
+	list_for_each_entry_safe(block, tmp, &priv->rx_blocks, list) {
+		now = min_t(size_t, size, block->len - block->ofs);
+		memcpy(buf + done, block->data + block->ofs, now);
+		block->ofs += now;
+		done += now;
+		size -= now;
+
+		if (block->ofs < block->len)
+			break;
+
+		list_del(&block->list);
+		tftp_block_free(block);
+	}
+
+	priv->rx_len -= done;
+
+	return done;
+}
+
 static int tftp_read(struct device *dev, struct file *f, void *buf, size_t insize)
 {
 	struct file_priv *priv = f->private_data;
@@ -870,7 +955,7 @@ static int tftp_read(struct device *dev, struct file *f, void *buf, size_t insiz
 	pr_vdebug("%s %zu\n", __func__, insize);
 
 	while (insize) {
-		now = kfifo_get(priv->fifo, buf, insize);
+		now = tftp_get_data(priv, buf, insize);
 		outsize += now;
 		buf += now;
 		insize -= now;
@@ -880,12 +965,12 @@ static int tftp_read(struct device *dev, struct file *f, void *buf, size_t insiz
 			break;
 		}
 
-		/* send the ACK only when fifo has been nearly depleted; else,
-		   when tftp_read() is called with small 'insize' values, it
-		   is possible that there is read more data from the network
-		   than consumed by kfifo_get() and the fifo overflows */
+		/* send the ACK only when the queue has been nearly depleted;
+		   else, when tftp_read() is called with small 'insize' values,
+		   more data would be read from the network than consumed by
+		   tftp_get_data() and the queue would grow without bounds */
 		if (priv->last_block == priv->ack_block &&
-		    kfifo_len(priv->fifo) <= TFTP_EXTRA_BLOCKS * priv->blocksize)
+		    priv->rx_len <= TFTP_EXTRA_BLOCKS * priv->blocksize)
 			tftp_send(priv);
 
 		ret = tftp_poll(priv);
@@ -1106,7 +1191,15 @@ static struct fs_driver tftp_driver = {
 static int tftp_init(void)
 {
 	globalvar_add_simple_int("tftp.windowsize", &g_tftp_window_size, "%u");
+	if (IS_ENABLED(CONFIG_NET_IP_FRAG))
+		globalvar_add_simple_int("tftp.blocksize", &g_tftp_block_size,
+					 "%u");
 
 	return register_fs_driver(&tftp_driver);
 }
 coredevice_initcall(tftp_init);
+
+#ifdef CONFIG_NET_IP_FRAG
+BAREBOX_MAGICVAR(global.tftp.blocksize,
+		 "Block size requested for TFTP downloads (8-65464, default 16384). Blocks above 1432 bytes arrive as IP fragments");
+#endif
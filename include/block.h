@@ -37,8 +37,15 @@ struct block_device_stats {
 	blkcnt_t read_sectors;
 	blkcnt_t write_sectors;
 	blkcnt_t erase_sectors;
+	blkcnt_t bypass_read_sectors;	/* part of read_sectors that bypassed the cache */
+	blkcnt_t bypass_write_sectors;	/* part of write_sectors that bypassed the cache */
+	blkcnt_t readahead_hits;	/* cache misses served from the readahead buffer */
+	blkcnt_t readahead_misses;	/* cache misses that needed a synchronous read */
 };
 
+/* for block_device::readahead, disables readahead from the start */
+#define BLOCK_READAHEAD_DISABLED	((u32)-1)
+
 struct block_device {
 	struct device *dev;
 	struct list_head list;
@@ -50,6 +57,28 @@ struct block_device {
 	int rdbufsize;
 	int blkmask;
 
+	/* cache geometry, drivers may set these before registering */
+	u32 cache_chunks;
+	u32 cache_chunk_size;
+
+	struct hlist_head *chunk_hash;
+	unsigned int chunk_hash_bits;
+	struct param_d *param_cache_chunks;
+	struct param_d *param_cache_chunk_size;
+
+	/*
+	 * sequential readahead, see block_readahead(). Drivers leave this
+	 * at 0 for the default or set BLOCK_READAHEAD_DISABLED before
+	 * registering, afterwards 0 means disabled.
+	 */
+	u32 readahead;		/* maximum readahead window in bytes */
+	void *ra_buf;
+	sector_t ra_start;	/* first block in ra_buf */
+	blkcnt_t ra_len;	/* number of valid blocks in ra_buf */
+	sector_t ra_next;	/* expected next block of a sequential stream */
+	blkcnt_t ra_window;	/* current readahead window in blocks */
+	struct param_d *param_readahead;
+
 	sector_t discard_start;
 	blkcnt_t discard_size;
 
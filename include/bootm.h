@@ -90,6 +90,13 @@ struct image_data {
 	const void *fit_kernel;
 	unsigned long fit_kernel_size;
 	void *fit_config;
+	/*
+	 * When the FIT kernel image is streamed to its load address, fit_kernel
+	 * only points to the first fit_kernel_head_size bytes of the kernel which
+	 * are read in advance so that the image handlers can analyze the kernel.
+	 */
+	void *fit_kernel_head;
+	size_t fit_kernel_head_size;
 
 	struct device_node *of_root_node;
 	struct resource *oftree_res;
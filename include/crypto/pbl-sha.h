@@ -5,9 +5,22 @@
 
 #include <digest.h>
 #include <types.h>
+#include <crypto/sha.h>
 
 int sha256_init(struct digest *desc);
 int sha256_update(struct digest *desc, const void *data, unsigned long len);
 int sha256_final(struct digest *desc, u8 *out);
 
+/* context size sufficient for all SHA-256 implementations usable in PBL */
+#define SHA256_PBL_CTX_SIZE	(sizeof(struct sha256_state) + sizeof(u64))
+
+#if defined(__PBL__) && IS_ENABLED(CONFIG_DIGEST_SHA256_ARM64_CE)
+struct digest_algo *sha256_ce_pbl_algo(void);
+#else
+static inline struct digest_algo *sha256_ce_pbl_algo(void)
+{
+	return NULL;
+}
+#endif
+
 #endif /* __PBL-SHA_H_ */
@@ -20,15 +20,19 @@
  * struct rsa_public_key - holder for a public key
  *
  * An RSA public key consists of a modulus (typically called N), the inverse
- * and R^2, where R is 2^(# key bits).
+ * and R^2, where R is 2^(# key bits). @mont caches these in the native
+ * word size of the CPU once the key is registered.
  */
 
+struct rsa_mont;
+
 struct rsa_public_key {
 	uint len;		/* len of modulus[] in number of uint32_t */
 	uint32_t n0inv;		/* -1 / modulus[0] mod 2^32 */
 	uint32_t *modulus;	/* modulus as little endian array */
 	uint32_t *rr;		/* R^2 as little endian array */
 	uint64_t exponent;	/* public exponent */
+	struct rsa_mont *mont;	/* Montgomery constants, computed if NULL */
 };
 
 /* This is the maximum signature length that we support, in bits */
@@ -72,6 +72,8 @@ int register_device(struct device *);
  */
 int device_probe(struct device *dev);
 
+void device_probe_note_supplier(struct device_node *np);
+
 /**
  * device_remove - Remove a device from its bus and driver
  *
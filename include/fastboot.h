@@ -19,9 +19,19 @@
  */
 #define FASTBOOT_CMD_FALLTHROUGH	1
 
+/*
+ * Positive return code of fastboot_handle_download_data(): The data has been
+ * accepted, but the transport must not pass more data until the
+ * resume_download callback is called.
+ */
+#define FASTBOOT_DOWNLOAD_STALL		1
+
+struct fastboot_stream;
+
 struct fastboot {
 	int (*write)(struct fastboot *fb, const char *buf, unsigned int n);
 	void (*start_download)(struct fastboot *fb);
+	void (*resume_download)(struct fastboot *fb);
 
 	struct file_list *files;
 	int (*cmd_exec)(struct fastboot *fb, const char *cmd);
@@ -35,6 +45,8 @@ struct fastboot {
 	size_t download_bytes;
 	size_t download_size;
 	struct list_head variables;
+
+	struct fastboot_stream *stream;
 };
 
 /**
@@ -39,6 +39,12 @@ bool fit_has_image(struct fit_handle *handle, void *configuration,
 int fit_open_image(struct fit_handle *handle, void *configuration,
 		   const char *name, const void **outdata,
 		   unsigned long *outsize);
+bool fit_image_is_streamable(struct fit_handle *handle, void *configuration,
+			     const char *name, unsigned long *outsize);
+ssize_t fit_read_image_head(struct fit_handle *handle, void *configuration,
+			    const char *name, void *buf, size_t len);
+int fit_load_image(struct fit_handle *handle, void *configuration,
+		   const char *name, void *dest, unsigned long size);
 int fit_get_image_address(struct fit_handle *handle, void *configuration,
 			  const char *name, const char *property,
 			  unsigned long *address);
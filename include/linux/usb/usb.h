@@ -158,6 +158,8 @@ struct usb_host {
 	int (*update_hub_device)(struct usb_device *dev);
 
 	bool no_desc_before_addr;
+	/* largest buffer submit_bulk_msg() accepts at once, 0 if unknown */
+	size_t max_bulk_len;
 
 	struct list_head list;
 
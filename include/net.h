@@ -31,6 +31,14 @@
 
 struct device;
 
+/* Number of packets that can be queued while a device is busy */
+#define ETH_TX_QUEUE_SIZE	32
+
+struct eth_tx_packet {
+	void *data;
+	int length;
+};
+
 struct eth_device {
 	int active;
 
@@ -38,6 +46,9 @@ struct eth_device {
 
 	int  (*open) (struct eth_device*);
 	int  (*send) (struct eth_device*, void *packet, int length);
+	/* optional, send several packets with a single kick of the hardware */
+	int  (*send_many) (struct eth_device*, struct eth_tx_packet *packets,
+			   int num);
 	void (*recv) (struct eth_device*);
 	void (*halt) (struct eth_device*);
 	int  (*get_ethaddr) (struct eth_device*, u8 adr[6]);
@@ -68,7 +79,9 @@ struct eth_device {
 
 	struct slice slice;
 
-	struct list_head send_queue;
+	/* packets sent while the device was busy, sent from the poller */
+	struct eth_tx_packet tx_queue[ETH_TX_QUEUE_SIZE];
+	unsigned int tx_queue_len;
 
 	bool ifup;
 #define ETH_MODE_DHCP 0
@@ -77,6 +90,11 @@ struct eth_device {
 	unsigned int global_mode;
 
 	uint64_t last_link_check;
+
+	/* receive statistics, exposed as device parameters */
+	uint32_t rx_delivered;	/* handed to a connection or answered */
+	uint32_t rx_unmatched;	/* no connection for the destination */
+	uint32_t rx_dropped;	/* malformed or not for us */
 };
 
 #define dev_to_edev(d) container_of(d, struct eth_device, dev)
@@ -157,6 +175,7 @@ struct ethernet {
 #define PROT_VLAN	0x8100		/* IEEE 802.1q protocol		*/
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 #define IP_BROADCAST    0xffffffff /* Broadcast IP aka 255.255.255.255 */
@@ -185,6 +204,26 @@ struct udphdr {
 	uint16_t	uh_sum;		/* udp checksum */
 } __attribute__ ((packed));
 
+struct tcphdr {
+	uint16_t	source;		/* source port */
+	uint16_t	dest;		/* destination port */
+	uint32_t	seq;		/* sequence number */
+	uint32_t	ack_seq;	/* acknowledgment number */
+	uint8_t		doff;		/* data offset in words, upper nibble */
+	uint8_t		flags;		/* TCP_FLAG_* */
+	uint16_t	window;		/* receive window */
+	uint16_t	check;		/* checksum */
+	uint16_t	urg_ptr;	/* urgent pointer */
+	/* The options start here. */
+} __attribute__ ((packed));
+
+#define TCP_FLAG_FIN	0x01
+#define TCP_FLAG_SYN	0x02
+#define TCP_FLAG_RST	0x04
+#define TCP_FLAG_PSH	0x08
+#define TCP_FLAG_ACK	0x10
+#define TCP_FLAG_URG	0x20
+
 /*
  *	Address Resolution Protocol (ARP) header.
  */
@@ -528,6 +567,10 @@ static inline void eth_addr_add(u8 *addr, long offset)
 	u64_to_ether_addr(u, addr);
 }
 
+/*
+ * For UDP and ICMP connections the handler is passed the whole received
+ * frame. For TCP connections it is passed the received payload in order.
+ */
 typedef void rx_handler_f(void *ctx, char *packet, unsigned int len);
 
 struct eth_device *eth_get_byname(const char *name);
@@ -541,28 +584,30 @@ struct eth_device *eth_get_byname(const char *name);
  */
 int net_receive(struct eth_device *edev, unsigned char *pkt, int len);
 
+bool net_receive_buf(struct eth_device *edev, void *buf, unsigned char *pkt,
+		     int len, void *spare);
+void *net_rx_buf_take(const void *data);
+
+struct tcp_sock;
+
 struct net_connection {
 	struct ethernet *et;
 	struct iphdr *ip;
 	struct udphdr *udp;
 	struct eth_device *edev;
 	struct icmphdr *icmp;
+	struct tcphdr *tcp;
+	struct tcp_sock *tcp_sock;
 	unsigned char *packet;
-	struct list_head list;
+	struct list_head list;		/* ICMP connections */
+	struct hlist_node udp_node;	/* UDP port hash */
 	rx_handler_f *handler;
 	int proto;
 	void *priv;
 };
 
-static inline char *net_alloc_packet(void)
-{
-	return dma_alloc(PKTSIZE);
-}
-
-static inline void net_free_packet(char *pkt)
-{
-	return dma_free(pkt);
-}
+char *net_alloc_packet(void);
+void net_free_packet(char *pkt);
 
 int net_alloc_packets(void **packets, int count);
 void net_free_packets(void **packets, unsigned count);
@@ -579,11 +624,46 @@ struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 
 void net_unregister(struct net_connection *con);
 
-static inline int net_udp_bind(struct net_connection *con, uint16_t sport)
+#ifdef CONFIG_NET_TCP
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx);
+struct net_connection *net_tcp_eth_new(struct eth_device *edev, IPaddr_t dest,
+				       uint16_t dport, rx_handler_f *handler,
+				       void *ctx);
+int net_tcp_send(struct net_connection *con, const void *buf, size_t len);
+int net_tcp_close(struct net_connection *con);
+bool net_tcp_eof(struct net_connection *con);
+
+/* internal to the network stack */
+int net_tcp_connect(struct net_connection *con, uint16_t sport, uint16_t dport);
+void net_tcp_release(struct net_connection *con);
+int net_handle_tcp(struct eth_device *edev, unsigned char *pkt, int len);
+void net_tcp_poll(void);
+#else
+static inline int net_tcp_connect(struct net_connection *con, uint16_t sport,
+				  uint16_t dport)
+{
+	return -ENOSYS;
+}
+static inline void net_tcp_release(struct net_connection *con) { }
+static inline int net_handle_tcp(struct eth_device *edev, unsigned char *pkt,
+				 int len)
 {
-	con->udp->uh_sport = ntohs(sport);
 	return 0;
 }
+static inline void net_tcp_poll(void) { }
+#endif
+
+#ifdef CONFIG_NET_IP_FRAG
+unsigned char *net_ip_defrag(unsigned char *pkt, int *len);
+#else
+static inline unsigned char *net_ip_defrag(unsigned char *pkt, int *len)
+{
+	return NULL;
+}
+#endif
+
+int net_udp_bind(struct net_connection *con, uint16_t sport);
 
 static inline void *net_udp_get_payload(struct net_connection *con)
 {
@@ -591,6 +671,7 @@ static inline void *net_udp_get_payload(struct net_connection *con)
 		sizeof(struct udphdr);
 }
 
+int net_ip_send(struct net_connection *con, int len);
 int net_udp_send(struct net_connection *con, int len);
 int net_icmp_send(struct net_connection *con, int len);
 
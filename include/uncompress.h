@@ -21,6 +21,12 @@ int uncompress_buf_to_fd(const void *input, size_t input_len,
 ssize_t uncompress_buf_to_buf(const void *input, size_t input_len,
 			      void **buf, void(*error_fn)(char *x));
 
+ssize_t uncompress_buf_to_fixed_buf(const void *input, size_t input_len,
+				    void *output, size_t output_len,
+				    void(*error_fn)(char *x));
+
+ssize_t uncompress_get_size(const void *input, size_t input_len);
+
 void uncompress_err_stdout(char *);
 
 #endif /* __UNCOMPRESS_H */
@@ -127,7 +127,7 @@ static int sparse_seek(struct sparse_image_ctx *si)
 		if (payload != sizeof(uint32_t))
 			return -EINVAL;
 
-		offs = lseek(si->fd, chunk_data_sz, SEEK_CUR);
+		offs = lseek(si->fd, payload, SEEK_CUR);
 		if (offs == -1)
 			return -EINVAL;
 		goto again;
@@ -244,3 +244,317 @@ void sparse_image_close(struct sparse_image_ctx *si)
 	close(si->fd);
 	free(si);
 }
+
+enum sparse_stream_state {
+	SPARSE_STREAM_FILE_HDR,
+	SPARSE_STREAM_CHUNK_HDR,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_FILL,
+	SPARSE_STREAM_SKIP,
+	SPARSE_STREAM_DONE,
+};
+
+struct sparse_image_stream {
+	sparse_image_write_fn write;
+	void *ctx;
+
+	enum sparse_stream_state state;
+	size_t got;		/* bytes of the current header received */
+	uint64_t remaining;	/* bytes left in a raw chunk or to skip */
+
+	struct sparse_header sparse;
+	struct chunk_header chunk;
+	uint32_t processed_chunks;
+	uint32_t fill_val;
+	uint32_t *fill_buf;
+	loff_t pos;
+};
+
+#define SPARSE_FILL_BUF_SIZE	SZ_64K
+
+/**
+ * sparse_image_stream_new - create an incremental sparse image decoder
+ * @write: called for each range of output data
+ * @ctx: passed to @write
+ *
+ * Unlike sparse_image_open(), the image does not need to be stored in a
+ * file. It is passed in pieces of arbitrary size to sparse_image_stream_write()
+ * as it arrives, and @write is called with the decoded data and its offset
+ * in the output image. Don't care chunks are skipped without calling @write.
+ */
+struct sparse_image_stream *sparse_image_stream_new(sparse_image_write_fn write,
+						    void *ctx)
+{
+	struct sparse_image_stream *ss;
+
+	ss = xzalloc(sizeof(*ss));
+	ss->write = write;
+	ss->ctx = ctx;
+	ss->state = SPARSE_STREAM_FILE_HDR;
+
+	return ss;
+}
+
+/* Size of the output image, 0 until the file header has been received */
+loff_t sparse_image_stream_size(struct sparse_image_stream *ss)
+{
+	if (ss->state == SPARSE_STREAM_FILE_HDR)
+		return 0;
+
+	return (loff_t)le32_to_cpu(ss->sparse.blk_sz) *
+		le32_to_cpu(ss->sparse.total_blks);
+}
+
+/*
+ * Collect a header of @total bytes of which the first @size bytes are
+ * stored in @hdr and the rest is skipped. It may be split over several
+ * calls to sparse_image_stream_write(). Returns true once it is complete.
+ */
+static bool sparse_stream_collect(struct sparse_image_stream *ss, void *hdr,
+				  size_t size, size_t total,
+				  const u8 **buf, size_t *len)
+{
+	size_t now = min(*len, total - ss->got);
+
+	if (ss->got < size)
+		memcpy(hdr + ss->got, *buf, min(now, size - ss->got));
+
+	ss->got += now;
+	*buf += now;
+	*len -= now;
+
+	if (ss->got < total)
+		return false;
+
+	ss->got = 0;
+
+	return true;
+}
+
+static enum sparse_stream_state sparse_stream_next_chunk(struct sparse_image_stream *ss)
+{
+	if (ss->processed_chunks == le32_to_cpu(ss->sparse.total_chunks))
+		return SPARSE_STREAM_DONE;
+
+	return SPARSE_STREAM_CHUNK_HDR;
+}
+
+static int sparse_stream_file_hdr(struct sparse_image_stream *ss)
+{
+	struct sparse_header *sparse = &ss->sparse;
+	uint32_t blk_sz = le32_to_cpu(sparse->blk_sz);
+
+	if (!is_sparse_image(sparse))
+		return -EINVAL;
+
+	if (le16_to_cpu(sparse->file_hdr_sz) < sizeof(struct sparse_header) ||
+	    le16_to_cpu(sparse->chunk_hdr_sz) < sizeof(struct chunk_header) ||
+	    !blk_sz || blk_sz % sizeof(uint32_t))
+		return -EINVAL;
+
+	/* skip the remaining bytes in a header longer than we expected */
+	ss->remaining = le16_to_cpu(sparse->file_hdr_sz) -
+			sizeof(struct sparse_header);
+	ss->state = SPARSE_STREAM_SKIP;
+
+	return 0;
+}
+
+static int sparse_stream_chunk_hdr(struct sparse_image_stream *ss)
+{
+	uint32_t total_sz = le32_to_cpu(ss->chunk.total_sz);
+	uint64_t chunk_data_sz;
+	uint32_t payload;
+
+	pr_debug("=== Chunk Header ===\n");
+	pr_debug("chunk_type: 0x%x\n", le16_to_cpu(ss->chunk.chunk_type));
+	pr_debug("chunk_data_sz: 0x%x\n", le32_to_cpu(ss->chunk.chunk_sz));
+	pr_debug("total_size: 0x%x\n", total_sz);
+
+	if (total_sz < le16_to_cpu(ss->sparse.chunk_hdr_sz))
+		return -EINVAL;
+
+	chunk_data_sz = (uint64_t)le32_to_cpu(ss->sparse.blk_sz) *
+			le32_to_cpu(ss->chunk.chunk_sz);
+	payload = total_sz - le16_to_cpu(ss->sparse.chunk_hdr_sz);
+
+	ss->processed_chunks++;
+
+	switch (le16_to_cpu(ss->chunk.chunk_type)) {
+	case CHUNK_TYPE_RAW:
+		if (payload != chunk_data_sz)
+			return -EINVAL;
+
+		ss->remaining = payload;
+		ss->state = payload ? SPARSE_STREAM_RAW : sparse_stream_next_chunk(ss);
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (payload != sizeof(uint32_t))
+			return -EINVAL;
+
+		ss->state = SPARSE_STREAM_FILL;
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		ss->pos += chunk_data_sz;
+		ss->remaining = payload;
+		ss->state = SPARSE_STREAM_SKIP;
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (payload != sizeof(uint32_t))
+			return -EINVAL;
+
+		ss->remaining = payload;
+		ss->state = SPARSE_STREAM_SKIP;
+		break;
+
+	default:
+		pr_err("Unknown chunk type 0x%04x",
+		       le16_to_cpu(ss->chunk.chunk_type));
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int sparse_stream_fill(struct sparse_image_stream *ss)
+{
+	uint64_t left = (uint64_t)le32_to_cpu(ss->sparse.blk_sz) *
+			le32_to_cpu(ss->chunk.chunk_sz);
+	size_t now;
+	int i, ret;
+
+	if (!ss->fill_buf)
+		ss->fill_buf = xmalloc(SPARSE_FILL_BUF_SIZE);
+
+	for (i = 0; i < SPARSE_FILL_BUF_SIZE / sizeof(uint32_t); i++)
+		ss->fill_buf[i] = ss->fill_val;
+
+	while (left) {
+		now = min_t(uint64_t, left, SPARSE_FILL_BUF_SIZE);
+
+		ret = ss->write(ss->ctx, ss->fill_buf, ss->pos, now);
+		if (ret)
+			return ret;
+
+		ss->pos += now;
+		left -= now;
+	}
+
+	return 0;
+}
+
+/**
+ * sparse_image_stream_write - pass the next part of a sparse image
+ * @ss: The decoder
+ * @data: The data
+ * @len: The length of @data
+ *
+ * Return: 0 for success or a negative error code if the image is invalid or
+ * the write callback failed. Data after the last chunk is ignored.
+ */
+int sparse_image_stream_write(struct sparse_image_stream *ss, const void *data,
+			      size_t len)
+{
+	const u8 *buf = data;
+	size_t now;
+	int ret;
+
+	while (len) {
+		switch (ss->state) {
+		case SPARSE_STREAM_FILE_HDR:
+			if (!sparse_stream_collect(ss, &ss->sparse,
+						   sizeof(ss->sparse),
+						   sizeof(ss->sparse), &buf, &len))
+				return 0;
+
+			ret = sparse_stream_file_hdr(ss);
+			if (ret)
+				return ret;
+			break;
+
+		case SPARSE_STREAM_CHUNK_HDR:
+			if (!sparse_stream_collect(ss, &ss->chunk,
+						   sizeof(ss->chunk),
+						   le16_to_cpu(ss->sparse.chunk_hdr_sz),
+						   &buf, &len))
+				return 0;
+
+			ret = sparse_stream_chunk_hdr(ss);
+			if (ret)
+				return ret;
+			break;
+
+		case SPARSE_STREAM_RAW:
+			now = min_t(uint64_t, len, ss->remaining);
+
+			ret = ss->write(ss->ctx, buf, ss->pos, now);
+			if (ret)
+				return ret;
+
+			ss->pos += now;
+			ss->remaining -= now;
+			buf += now;
+			len -= now;
+
+			if (!ss->remaining)
+				ss->state = sparse_stream_next_chunk(ss);
+			break;
+
+		case SPARSE_STREAM_FILL:
+			if (!sparse_stream_collect(ss, &ss->fill_val,
+						   sizeof(ss->fill_val),
+						   sizeof(ss->fill_val), &buf, &len))
+				return 0;
+
+			ret = sparse_stream_fill(ss);
+			if (ret)
+				return ret;
+
+			ss->state = sparse_stream_next_chunk(ss);
+			break;
+
+		case SPARSE_STREAM_SKIP:
+			now = min_t(uint64_t, len, ss->remaining);
+
+			ss->remaining -= now;
+			buf += now;
+			len -= now;
+
+			if (!ss->remaining)
+				ss->state = sparse_stream_next_chunk(ss);
+			break;
+
+		case SPARSE_STREAM_DONE:
+			return 0;
+		}
+	}
+
+	/* a header without chunks or ending on a skipped area */
+	if (ss->state == SPARSE_STREAM_SKIP && !ss->remaining)
+		ss->state = sparse_stream_next_chunk(ss);
+
+	return 0;
+}
+
+/**
+ * sparse_image_stream_finish - check that a sparse image was complete
+ * @ss: The decoder
+ *
+ * Return: 0 if all chunks of the image have been processed, -EINVAL otherwise
+ */
+int sparse_image_stream_finish(struct sparse_image_stream *ss)
+{
+	if (ss->state == SPARSE_STREAM_SKIP && !ss->remaining)
+		ss->state = sparse_stream_next_chunk(ss);
+
+	return ss->state == SPARSE_STREAM_DONE ? 0 : -EINVAL;
+}
+
+void sparse_image_stream_free(struct sparse_image_stream *ss)
+{
+	free(ss->fill_buf);
+	free(ss);
+}
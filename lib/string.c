@@ -391,11 +391,26 @@ EXPORT_SYMBOL(_strrchr);
  */
 size_t strlen(const char * s)
 {
+	const struct word_at_a_time constants = WORD_AT_A_TIME_CONSTANTS;
 	const char *sc;
+	unsigned long c, data;
 
-	for (sc = s; *sc != '\0'; ++sc)
-		/* nothing */;
-	return sc - s;
+	for (sc = s; (long)sc & (sizeof(long) - 1); ++sc)
+		if (*sc == '\0')
+			return sc - s;
+
+	/*
+	 * Aligned word reads never cross a page boundary, so reading past
+	 * the terminating NUL within the last word is harmless.
+	 */
+	for (;; sc += sizeof(long)) {
+		c = read_word_at_a_time(sc);
+		if (has_zero(c, &data, &constants)) {
+			data = prep_zero_mask(c, data, &constants);
+			data = create_zero_mask(data);
+			return sc - s + find_zero(data);
+		}
+	}
 }
 #endif
 EXPORT_SYMBOL(strlen);
@@ -633,6 +648,34 @@ void *__default_memset(void * s, int c, size_t count)
 {
 	char *xs = (char *) s;
 
+	if (count >= 2 * sizeof(long)) {
+		unsigned long pattern = REPEAT_BYTE((u8)c);
+		unsigned long *ls;
+
+		while ((long)xs & (sizeof(long) - 1)) {
+			*xs++ = c;
+			count--;
+		}
+
+		ls = (unsigned long *)xs;
+
+		while (count >= 4 * sizeof(long)) {
+			ls[0] = pattern;
+			ls[1] = pattern;
+			ls[2] = pattern;
+			ls[3] = pattern;
+			ls += 4;
+			count -= 4 * sizeof(long);
+		}
+
+		while (count >= sizeof(long)) {
+			*ls++ = pattern;
+			count -= sizeof(long);
+		}
+
+		xs = (char *)ls;
+	}
+
 	while (count--)
 		*xs++ = c;
 
@@ -669,6 +712,43 @@ void *__default_memcpy(void * dest,const void *src, size_t count)
 {
 	char *tmp = (char *) dest, *s = (char *) src;
 
+	/*
+	 * Copy word-wise once dest is aligned. Without efficient unaligned
+	 * access this is only possible if src shares dest's alignment.
+	 */
+	if (count >= 2 * sizeof(long) &&
+	    (IS_ENABLED(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) ||
+	     !(((long)tmp ^ (long)s) & (sizeof(long) - 1)))) {
+		unsigned long *ld;
+		const unsigned long *ls;
+
+		while ((long)tmp & (sizeof(long) - 1)) {
+			*tmp++ = *s++;
+			count--;
+		}
+
+		ld = (unsigned long *)tmp;
+		ls = (const unsigned long *)s;
+
+		while (count >= 4 * sizeof(long)) {
+			ld[0] = ls[0];
+			ld[1] = ls[1];
+			ld[2] = ls[2];
+			ld[3] = ls[3];
+			ld += 4;
+			ls += 4;
+			count -= 4 * sizeof(long);
+		}
+
+		while (count >= sizeof(long)) {
+			*ld++ = *ls++;
+			count -= sizeof(long);
+		}
+
+		tmp = (char *)ld;
+		s = (char *)ls;
+	}
+
 	while (count--)
 		*tmp++ = *s++;
 
@@ -746,10 +826,31 @@ void *__memmove(void * dest, const void *src, size_t count)
  */
 int memcmp(const void * cs,const void * ct,size_t count)
 {
-	const unsigned char *su1, *su2;
+	const unsigned char *su1 = cs, *su2 = ct;
 	int res = 0;
 
-	for( su1 = cs, su2 = ct; 0 < count; ++su1, ++su2, count--)
+	if (count >= 2 * sizeof(long) &&
+	    (IS_ENABLED(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS) ||
+	     !(((long)su1 ^ (long)su2) & (sizeof(long) - 1)))) {
+		while ((long)su1 & (sizeof(long) - 1)) {
+			if ((res = *su1 - *su2) != 0)
+				return res;
+			su1++;
+			su2++;
+			count--;
+		}
+
+		/* skip equal words, the byte loop below locates a difference */
+		while (count >= sizeof(long)) {
+			if (*(const unsigned long *)su1 != *(const unsigned long *)su2)
+				break;
+			su1 += sizeof(long);
+			su2 += sizeof(long);
+			count -= sizeof(long);
+		}
+	}
+
+	for (; 0 < count; ++su1, ++su2, count--)
 		if ((res = *su1 - *su2) != 0)
 			break;
 	return res;
@@ -21,11 +21,14 @@
 #include <linux/xz.h>
 #include <linux/decompress/unlz4.h>
 #include <linux/decompress/unzstd.h>
+#include <linux/zstd.h>
 #include <errno.h>
 #include <filetype.h>
 #include <malloc.h>
 #include <fs.h>
 #include <libfile.h>
+#include <zero_page.h>
+#include <asm/unaligned.h>
 
 static void *uncompress_buf;
 static unsigned long uncompress_size;
@@ -217,3 +220,98 @@ ssize_t uncompress_buf_to_buf(const void *input, size_t input_len,
 
 	return ret ?: size;
 }
+
+static void *uncompress_out;
+static size_t uncompress_out_size, uncompress_out_pos;
+static bool uncompress_out_overflow;
+
+static long flush_fixed_buf(void *buf, unsigned long len)
+{
+	void *dest = uncompress_out + uncompress_out_pos;
+	size_t now = min_t(size_t, len, uncompress_out_size - uncompress_out_pos);
+
+	if (now < len)
+		uncompress_out_overflow = true;
+
+	if (zero_page_contains((unsigned long)dest))
+		zero_page_memcpy(dest, buf, now);
+	else
+		memcpy(dest, buf, now);
+
+	uncompress_out_pos += now;
+
+	/* a short count makes the decompressor bail out */
+	return now;
+}
+
+/**
+ * uncompress_buf_to_fixed_buf - uncompress a buffer to a given output buffer
+ * @input:	The compressed input data
+ * @input_len:	The length of the compressed input data
+ * @output:	The buffer to uncompress to
+ * @output_len:	The size of @output
+ * @error_fn:	Function used to report errors
+ *
+ * Unlike uncompress_buf_to_buf() this uncompresses directly to @output without
+ * allocating any intermediate buffers for the uncompressed data. @output may be
+ * located in the zero page.
+ *
+ * Return: The number of uncompressed bytes, -ENOSPC if the uncompressed data
+ * does not fit into @output or another negative error code. In case of -ENOSPC
+ * @output contains the first @output_len bytes of the uncompressed data.
+ */
+ssize_t uncompress_buf_to_fixed_buf(const void *input, size_t input_len,
+				    void *output, size_t output_len,
+				    void(*error_fn)(char *x))
+{
+	int ret;
+
+	uncompress_out = output;
+	uncompress_out_size = output_len;
+	uncompress_out_pos = 0;
+	uncompress_out_overflow = false;
+
+	ret = uncompress((void *)input, input_len, NULL, flush_fixed_buf,
+			 NULL, NULL, error_fn);
+	if (uncompress_out_overflow)
+		return -ENOSPC;
+	if (ret)
+		return ret < 0 ? ret : -EIO;
+
+	return uncompress_out_pos;
+}
+
+/**
+ * uncompress_get_size - get the uncompressed size of a buffer
+ * @input:	The compressed input data
+ * @input_len:	The length of the compressed input data
+ *
+ * Not all compression formats store the uncompressed size. It is available
+ * for gzip (modulo 4GiB) and for zstd when the frame header contains it.
+ *
+ * Return: The uncompressed size or a negative error code
+ */
+ssize_t uncompress_get_size(const void *input, size_t input_len)
+{
+	switch (file_detect_compression_type(input, input_len)) {
+	case filetype_gzip:
+		if (!IS_ENABLED(CONFIG_ZLIB) || input_len < 18)
+			return -EINVAL;
+		return get_unaligned_le32(input + input_len - 4);
+	case filetype_zstd_compressed: {
+		unsigned long long size;
+
+		if (!IS_ENABLED(CONFIG_ZSTD_DECOMPRESS))
+			return -ENOSYS;
+
+		size = ZSTD_getFrameContentSize(input, input_len);
+		if (size == ZSTD_CONTENTSIZE_UNKNOWN ||
+		    size == ZSTD_CONTENTSIZE_ERROR || size > SSIZE_MAX)
+			return -ENOSYS;
+
+		return size;
+	}
+	default:
+		return -ENOSYS;
+	}
+}
@@ -208,36 +208,63 @@ static int eth_carrier_check(struct eth_device *edev, bool may_wait)
 	return edev->phydev->link ? 0 : -ENETDOWN;
 }
 
-struct eth_q {
-	struct eth_device *edev;
-	int length;
-	struct list_head list;
-	void *data;
-};
-
+/*
+ * Queue packets sent while the device is busy. The queue buffers are
+ * allocated on first use and kept until the device is unregistered.
+ */
 static int eth_queue(struct eth_device *edev, void *packet, int length)
 {
-	struct eth_q *q;
+	struct eth_tx_packet *q;
+
+	if (length > PKTSIZE)
+		return -EMSGSIZE;
 
-	q = xzalloc(sizeof(*q));
-	if (!q)
-		return -ENOMEM;
+	if (edev->tx_queue_len == ETH_TX_QUEUE_SIZE)
+		return -ENOBUFS;
 
-	q->data = dma_alloc(length);
+	q = &edev->tx_queue[edev->tx_queue_len];
 	if (!q->data) {
-		free(q);
-		return -ENOMEM;
+		q->data = net_alloc_packet();
+		if (!q->data)
+			return -ENOMEM;
 	}
 
-	q->length = length;
-	q->edev = edev;
-
 	memcpy(q->data, packet, length);
-	list_add_tail(&q->list, &edev->send_queue);
+	q->length = length;
+	edev->tx_queue_len++;
 
 	return 0;
 }
 
+/*
+ * Pass packets to the driver, in one go if it supports that. Must be
+ * called with the device slice acquired.
+ */
+static int eth_send_raw_many(struct eth_device *edev,
+			     struct eth_tx_packet *packets, int num)
+{
+	int i, ret = 0, err;
+
+	led_trigger_network(LED_TRIGGER_NET_TX);
+
+	if (edev->send_many) {
+		if (edev->tx_monitor)
+			for (i = 0; i < num; i++)
+				edev->tx_monitor(edev, packets[i].data,
+						 packets[i].length);
+
+		return edev->send_many(edev, packets, num);
+	}
+
+	for (i = 0; i < num; i++) {
+		err = eth_send_raw(edev, packets[i].data, packets[i].length);
+		if (err && !ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
 int eth_send(struct eth_device *edev, void *packet, int length)
 {
 	int ret;
@@ -265,7 +292,6 @@ int eth_send(struct eth_device *edev, void *packet, int length)
 
 static void eth_do_work(struct eth_device *edev)
 {
-	struct eth_q *q, *tmp;
 	int ret;
 
 	if (!phy_acquired(edev->phydev)) {
@@ -281,12 +307,9 @@ static void eth_do_work(struct eth_device *edev)
 
 	edev->recv(edev);
 
-	list_for_each_entry_safe(q, tmp, &edev->send_queue, list) {
-		led_trigger_network(LED_TRIGGER_NET_TX);
-		eth_send_raw(edev, q->data, q->length);
-		list_del(&q->list);
-		free(q->data);
-		free(q);
+	if (edev->tx_queue_len) {
+		eth_send_raw_many(edev, edev->tx_queue, edev->tx_queue_len);
+		edev->tx_queue_len = 0;
 	}
 
 	slice_release(eth_device_slice(edev));
@@ -447,7 +470,8 @@ int eth_register(struct eth_device *edev)
 		edev->dev.id = DEVICE_ID_DYNAMIC;
 	}
 
-	INIT_LIST_HEAD(&edev->send_queue);
+	memset(edev->tx_queue, 0, sizeof(edev->tx_queue));
+	edev->tx_queue_len = 0;
 
 	ret = register_device(&edev->dev);
 	if (ret)
@@ -470,6 +494,9 @@ int eth_register(struct eth_device *edev)
 	dev_add_param_enum(dev, "mode", NULL, NULL, &edev->global_mode,
 				  eth_mode_names, ARRAY_SIZE(eth_mode_names),
 				  NULL);
+	dev_add_param_uint32_ro(dev, "rx_delivered", &edev->rx_delivered, "%u");
+	dev_add_param_uint32_ro(dev, "rx_unmatched", &edev->rx_unmatched, "%u");
+	dev_add_param_uint32_ro(dev, "rx_dropped", &edev->rx_dropped, "%u");
 
 	if (edev->init)
 		edev->init(edev);
@@ -524,19 +551,14 @@ void eth_close(struct eth_device *edev)
 
 void eth_unregister(struct eth_device *edev)
 {
-	struct eth_q *q, *tmp;
+	int i;
 
 	if (edev->active)
 		edev->halt(edev);
 
-	list_for_each_entry_safe(q, tmp, &edev->send_queue, list) {
-		if (q->edev != edev)
-			continue;
-
-		list_del(&q->list);
-		free(q->data);
-		free(q);
-	}
+	for (i = 0; i < ETH_TX_QUEUE_SIZE; i++)
+		net_free_packet(edev->tx_queue[i].data);
+	edev->tx_queue_len = 0;
 
 	if (IS_ENABLED(CONFIG_OFDEVICE))
 		free_const(edev->nodepath);
@@ -58,6 +58,7 @@ struct fastboot_net {
 	u64 last_download_pkt;
 	bool sequence_number_seen;
 	bool active_download;
+	bool download_stalled;
 	bool reinit;
 	bool send_keep_alive;
 	enum may_send may_send;
@@ -85,6 +86,7 @@ static void fastboot_net_abort(struct fastboot_net *fbn)
 	fastboot_abort(&fbn->fastboot);
 
 	fbn->active_download = false;
+	fbn->download_stalled = false;
 
 	poller_unregister(&fbn->poller);
 
@@ -256,7 +258,10 @@ static void fastboot_start_download_net(struct fastboot *fb)
 	fbn->last_download_pkt = get_time_ns();
 }
 
-/* must send exactly one packet on all code paths */
+/*
+ * must send exactly one packet on all code paths, except when the download
+ * is stalled. The ACK is sent by fastboot_resume_download_net() then.
+ */
 static void fastboot_data_download(struct fastboot_net *fbn,
 				   const void *fastboot_data,
 				   unsigned int fastboot_data_len)
@@ -278,9 +283,28 @@ static void fastboot_data_download(struct fastboot_net *fbn,
 		return;
 	}
 
+	if (ret == FASTBOOT_DOWNLOAD_STALL) {
+		fbn->download_stalled = true;
+		return;
+	}
+
 	fastboot_tx_print(&fbn->fastboot, FASTBOOT_MSG_NONE, "");
 }
 
+static void fastboot_resume_download_net(struct fastboot *fb)
+{
+	struct fastboot_net *fbn = container_of(fb, struct fastboot_net,
+						fastboot);
+
+	if (!fbn->download_stalled)
+		return;
+
+	fbn->download_stalled = false;
+	fbn->last_download_pkt = get_time_ns();
+
+	fastboot_tx_print(fb, FASTBOOT_MSG_NONE, "");
+}
+
 struct fastboot_work {
 	struct work_struct work;
 	struct fastboot_net *fbn;
@@ -467,7 +491,7 @@ static void fastboot_poll(struct poller_struct *poller)
 	struct fastboot_net *fbn = container_of(poller, struct fastboot_net,
 					       poller);
 
-	if (fbn->active_download) {
+	if (fbn->active_download && !fbn->download_stalled) {
 		net_poll();
 		if (is_timeout(fbn->last_download_pkt, 5 * SECOND)) {
 			pr_err("No progress for 5s, aborting\n");
@@ -507,6 +531,7 @@ struct fastboot_net *fastboot_net_init(struct fastboot_opts *opts)
 	fbn = xzalloc(sizeof(*fbn));
 	fbn->fastboot.write = fastboot_write_net;
 	fbn->fastboot.start_download = fastboot_start_download_net;
+	fbn->fastboot.resume_download = fastboot_resume_download_net;
 
 	if (opts) {
 		fbn->fastboot.files = opts->files;
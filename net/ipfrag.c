@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * ipfrag.c - IPv4 fragment reassembly
+ *
+ * A small, fixed number of datagrams can be reassembled at the same time.
+ * Each is identified by source and destination address, IP id and
+ * protocol. Received 8 byte units are tracked in a bitmap, so duplicated
+ * and overlapping fragments are harmless. Incomplete datagrams are
+ * dropped after a timeout or when their slot is needed for a new one.
+ */
+
+#define pr_fmt(fmt) "ipfrag: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <net.h>
+#include <malloc.h>
+#include <linux/bitmap.h>
+#include <linux/bitops.h>
+
+#define IPFRAG_SLOTS		4
+#define IPFRAG_TIMEOUT		(2 * SECOND)
+
+#define IP_MF			0x2000
+#define IP_OFFSET		0x1fff
+
+/* largest payload an IPv4 datagram can carry */
+#define IPFRAG_MAX_PAYLOAD	(0xffff - sizeof(struct iphdr))
+#define IPFRAG_MAX_UNITS	DIV_ROUND_UP(IPFRAG_MAX_PAYLOAD, 8)
+
+struct ipfrag {
+	unsigned char *buf;	/* ethernet + IP header followed by the payload */
+	uint32_t saddr;
+	uint32_t daddr;
+	uint16_t id;
+	uint8_t protocol;
+	uint64_t start;
+	unsigned int total;	/* payload length, 0 until the last fragment is seen */
+	unsigned int units;	/* number of 8 byte units received */
+	DECLARE_BITMAP(map, IPFRAG_MAX_UNITS);
+};
+
+static struct ipfrag ipfrags[IPFRAG_SLOTS];
+
+static void ipfrag_release(struct ipfrag *frag)
+{
+	free(frag->buf);
+	frag->buf = NULL;
+}
+
+static struct ipfrag *ipfrag_find(struct iphdr *ip)
+{
+	struct ipfrag *frag, *free_slot = NULL, *oldest = NULL;
+	int i;
+
+	for (i = 0; i < IPFRAG_SLOTS; i++) {
+		frag = &ipfrags[i];
+
+		if (frag->buf && is_timeout(frag->start, IPFRAG_TIMEOUT)) {
+			pr_debug("dropping incomplete datagram id 0x%04x\n",
+				 ntohs(frag->id));
+			ipfrag_release(frag);
+		}
+
+		if (!frag->buf) {
+			if (!free_slot)
+				free_slot = frag;
+			continue;
+		}
+
+		if (frag->id == ip->id && frag->protocol == ip->protocol &&
+		    frag->saddr == ip->saddr && frag->daddr == ip->daddr)
+			return frag;
+
+		if (!oldest || frag->start < oldest->start)
+			oldest = frag;
+	}
+
+	frag = free_slot;
+	if (!frag) {
+		pr_debug("no free slot, dropping datagram id 0x%04x\n",
+			 ntohs(oldest->id));
+		ipfrag_release(oldest);
+		frag = oldest;
+	}
+
+	frag->buf = malloc(ETHER_HDR_SIZE + sizeof(struct iphdr) +
+			   IPFRAG_MAX_PAYLOAD);
+	if (!frag->buf)
+		return NULL;
+
+	frag->saddr = ip->saddr;
+	frag->daddr = ip->daddr;
+	frag->id = ip->id;
+	frag->protocol = ip->protocol;
+	frag->start = get_time_ns();
+	frag->total = 0;
+	frag->units = 0;
+	bitmap_zero(frag->map, IPFRAG_MAX_UNITS);
+
+	return frag;
+}
+
+/**
+ * net_ip_defrag - add an IPv4 fragment to its datagram
+ * @pkt: The received frame, containing a verified IP header
+ * @len: The length of the frame, updated to the reassembled length
+ *
+ * Return: NULL when the datagram is not complete yet or the fragment had
+ * to be dropped. Otherwise the reassembled frame which the caller must
+ * free() after processing it.
+ */
+unsigned char *net_ip_defrag(unsigned char *pkt, int *len)
+{
+	struct iphdr *ip = net_eth_to_iphdr(pkt);
+	unsigned int hlen = (ip->hl_v & 0x0f) * 4;
+	unsigned int offset, plen, unit, last;
+	struct ipfrag *frag;
+	unsigned char *buf;
+	struct iphdr *nip;
+	bool more;
+
+	if (hlen < sizeof(struct iphdr) || *len < ETHER_HDR_SIZE + hlen)
+		return NULL;
+
+	plen = *len - ETHER_HDR_SIZE - hlen;
+	offset = (ntohs(ip->frag_off) & IP_OFFSET) * 8;
+	more = ntohs(ip->frag_off) & IP_MF;
+
+	/* all but the last fragment must carry a multiple of 8 bytes */
+	if (!plen || (more && plen % 8) || offset + plen > IPFRAG_MAX_PAYLOAD)
+		return NULL;
+
+	frag = ipfrag_find(ip);
+	if (!frag)
+		return NULL;
+
+	if (!more) {
+		if (frag->total && frag->total != offset + plen)
+			goto drop;
+		frag->total = offset + plen;
+	}
+
+	/* keep the headers of the first fragment */
+	if (!offset)
+		memcpy(frag->buf, pkt, ETHER_HDR_SIZE + sizeof(struct iphdr));
+
+	memcpy(frag->buf + ETHER_HDR_SIZE + sizeof(struct iphdr) + offset,
+	       pkt + ETHER_HDR_SIZE + hlen, plen);
+
+	last = DIV_ROUND_UP(offset + plen, 8);
+	for (unit = offset / 8; unit < last; unit++)
+		if (!test_and_set_bit(unit, frag->map))
+			frag->units++;
+
+	if (!frag->total || frag->units != DIV_ROUND_UP(frag->total, 8))
+		return NULL;
+
+	buf = frag->buf;
+	frag->buf = NULL;
+
+	nip = net_eth_to_iphdr(buf);
+	nip->hl_v = 0x45;
+	nip->tot_len = htons(sizeof(struct iphdr) + frag->total);
+	nip->frag_off = 0;
+	nip->check = 0;
+	nip->check = ~net_checksum((unsigned char *)nip, sizeof(struct iphdr));
+
+	*len = ETHER_HDR_SIZE + sizeof(struct iphdr) + frag->total;
+
+	return buf;
+drop:
+	ipfrag_release(frag);
+	return NULL;
+}
@@ -28,6 +28,7 @@
 #include <machine_id.h>
 #include <linux/ctype.h>
 #include <linux/err.h>
+#include <linux/hash.h>
 
 static unsigned int net_ip_id;
 
@@ -250,6 +251,8 @@ void net_poll(void)
 
 	eth_rx();
 
+	net_tcp_poll();
+
 	in_net_poll = false;
 }
 
@@ -363,7 +366,39 @@ IPaddr_t net_get_gateway(void)
 	return net_gateway;
 }
 
-static LIST_HEAD(connection_list);
+/*
+ * UDP connections are hashed by their local port, so the receive path
+ * doesn't have to walk all connections for every packet. Most traffic
+ * goes to the connection that received the previous packet, so that one
+ * is checked first.
+ */
+#define UDP_HASH_BITS	4
+
+static struct hlist_head udp_hash[1 << UDP_HASH_BITS];
+static struct net_connection *udp_last_con;
+static LIST_HEAD(icmp_connection_list);
+
+static struct hlist_head *udp_hash_head(uint16_t port)
+{
+	return &udp_hash[hash_32(port, UDP_HASH_BITS)];
+}
+
+static struct net_connection *net_udp_lookup(uint16_t port)
+{
+	struct net_connection *con = udp_last_con;
+
+	if (con && ntohs(con->udp->uh_sport) == port)
+		return con;
+
+	hlist_for_each_entry(con, udp_hash_head(port), udp_node) {
+		if (ntohs(con->udp->uh_sport) == port) {
+			udp_last_con = con;
+			return con;
+		}
+	}
+
+	return NULL;
+}
 
 /**
  * generate_ether_addr - Generates stable software assigned Ethernet address
@@ -461,8 +496,6 @@ static struct net_connection *net_new(struct eth_device *edev, IPaddr_t dest,
 	net_copy_ip(&con->ip->daddr, &dest);
 	net_copy_ip(&con->ip->saddr, &edev->ipaddr);
 
-	list_add_tail(&con->list, &connection_list);
-
 	return con;
 out:
 	net_free_packet(con->packet);
@@ -484,15 +517,57 @@ struct net_connection *net_udp_eth_new(struct eth_device *edev, IPaddr_t dest,
 	con->udp->uh_sport = htons(net_udp_new_localport());
 	con->ip->protocol = IPPROTO_UDP;
 
+	hlist_add_head(&con->udp_node, udp_hash_head(ntohs(con->udp->uh_sport)));
+
 	return con;
 }
 
+int net_udp_bind(struct net_connection *con, uint16_t sport)
+{
+	hlist_del(&con->udp_node);
+	con->udp->uh_sport = htons(sport);
+	hlist_add_head(&con->udp_node, udp_hash_head(sport));
+
+	return 0;
+}
+
 struct net_connection *net_udp_new(IPaddr_t dest, uint16_t dport,
 		rx_handler_f *handler, void *ctx)
 {
 	return net_udp_eth_new(NULL, dest, dport, handler, ctx);
 }
 
+#ifdef CONFIG_NET_TCP
+struct net_connection *net_tcp_eth_new(struct eth_device *edev, IPaddr_t dest,
+				       uint16_t dport, rx_handler_f *handler,
+				       void *ctx)
+{
+	struct net_connection *con = net_new(edev, dest, handler, ctx);
+	int ret;
+
+	if (IS_ERR(con))
+		return con;
+
+	con->proto = IPPROTO_TCP;
+	con->ip->protocol = IPPROTO_TCP;
+	con->tcp = (struct tcphdr *)(con->packet + ETHER_HDR_SIZE + sizeof(struct iphdr));
+
+	ret = net_tcp_connect(con, net_udp_new_localport(), dport);
+	if (ret) {
+		net_unregister(con);
+		return ERR_PTR(ret);
+	}
+
+	return con;
+}
+
+struct net_connection *net_tcp_new(IPaddr_t dest, uint16_t dport,
+		rx_handler_f *handler, void *ctx)
+{
+	return net_tcp_eth_new(NULL, dest, dport, handler, ctx);
+}
+#endif
+
 struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 		void *ctx)
 {
@@ -504,17 +579,32 @@ struct net_connection *net_icmp_new(IPaddr_t dest, rx_handler_f *handler,
 	con->proto = IPPROTO_ICMP;
 	con->ip->protocol = IPPROTO_ICMP;
 
+	list_add_tail(&con->list, &icmp_connection_list);
+
 	return con;
 }
 
 void net_unregister(struct net_connection *con)
 {
-	list_del(&con->list);
+	switch (con->proto) {
+	case IPPROTO_TCP:
+		net_tcp_release(con);
+		break;
+	case IPPROTO_UDP:
+		hlist_del(&con->udp_node);
+		if (udp_last_con == con)
+			udp_last_con = NULL;
+		break;
+	case IPPROTO_ICMP:
+		list_del(&con->list);
+		break;
+	}
+
 	net_free_packet(con->packet);
 	free(con);
 }
 
-static int net_ip_send(struct net_connection *con, int len)
+int net_ip_send(struct net_connection *con, int len)
 {
 	con->ip->tot_len = htons(sizeof(struct iphdr) + len);
 	con->ip->id = htons(net_ip_id++);
@@ -627,22 +717,22 @@ static int net_handle_arp(struct eth_device *edev, unsigned char *pkt, int len)
 	return -EINVAL;
 }
 
-static int net_handle_udp(unsigned char *pkt, int len)
+static int net_handle_udp(struct eth_device *edev, unsigned char *pkt, int len)
 {
-	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
 	struct net_connection *con;
 	struct udphdr *udp;
-	int port;
 
-	udp = (struct udphdr *)(ip + 1);
-	port = ntohs(udp->uh_dport);
-	list_for_each_entry(con, &connection_list, list) {
-		if (con->proto == IPPROTO_UDP && port == ntohs(con->udp->uh_sport)) {
-			con->handler(con->priv, pkt, len);
-			return 0;
-		}
+	udp = net_eth_to_udphdr(pkt);
+	con = net_udp_lookup(ntohs(udp->uh_dport));
+	if (!con) {
+		edev->rx_unmatched++;
+		return -EINVAL;
 	}
-	return -EINVAL;
+
+	edev->rx_delivered++;
+	con->handler(con->priv, pkt, len);
+
+	return 0;
 }
 
 static struct iphdr *ip_verify_size(unsigned char *pkt, int *total_len_nic)
@@ -700,6 +790,10 @@ static int ping_reply(struct eth_device *edev, unsigned char *pkt, int len)
 	if (!ip)
 		return -EILSEQ;
 
+	/* don't answer reassembled requests, we can't fragment the reply */
+	if (len > PKTSIZE)
+		return 0;
+
 	icmp->type = ICMP_ECHO_REPLY;
 	icmp->checksum = 0;
 	icmp->checksum = ~net_checksum((unsigned char *)icmp,
@@ -735,12 +829,33 @@ static int net_handle_icmp(struct eth_device *edev, unsigned char *pkt, int len)
 	if (icmp->type == ICMP_ECHO_REQUEST)
 		ping_reply(edev, pkt, len);
 
-	list_for_each_entry(con, &connection_list, list) {
-		if (con->proto == IPPROTO_ICMP) {
-			con->handler(con->priv, pkt, len);
-			return 0;
-		}
+	con = list_first_entry_or_null(&icmp_connection_list,
+				       struct net_connection, list);
+	if (con)
+		con->handler(con->priv, pkt, len);
+
+	if (con || icmp->type == ICMP_ECHO_REQUEST)
+		edev->rx_delivered++;
+	else
+		edev->rx_unmatched++;
+
+	return 0;
+}
+
+static int net_handle_ip_proto(struct eth_device *edev, unsigned char *pkt,
+			       int len)
+{
+	struct iphdr *ip = net_eth_to_iphdr(pkt);
+
+	switch (ip->protocol) {
+	case IPPROTO_ICMP:
+		return net_handle_icmp(edev, pkt, len);
+	case IPPROTO_UDP:
+		return net_handle_udp(edev, pkt, len);
+	case IPPROTO_TCP:
+		return net_handle_tcp(edev, pkt, len);
 	}
+
 	return 0;
 }
 
@@ -748,41 +863,48 @@ static int net_handle_ip(struct eth_device *edev, unsigned char *pkt, int len)
 {
 	struct iphdr *ip = (struct iphdr *)(pkt + ETHER_HDR_SIZE);
 	IPaddr_t tmp;
+	int ret;
 
 	pr_debug("%s\n", __func__);
 
 	ip = ip_verify_size(pkt, &len);
 	if (!ip) {
 		pr_debug("%s: bad len\n", __func__);
+		edev->rx_dropped++;
 		return 0;
 	}
 
 	if ((ip->hl_v & 0xf0) != 0x40)
 		goto bad;
 
-	/* Can't deal w/ fragments.
-	 * Either a fragment offset (13 bits), or
-	 * MF (More Fragments) from fragment flags (3 bits).
-	 * MF - because first fragment has fragment offset 0
-	 */
-	if (ip->frag_off & htons(0x3fff))
-		goto bad;
 	if (!net_checksum_ok((unsigned char *)ip, sizeof(struct iphdr)))
 		goto bad;
 
 	tmp = net_read_ip(&ip->daddr);
-	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST)
+	if (edev->ipaddr && tmp != edev->ipaddr && tmp != IP_BROADCAST) {
+		edev->rx_dropped++;
 		return 0;
+	}
 
-	switch (ip->protocol) {
-	case IPPROTO_ICMP:
-		return net_handle_icmp(edev, pkt, len);
-	case IPPROTO_UDP:
-		return net_handle_udp(pkt, len);
+	/*
+	 * Either a fragment offset (13 bits), or
+	 * MF (More Fragments) from fragment flags (3 bits).
+	 * MF - because first fragment has fragment offset 0
+	 */
+	if (ip->frag_off & htons(0x3fff)) {
+		pkt = net_ip_defrag(pkt, &len);
+		if (!pkt)
+			return 0;
+
+		ret = net_handle_ip_proto(edev, pkt, len);
+		free(pkt);
+
+		return ret;
 	}
 
-	return 0;
+	return net_handle_ip_proto(edev, pkt, len);
 bad:
+	edev->rx_dropped++;
 	net_bad_packet(pkt, len);
 	return 0;
 }
@@ -796,6 +918,7 @@ int net_receive(struct eth_device *edev, unsigned char *pkt, int len)
 	led_trigger_network(LED_TRIGGER_NET_RX);
 
 	if (len < ETHER_HDR_SIZE) {
+		edev->rx_dropped++;
 		ret = 0;
 		goto out;
 	}
@@ -830,6 +953,106 @@ int net_receive(struct eth_device *edev, unsigned char *pkt, int len)
 	return ret;
 }
 
+/*
+ * Packet buffers released by the protocol stack are kept on a free list,
+ * so drivers refilling their receive rings after a buffer has been taken
+ * over do not go through the allocator for every frame.
+ */
+#define NET_PACKET_POOL_SIZE	64
+
+static void *net_packet_pool[NET_PACKET_POOL_SIZE];
+static unsigned int net_packet_pool_num;
+
+char *net_alloc_packet(void)
+{
+	if (net_packet_pool_num)
+		return net_packet_pool[--net_packet_pool_num];
+
+	return dma_alloc(PKTSIZE);
+}
+
+void net_free_packet(char *pkt)
+{
+	if (!pkt)
+		return;
+
+	if (net_packet_pool_num < NET_PACKET_POOL_SIZE)
+		net_packet_pool[net_packet_pool_num++] = pkt;
+	else
+		dma_free(pkt);
+}
+
+/* the driver owned buffer of the frame currently being processed */
+static void *net_rx_buf;
+static void *net_rx_buf_spare;
+static bool net_rx_buf_taken;
+
+/**
+ * net_receive_buf - Pass a received packet in a packet buffer to the protocol stack
+ * @edev: The device the packet was received on
+ * @buf: The receive buffer, allocated with net_alloc_packet()
+ * @pkt: Pointer to the packet inside @buf
+ * @len: length of the packet
+ * @spare: A packet buffer the driver has already prepared to replace @buf
+ *	in its receive ring, or NULL
+ *
+ * Like net_receive(), but protocol handlers may take over @buf with
+ * net_rx_buf_take() instead of copying the data out of it. This is only
+ * possible when the driver passes a @spare buffer, so it never has to set
+ * up a replacement after @buf has already been handed over.
+ *
+ * Return: true if @buf has been taken over. The driver must then put @spare
+ * into its receive ring instead of @buf. Otherwise the driver still owns
+ * both buffers.
+ */
+bool net_receive_buf(struct eth_device *edev, void *buf, unsigned char *pkt,
+		     int len, void *spare)
+{
+	void *old_buf = net_rx_buf, *old_spare = net_rx_buf_spare;
+	bool old_taken = net_rx_buf_taken;
+	bool taken;
+
+	net_rx_buf = buf;
+	net_rx_buf_spare = spare;
+	net_rx_buf_taken = false;
+
+	net_receive(edev, pkt, len);
+
+	taken = net_rx_buf_taken;
+
+	net_rx_buf = old_buf;
+	net_rx_buf_spare = old_spare;
+	net_rx_buf_taken = old_taken;
+
+	return taken;
+}
+
+/**
+ * net_rx_buf_take - take over the receive buffer of a packet
+ * @data: Pointer into the packet passed to the rx handler
+ *
+ * Rx handlers can use this to keep the received data without copying it.
+ * This only works for packets received with net_receive_buf() with a spare
+ * buffer and only once per packet, so callers must be prepared to copy the
+ * data instead.
+ *
+ * Return: The start of the packet buffer containing @data, which must be
+ * released with net_free_packet() later, or NULL if the buffer can't be
+ * taken over.
+ */
+void *net_rx_buf_take(const void *data)
+{
+	if (!net_rx_buf || !net_rx_buf_spare || net_rx_buf_taken)
+		return NULL;
+
+	if (data < net_rx_buf || data >= net_rx_buf + PKTSIZE)
+		return NULL;
+
+	net_rx_buf_taken = true;
+
+	return net_rx_buf;
+}
+
 void net_free_packets(void **packets, unsigned count)
 {
 	while (count-- > 0)
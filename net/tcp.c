@@ -0,0 +1,669 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * tcp.c - minimal TCP client
+ *
+ * Only active open is supported. Outgoing data is kept in a per connection
+ * buffer until acknowledged and retransmitted go-back-N style on timeout.
+ * Incoming data is passed to the connection's handler in order directly
+ * from the receive path, so the receive window never closes. Out of order
+ * segments are dropped and answered with a duplicate ACK.
+ */
+
+#define pr_fmt(fmt) "tcp: " fmt
+
+#include <common.h>
+#include <clock.h>
+#include <net.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+#include <asm/unaligned.h>
+
+#define TCP_MSS			(1500 - sizeof(struct iphdr) - sizeof(struct tcphdr))
+#define TCP_DEFAULT_MSS		536
+#define TCP_RCV_WSCALE		3
+#define TCP_RCV_WND		SZ_256K
+#define TCP_TXBUF_SIZE		SZ_64K
+
+#define TCP_RTO_INITIAL		(200 * MSECOND)
+#define TCP_RTO_MAX		(8 * SECOND)
+#define TCP_MAX_RETRIES		10
+#define TCP_DELACK_TIMEOUT	(40 * MSECOND)
+#define TCP_CLOSE_TIMEOUT	(2 * SECOND)
+
+#define TCPOPT_EOL		0
+#define TCPOPT_NOP		1
+#define TCPOPT_MSS		2
+#define TCPOPT_WINDOW		3
+
+enum tcp_state {
+	TCP_CLOSED,
+	TCP_SYN_SENT,
+	TCP_ESTABLISHED,
+	TCP_FIN_WAIT,	/* we have sent our FIN */
+	TCP_CLOSE_WAIT,	/* the peer has sent its FIN */
+	TCP_LAST_ACK,	/* both sides have sent their FIN */
+};
+
+struct tcp_sock {
+	struct list_head list;
+	struct net_connection *con;
+	enum tcp_state state;
+	int error;
+
+	u32 snd_una;		/* oldest unacknowledged sequence number */
+	u32 snd_nxt;		/* next sequence number to send */
+	u32 snd_max;		/* highest sequence number sent so far */
+	u32 snd_wnd;		/* peer's receive window in bytes */
+	u32 snd_wl1;		/* sequence number of the last window update */
+	u32 snd_wl2;		/* acknowledgment number of the last window update */
+	u8 snd_wscale;		/* peer's window scale shift */
+	u8 rcv_wscale;		/* our window scale shift, 0 if not negotiated */
+	u16 mss;		/* peer's maximum segment size */
+	u32 rcv_nxt;		/* next expected sequence number */
+
+	void *txbuf;		/* data starting at snd_una */
+	size_t txlen;
+	bool fin_queued;
+	bool fin_sent;
+	bool fin_acked;
+	bool fin_received;
+
+	uint64_t rto_start;
+	uint64_t rto;
+	int retries;
+
+	int ack_pending;	/* number of segments not acknowledged yet */
+	uint64_t ack_start;
+};
+
+static LIST_HEAD(tcp_sockets);
+
+static inline bool seq_before(u32 a, u32 b)
+{
+	return (s32)(a - b) < 0;
+}
+
+static inline bool seq_after(u32 a, u32 b)
+{
+	return seq_before(b, a);
+}
+
+static uint16_t tcp_checksum(struct iphdr *ip, void *seg, int len)
+{
+	struct {
+		uint32_t saddr;
+		uint32_t daddr;
+		uint8_t zero;
+		uint8_t proto;
+		uint16_t len;
+	} __attribute__ ((packed)) ph;
+	uint32_t sum;
+
+	net_copy_ip(&ph.saddr, &ip->saddr);
+	net_copy_ip(&ph.daddr, &ip->daddr);
+	ph.zero = 0;
+	ph.proto = IPPROTO_TCP;
+	ph.len = htons(len);
+
+	sum = net_checksum((unsigned char *)&ph, sizeof(ph));
+	sum += net_checksum(seg, len);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	return sum;
+}
+
+static u16 tcp_rcv_window(struct tcp_sock *sk, u8 flags)
+{
+	/* the window in a SYN segment is never scaled */
+	if (flags & TCP_FLAG_SYN)
+		return min(TCP_RCV_WND, 0xffff);
+
+	return min(TCP_RCV_WND >> sk->rcv_wscale, 0xffff);
+}
+
+static int tcp_xmit(struct tcp_sock *sk, u8 flags, u32 seq,
+		    const void *data, size_t len)
+{
+	struct net_connection *con = sk->con;
+	struct tcphdr *tcp = con->tcp;
+	u8 *opt = (u8 *)(tcp + 1);
+	int optlen = 0, seglen;
+
+	if (flags & TCP_FLAG_SYN) {
+		opt[0] = TCPOPT_MSS;
+		opt[1] = 4;
+		put_unaligned_be16(TCP_MSS, &opt[2]);
+		opt[4] = TCPOPT_NOP;
+		opt[5] = TCPOPT_WINDOW;
+		opt[6] = 3;
+		opt[7] = TCP_RCV_WSCALE;
+		optlen = 8;
+	}
+
+	tcp->seq = htonl(seq);
+	tcp->ack_seq = (flags & TCP_FLAG_ACK) ? htonl(sk->rcv_nxt) : 0;
+	tcp->doff = ((sizeof(*tcp) + optlen) / 4) << 4;
+	tcp->flags = flags;
+	tcp->window = htons(tcp_rcv_window(sk, flags));
+	tcp->urg_ptr = 0;
+	tcp->check = 0;
+
+	if (len)
+		memcpy(opt + optlen, data, len);
+
+	seglen = sizeof(*tcp) + optlen + len;
+	tcp->check = ~tcp_checksum(con->ip, tcp, seglen);
+
+	if (flags & TCP_FLAG_ACK)
+		sk->ack_pending = 0;
+
+	return net_ip_send(con, seglen);
+}
+
+static void tcp_send_ack(struct tcp_sock *sk)
+{
+	tcp_xmit(sk, TCP_FLAG_ACK, sk->snd_nxt, NULL, 0);
+}
+
+static void tcp_send_segment(struct tcp_sock *sk, size_t len)
+{
+	u32 off = sk->snd_nxt - sk->snd_una;
+
+	if (sk->snd_una == sk->snd_nxt)
+		sk->rto_start = get_time_ns();
+
+	tcp_xmit(sk, TCP_FLAG_ACK | TCP_FLAG_PSH, sk->snd_nxt,
+		 sk->txbuf + off, len);
+
+	sk->snd_nxt += len;
+	if (seq_after(sk->snd_nxt, sk->snd_max))
+		sk->snd_max = sk->snd_nxt;
+}
+
+static void tcp_send_fin(struct tcp_sock *sk)
+{
+	if (sk->snd_una == sk->snd_nxt)
+		sk->rto_start = get_time_ns();
+
+	tcp_xmit(sk, TCP_FLAG_ACK | TCP_FLAG_FIN, sk->snd_nxt, NULL, 0);
+
+	sk->snd_nxt++;
+	if (seq_after(sk->snd_nxt, sk->snd_max))
+		sk->snd_max = sk->snd_nxt;
+	sk->fin_sent = true;
+}
+
+/*
+ * Send as much of the queued data as the peer's window allows, followed
+ * by our FIN once all data is out.
+ */
+static void tcp_output(struct tcp_sock *sk)
+{
+	while (1) {
+		u32 inflight = sk->snd_nxt - sk->snd_una;
+		size_t len;
+
+		if (inflight >= sk->txlen || inflight >= sk->snd_wnd)
+			break;
+
+		len = min3(sk->txlen - inflight, (size_t)sk->mss,
+			   (size_t)(sk->snd_wnd - inflight));
+
+		tcp_send_segment(sk, len);
+	}
+
+	if (sk->fin_queued && !sk->fin_sent &&
+	    sk->snd_nxt - sk->snd_una == sk->txlen)
+		tcp_send_fin(sk);
+}
+
+static void tcp_parse_options(struct tcp_sock *sk, struct tcphdr *tcp, int hlen)
+{
+	u8 *opt = (u8 *)(tcp + 1);
+	u8 *end = (u8 *)tcp + hlen;
+	bool wscale = false;
+
+	while (opt < end) {
+		if (opt[0] == TCPOPT_EOL)
+			break;
+
+		if (opt[0] == TCPOPT_NOP) {
+			opt++;
+			continue;
+		}
+
+		if (opt + 1 >= end || opt[1] < 2 || opt + opt[1] > end)
+			break;
+
+		switch (opt[0]) {
+		case TCPOPT_MSS:
+			if (opt[1] == 4)
+				sk->mss = clamp_t(u16, get_unaligned_be16(&opt[2]),
+						  64, TCP_MSS);
+			break;
+		case TCPOPT_WINDOW:
+			if (opt[1] == 3) {
+				sk->snd_wscale = min_t(u8, opt[2], 14);
+				wscale = true;
+			}
+			break;
+		}
+
+		opt += opt[1];
+	}
+
+	/* window scaling is only used when both sides offer it */
+	if (wscale) {
+		sk->rcv_wscale = TCP_RCV_WSCALE;
+	} else {
+		sk->rcv_wscale = 0;
+		sk->snd_wscale = 0;
+	}
+}
+
+static void tcp_ack(struct tcp_sock *sk, u32 seq, u32 ack, u16 window)
+{
+	u32 acked, data_acked;
+
+	if (seq_before(ack, sk->snd_una) || seq_after(ack, sk->snd_max))
+		return;
+
+	/* only take the window from segments newer than the last update */
+	if (seq_before(sk->snd_wl1, seq) ||
+	    (sk->snd_wl1 == seq && !seq_before(ack, sk->snd_wl2))) {
+		sk->snd_wnd = (u32)window << sk->snd_wscale;
+		sk->snd_wl1 = seq;
+		sk->snd_wl2 = ack;
+	}
+
+	acked = ack - sk->snd_una;
+	if (!acked)
+		return;
+
+	data_acked = min_t(u32, acked, sk->txlen);
+	memmove(sk->txbuf, sk->txbuf + data_acked, sk->txlen - data_acked);
+	sk->txlen -= data_acked;
+
+	if (sk->fin_sent && acked > data_acked)
+		sk->fin_acked = true;
+
+	sk->snd_una = ack;
+	if (seq_before(sk->snd_nxt, ack))
+		sk->snd_nxt = ack;
+
+	sk->retries = 0;
+	sk->rto = TCP_RTO_INITIAL;
+	sk->rto_start = get_time_ns();
+}
+
+static void tcp_close_state(struct tcp_sock *sk, int error)
+{
+	sk->state = TCP_CLOSED;
+	if (!sk->error)
+		sk->error = error;
+}
+
+static void tcp_rcv_synsent(struct tcp_sock *sk, struct tcphdr *tcp, int hlen)
+{
+	u32 ack = ntohl(tcp->ack_seq);
+
+	if (!(tcp->flags & TCP_FLAG_ACK) || ack != sk->snd_nxt)
+		return;
+
+	if (tcp->flags & TCP_FLAG_RST) {
+		tcp_close_state(sk, -ECONNREFUSED);
+		return;
+	}
+
+	if (!(tcp->flags & TCP_FLAG_SYN))
+		return;
+
+	tcp_parse_options(sk, tcp, hlen);
+
+	sk->rcv_nxt = ntohl(tcp->seq) + 1;
+	sk->snd_una = ack;
+	sk->snd_wnd = ntohs(tcp->window);
+	sk->snd_wl1 = ntohl(tcp->seq);
+	sk->snd_wl2 = ack;
+	sk->retries = 0;
+	sk->rto = TCP_RTO_INITIAL;
+	sk->state = TCP_ESTABLISHED;
+
+	tcp_send_ack(sk);
+}
+
+static struct tcp_sock *tcp_find_sock(struct iphdr *ip, struct tcphdr *tcp)
+{
+	struct tcp_sock *sk;
+
+	list_for_each_entry(sk, &tcp_sockets, list) {
+		struct net_connection *con = sk->con;
+
+		if (con->tcp->source == tcp->dest &&
+		    con->tcp->dest == tcp->source &&
+		    net_read_ip(&ip->saddr) == net_read_ip(&con->ip->daddr))
+			return sk;
+	}
+
+	return NULL;
+}
+
+int net_handle_tcp(struct eth_device *edev, unsigned char *pkt, int len)
+{
+	struct iphdr *ip = net_eth_to_iphdr((char *)pkt);
+	struct tcphdr *tcp = (struct tcphdr *)(ip + 1);
+	int seglen = len - ETHER_HDR_SIZE - sizeof(struct iphdr);
+	struct tcp_sock *sk;
+	u32 seq, dlen;
+	int hlen;
+	u8 *data;
+
+	if (seglen < (int)sizeof(*tcp))
+		return -EINVAL;
+
+	hlen = (tcp->doff >> 4) * 4;
+	if (hlen < sizeof(*tcp) || hlen > seglen)
+		return -EINVAL;
+
+	if (tcp_checksum(ip, tcp, seglen) != 0xffff)
+		return -EINVAL;
+
+	sk = tcp_find_sock(ip, tcp);
+	if (!sk)
+		return -EINVAL;
+
+	switch (sk->state) {
+	case TCP_CLOSED:
+		return 0;
+	case TCP_SYN_SENT:
+		tcp_rcv_synsent(sk, tcp, hlen);
+		return 0;
+	default:
+		break;
+	}
+
+	seq = ntohl(tcp->seq);
+	data = (u8 *)tcp + hlen;
+	dlen = seglen - hlen;
+
+	if (tcp->flags & TCP_FLAG_RST) {
+		/* only accept resets within the window */
+		if (seq == sk->rcv_nxt)
+			tcp_close_state(sk, -ECONNRESET);
+		return 0;
+	}
+
+	if (tcp->flags & TCP_FLAG_ACK)
+		tcp_ack(sk, seq, ntohl(tcp->ack_seq), ntohs(tcp->window));
+
+	if (seq != sk->rcv_nxt) {
+		if (seq_before(seq, sk->rcv_nxt) &&
+		    seq_after(seq + dlen, sk->rcv_nxt)) {
+			/* partially retransmitted data, skip the known part */
+			u32 skip = sk->rcv_nxt - seq;
+
+			data += skip;
+			dlen -= skip;
+			seq = sk->rcv_nxt;
+		} else {
+			/* out of order or duplicate, tell the peer what we expect */
+			if (dlen || (tcp->flags & TCP_FLAG_FIN))
+				tcp_send_ack(sk);
+			goto out;
+		}
+	}
+
+	if (dlen && !sk->fin_received) {
+		sk->rcv_nxt += dlen;
+
+		if (!sk->ack_pending)
+			sk->ack_start = get_time_ns();
+		sk->ack_pending++;
+
+		sk->con->handler(sk->con->priv, (char *)data, dlen);
+	}
+
+	if ((tcp->flags & TCP_FLAG_FIN) && !sk->fin_received) {
+		sk->rcv_nxt++;
+		sk->fin_received = true;
+
+		if (sk->state == TCP_ESTABLISHED)
+			sk->state = TCP_CLOSE_WAIT;
+		else if (sk->state == TCP_FIN_WAIT)
+			sk->state = TCP_LAST_ACK;
+
+		tcp_send_ack(sk);
+	} else if (sk->ack_pending >= 2) {
+		/* acknowledge at least every second segment */
+		tcp_send_ack(sk);
+	}
+
+out:
+	if (sk->state != TCP_CLOSED)
+		tcp_output(sk);
+
+	return 0;
+}
+
+static bool tcp_need_retransmit(struct tcp_sock *sk)
+{
+	if (sk->state == TCP_SYN_SENT)
+		return true;
+
+	/* data or FIN in flight, or a zero window to probe */
+	return sk->snd_una != sk->snd_max || (sk->txlen && !sk->snd_wnd);
+}
+
+static void tcp_retransmit(struct tcp_sock *sk)
+{
+	if (++sk->retries > TCP_MAX_RETRIES) {
+		pr_debug("connection timed out\n");
+		tcp_close_state(sk, -ETIMEDOUT);
+		return;
+	}
+
+	sk->rto = min_t(uint64_t, sk->rto * 2, TCP_RTO_MAX);
+	sk->rto_start = get_time_ns();
+
+	if (sk->state == TCP_SYN_SENT) {
+		tcp_xmit(sk, TCP_FLAG_SYN, sk->snd_una, NULL, 0);
+		return;
+	}
+
+	/* go back to the oldest unacknowledged data and resend one segment */
+	sk->snd_nxt = sk->snd_una;
+
+	if (sk->txlen) {
+		tcp_send_segment(sk, min_t(size_t, sk->txlen, sk->mss));
+	} else if (sk->fin_sent && !sk->fin_acked) {
+		sk->fin_sent = false;
+		tcp_send_fin(sk);
+	}
+
+	sk->rto_start = get_time_ns();
+}
+
+/*
+ * Called from net_poll() to handle the retransmission and delayed ACK
+ * timers of all connections.
+ */
+void net_tcp_poll(void)
+{
+	struct tcp_sock *sk;
+
+	list_for_each_entry(sk, &tcp_sockets, list) {
+		if (sk->state == TCP_CLOSED)
+			continue;
+
+		if (sk->ack_pending &&
+		    is_timeout(sk->ack_start, TCP_DELACK_TIMEOUT))
+			tcp_send_ack(sk);
+
+		if (tcp_need_retransmit(sk) && is_timeout(sk->rto_start, sk->rto))
+			tcp_retransmit(sk);
+	}
+}
+
+int net_tcp_connect(struct net_connection *con, uint16_t sport, uint16_t dport)
+{
+	struct tcp_sock *sk;
+	u32 iss = random32();
+
+	sk = xzalloc(sizeof(*sk));
+	sk->con = con;
+	sk->txbuf = xmalloc(TCP_TXBUF_SIZE);
+	sk->mss = TCP_DEFAULT_MSS;
+	sk->rto = TCP_RTO_INITIAL;
+	sk->snd_una = iss;
+	sk->snd_nxt = iss + 1;
+	sk->snd_max = iss + 1;
+	sk->state = TCP_SYN_SENT;
+	con->tcp_sock = sk;
+
+	con->tcp->source = htons(sport);
+	con->tcp->dest = htons(dport);
+
+	list_add_tail(&sk->list, &tcp_sockets);
+
+	sk->rto_start = get_time_ns();
+	tcp_xmit(sk, TCP_FLAG_SYN, iss, NULL, 0);
+
+	while (sk->state == TCP_SYN_SENT) {
+		if (ctrlc())
+			return -EINTR;
+		net_poll();
+	}
+
+	if (sk->state != TCP_ESTABLISHED)
+		return sk->error ?: -ECONNREFUSED;
+
+	pr_debug("connected to %pI4:%u, mss %u, wscale %u/%u\n",
+		 &con->ip->daddr, dport, sk->mss, sk->snd_wscale, sk->rcv_wscale);
+
+	return 0;
+}
+
+/**
+ * net_tcp_send - queue data for sending on a TCP connection
+ * @con: The connection
+ * @buf: The data
+ * @len: length of the data
+ *
+ * This returns once all data is queued, which is not necessarily acknowledged
+ * by the peer yet.
+ *
+ * Return: 0 for success or a negative error code
+ */
+int net_tcp_send(struct net_connection *con, const void *buf, size_t len)
+{
+	struct tcp_sock *sk = con->tcp_sock;
+
+	while (len) {
+		size_t now;
+
+		if (sk->error)
+			return sk->error;
+
+		if (sk->state != TCP_ESTABLISHED && sk->state != TCP_CLOSE_WAIT)
+			return -ENOTCONN;
+
+		now = min(len, TCP_TXBUF_SIZE - sk->txlen);
+		if (!now) {
+			if (ctrlc())
+				return -EINTR;
+			net_poll();
+			continue;
+		}
+
+		memcpy(sk->txbuf + sk->txlen, buf, now);
+		sk->txlen += now;
+		buf += now;
+		len -= now;
+
+		tcp_output(sk);
+	}
+
+	return 0;
+}
+
+/**
+ * net_tcp_eof - check if the peer has closed its side of the connection
+ * @con: The connection
+ *
+ * Return: true if no more data will be received
+ */
+bool net_tcp_eof(struct net_connection *con)
+{
+	struct tcp_sock *sk = con->tcp_sock;
+
+	return sk->fin_received || sk->state == TCP_CLOSED;
+}
+
+/**
+ * net_tcp_close - gracefully close a TCP connection
+ * @con: The connection
+ *
+ * Sends the remaining data followed by a FIN and waits for the peer to
+ * acknowledge it and to close its side as well. The connection must still
+ * be freed with net_unregister() afterwards.
+ *
+ * Return: 0 for success or a negative error code
+ */
+int net_tcp_close(struct net_connection *con)
+{
+	struct tcp_sock *sk = con->tcp_sock;
+	uint64_t start;
+
+	switch (sk->state) {
+	case TCP_ESTABLISHED:
+		sk->state = TCP_FIN_WAIT;
+		break;
+	case TCP_CLOSE_WAIT:
+		sk->state = TCP_LAST_ACK;
+		break;
+	default:
+		return sk->error;
+	}
+
+	sk->fin_queued = true;
+	tcp_output(sk);
+
+	start = get_time_ns();
+
+	while (!(sk->fin_acked && sk->fin_received)) {
+		if (sk->state == TCP_CLOSED)
+			return sk->error;
+
+		if (is_timeout(start, TCP_CLOSE_TIMEOUT)) {
+			tcp_xmit(sk, TCP_FLAG_RST | TCP_FLAG_ACK, sk->snd_nxt, NULL, 0);
+			tcp_close_state(sk, -ETIMEDOUT);
+			return sk->error;
+		}
+
+		net_poll();
+	}
+
+	/* TIME_WAIT is skipped, we never reuse the port right away */
+	sk->state = TCP_CLOSED;
+
+	return 0;
+}
+
+void net_tcp_release(struct net_connection *con)
+{
+	struct tcp_sock *sk = con->tcp_sock;
+
+	if (!sk)
+		return;
+
+	if (sk->state != TCP_CLOSED && sk->state != TCP_SYN_SENT)
+		tcp_xmit(sk, TCP_FLAG_RST | TCP_FLAG_ACK, sk->snd_nxt, NULL, 0);
+
+	list_del(&sk->list);
+	free(sk->txbuf);
+	free(sk);
+	con->tcp_sock = NULL;
+}
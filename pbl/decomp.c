@@ -12,6 +12,7 @@
 #include <asm/sections.h>
 #include <pbl.h>
 #include <debug_ll.h>
+#include <linux/sizes.h>
 
 #define STATIC static
 
@@ -32,14 +33,23 @@
 #endif
 
 #ifdef CONFIG_IMAGE_COMPRESSION_NONE
-STATIC int decompress(u8 *input, int in_len,
-				int (*fill) (void *, unsigned int),
-				int (*flush) (void *, unsigned int),
-				u8 *output, int *posp,
+STATIC int decompress(u8 *input, long in_len,
+				long (*fill) (void *, unsigned long),
+				long (*flush) (void *, unsigned long),
+				u8 *output, long *posp,
 				void (*error) (char *x))
 {
-	memcpy(output, input, in_len);
-	return 0;
+	long len;
+
+	if (!fill) {
+		memcpy(output, input, in_len);
+		return 0;
+	}
+
+	while ((len = fill(output, SZ_64K)) > 0)
+		output += len;
+
+	return len;
 }
 #endif
 
@@ -54,21 +64,50 @@ static void noinline errorfn(char *error)
 extern unsigned char sha_sum[];
 extern unsigned char sha_sum_end[];
 
-int pbl_barebox_verify(const void *compressed_start, unsigned int len,
-		       const void *hash, unsigned int hash_len)
+struct pbl_sha256 {
+	struct digest d;
+	union {
+		struct sha256_state generic;
+		u8 arch[SHA256_PBL_CTX_SIZE];
+	} ctx;
+};
+
+/*
+ * Use the ARMv8 Crypto Extensions when available, hashing barebox proper
+ * is a significant part of the time spent in the PBL.
+ */
+static void pbl_sha256_init(struct pbl_sha256 *s)
+{
+	s->d.algo = sha256_ce_pbl_algo();
+	s->d.ctx = &s->ctx;
+
+	if (s->d.algo)
+		s->d.algo->init(&s->d);
+	else
+		sha256_init(&s->d);
+}
+
+static void pbl_sha256_update(struct pbl_sha256 *s, const void *data,
+			      unsigned long len)
+{
+	if (s->d.algo)
+		s->d.algo->update(&s->d, data, len);
+	else
+		sha256_update(&s->d, data, len);
+}
+
+static int pbl_sha256_check(struct pbl_sha256 *s, const void *data,
+			    unsigned int len, const void *hash)
 {
-	struct sha256_state sha_state = { 0 };
-	struct digest d = { .ctx = &sha_state };
 	char computed_hash[SHA256_DIGEST_SIZE];
-	int i;
 	const char *char_hash = hash;
+	int i;
 
-	if (hash_len != SHA256_DIGEST_SIZE)
-		return -1;
+	if (s->d.algo)
+		s->d.algo->final(&s->d, computed_hash);
+	else
+		sha256_final(&s->d, computed_hash);
 
-	sha256_init(&d);
-	sha256_update(&d, compressed_start, len);
-	sha256_final(&d, computed_hash);
 	if (IS_ENABLED(CONFIG_DEBUG_LL)) {
 		puts_ll("CH ");
 
@@ -83,17 +122,85 @@ int pbl_barebox_verify(const void *compressed_start, unsigned int len,
 		putc_ll('\n');
 
 		pr_debug("Hexdump of first 64 bytes of %u\n", len);
-		print_hex_dump_bytes("", DUMP_PREFIX_ADDRESS, compressed_start, 64);
+		print_hex_dump_bytes("", DUMP_PREFIX_ADDRESS, data, 64);
 	}
 
 	return memcmp(hash, computed_hash, SHA256_DIGEST_SIZE);
 }
 
+int pbl_barebox_verify(const void *compressed_start, unsigned int len,
+		       const void *hash, unsigned int hash_len)
+{
+	struct pbl_sha256 s;
+
+	if (hash_len != SHA256_DIGEST_SIZE)
+		return -1;
+
+	pbl_sha256_init(&s);
+	pbl_sha256_update(&s, compressed_start, len);
+
+	return pbl_sha256_check(&s, compressed_start, len, hash);
+}
+
+/*
+ * State for hashing the compressed image while the decompressor consumes
+ * it through its fill callback. The decompressors take no context pointer,
+ * hence the static variable.
+ */
+static struct {
+	struct pbl_sha256 sha;
+	const u8 *pos;
+	const u8 *end;
+} pbl_stream;
+
+static long pbl_stream_fill(void *buf, unsigned long size)
+{
+	unsigned long now = min_t(unsigned long, size, pbl_stream.end - pbl_stream.pos);
+
+	/* hash first, so that the copy is served from the cache */
+	pbl_sha256_update(&pbl_stream.sha, pbl_stream.pos, now);
+	memcpy(buf, pbl_stream.pos, now);
+	pbl_stream.pos += now;
+
+	return now;
+}
+
+static void pbl_barebox_uncompress_verify(void *dest, void *compressed_start,
+					  unsigned int len)
+{
+	unsigned int hash_len = sha_sum_end - sha_sum;
+
+	if (hash_len != SHA256_DIGEST_SIZE) {
+		putc_ll('!');
+		panic("invalid hash length, refusing to decompress");
+	}
+
+	pbl_sha256_init(&pbl_stream.sha);
+	pbl_stream.pos = compressed_start;
+	pbl_stream.end = compressed_start + len;
+
+	decompress(NULL, 0, pbl_stream_fill, NULL, dest, NULL, errorfn);
+
+	/* hash whatever the decompressor did not need to look at */
+	pbl_sha256_update(&pbl_stream.sha, pbl_stream.pos,
+			  pbl_stream.end - pbl_stream.pos);
+
+	if (pbl_sha256_check(&pbl_stream.sha, compressed_start, len, sha_sum)) {
+		putc_ll('!');
+		panic("hash mismatch, refusing to start barebox");
+	}
+}
+
 void pbl_barebox_uncompress(void *dest, void *compressed_start, unsigned int len)
 {
 	uint32_t pbl_hash_len;
 	void *pbl_hash_start, *pbl_hash_end;
 
+	if (IS_ENABLED(CONFIG_PBL_VERIFY_PIGGY_STREAMING)) {
+		pbl_barebox_uncompress_verify(dest, compressed_start, len);
+		return;
+	}
+
 	if (IS_ENABLED(CONFIG_PBL_VERIFY_PIGGY)) {
 		pbl_hash_start = sha_sum;
 		pbl_hash_end = sha_sum_end;
@@ -43,6 +43,25 @@ static inline const char *digest_suffix(const char *str, const char *suffix)
 	return buf;
 }
 
+/*
+ * Accelerated digests are only registered when the CPU implements the
+ * needed instructions, so skip rather than fail when they are missing.
+ */
+static bool digest_cpu_supported(bool option, const char *algo)
+{
+	struct digest *d;
+
+	if (!option)
+		return false;
+
+	d = digest_alloc(algo);
+	if (!d)
+		return false;
+
+	digest_free(d);
+	return true;
+}
+
 static void __test_digest(bool option,
 			  const char *algo, struct digest_test_case *t,
 			  const char *func, int line)
@@ -137,6 +156,7 @@ static void test_digests_sha12(const char *suffix)
 
 	cond = !strcmp(suffix, "generic") ? IS_ENABLED(CONFIG_DIGEST_SHA1_GENERIC) :
 	       !strcmp(suffix, "asm") ? IS_ENABLED(CONFIG_DIGEST_SHA1_ARM) :
+	       !strcmp(suffix, "ni")  ? false :
 	       IS_ENABLED(CONFIG_HAVE_DIGEST_SHA1);
 
 	test_digest(cond, digest_suffix("sha1", suffix),
@@ -148,6 +168,8 @@ static void test_digests_sha12(const char *suffix)
 	cond = !strcmp(suffix, "generic") ? IS_ENABLED(CONFIG_DIGEST_SHA224_GENERIC) :
 	       !strcmp(suffix, "asm") ? IS_ENABLED(CONFIG_DIGEST_SHA256_ARM) :
 	       !strcmp(suffix, "ce")  ? IS_ENABLED(CONFIG_DIGEST_SHA256_ARM64_CE) :
+	       !strcmp(suffix, "ni")  ? digest_cpu_supported(IS_ENABLED(CONFIG_DIGEST_SHA256_X86_SHANI),
+							     digest_suffix("sha224", suffix)) :
 	       IS_ENABLED(CONFIG_HAVE_DIGEST_SHA224);
 
 	test_digest(cond, digest_suffix("sha224", suffix),
@@ -159,6 +181,8 @@ static void test_digests_sha12(const char *suffix)
 	cond = !strcmp(suffix, "generic") ? IS_ENABLED(CONFIG_DIGEST_SHA256_GENERIC) :
 	       !strcmp(suffix, "asm") ? IS_ENABLED(CONFIG_DIGEST_SHA256_ARM) :
 	       !strcmp(suffix, "ce")  ? IS_ENABLED(CONFIG_DIGEST_SHA256_ARM64_CE) :
+	       !strcmp(suffix, "ni")  ? digest_cpu_supported(IS_ENABLED(CONFIG_DIGEST_SHA256_X86_SHANI),
+							     digest_suffix("sha256", suffix)) :
 	       IS_ENABLED(CONFIG_HAVE_DIGEST_SHA256);
 
 	test_digest(cond, digest_suffix("sha256", suffix),
@@ -173,6 +197,8 @@ static void test_digests_sha35(const char *suffix)
 	bool cond;
 
 	cond = !strcmp(suffix, "generic") ? IS_ENABLED(CONFIG_DIGEST_SHA384_GENERIC) :
+	       !strcmp(suffix, "ce")  ? digest_cpu_supported(IS_ENABLED(CONFIG_DIGEST_SHA512_ARM64_CE),
+							     digest_suffix("sha384", suffix)) :
 	       IS_ENABLED(CONFIG_HAVE_DIGEST_SHA384);
 
 	test_digest(cond, digest_suffix("sha384", suffix),
@@ -185,6 +211,8 @@ static void test_digests_sha35(const char *suffix)
 
 
 	cond = !strcmp(suffix, "generic") ? IS_ENABLED(CONFIG_DIGEST_SHA512_GENERIC) :
+	       !strcmp(suffix, "ce")  ? digest_cpu_supported(IS_ENABLED(CONFIG_DIGEST_SHA512_ARM64_CE),
+							     digest_suffix("sha512", suffix)) :
 	       IS_ENABLED(CONFIG_HAVE_DIGEST_SHA512);
 
 	test_digest(cond, digest_suffix("sha512", suffix),
@@ -209,7 +237,12 @@ static void test_digests(void)
 	if (IS_ENABLED(CONFIG_ARM32))
 		test_digests_sha12("asm");
 
+	if (IS_ENABLED(CONFIG_DIGEST_SHA256_X86_SHANI))
+		test_digests_sha12("ni");
+
 	test_digests_sha35("generic");
+	if (IS_ENABLED(CONFIG_DIGEST_SHA512_ARM64_CE))
+		test_digests_sha35("ce");
 
 	test_digest_md5("");
 	test_digests_sha12("");
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <common.h>
+#include <fcntl.h>
+#include <fs.h>
+#include <libfile.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <image-sparse.h>
+#include <bselftest.h>
+
+BSELFTEST_GLOBALS();
+
+#define __expect(cond, fmt, ...) ({ \
+	bool __cond = (cond); \
+	total_tests++; \
+	\
+	if (!__cond) { \
+		failed_tests++; \
+		printf("%s failed at %s:%d " fmt "\n", \
+			#cond, __func__, __LINE__, ##__VA_ARGS__); \
+	} \
+	__cond; \
+})
+
+#define expect(cond, ...) __expect((cond), __VA_ARGS__)
+
+/*
+ * Both headers are longer than the ones we know about, so the decoders
+ * also have to skip the unknown parts.
+ */
+#define SPARSE_TEST_BLK_SZ	512
+#define SPARSE_TEST_FILE_HDR_SZ	(sizeof(struct sparse_header) + 4)
+#define SPARSE_TEST_CHUNK_HDR_SZ	(sizeof(struct chunk_header) + 4)
+
+static const struct {
+	u16 type;
+	u32 blocks;
+} sparse_test_chunks[] = {
+	{ CHUNK_TYPE_RAW, 3 },
+	{ CHUNK_TYPE_FILL, 2 },
+	{ CHUNK_TYPE_DONT_CARE, 2 },
+	{ CHUNK_TYPE_RAW, 1 },
+	{ CHUNK_TYPE_CRC32, 0 },
+	{ CHUNK_TYPE_FILL, 1 },
+};
+
+static void *sparse_test_put_chunk(void *p, u16 type, u32 blocks,
+				   u32 payload)
+{
+	struct chunk_header *chunk = p;
+
+	memset(p, 0, SPARSE_TEST_CHUNK_HDR_SZ);
+	chunk->chunk_type = cpu_to_le16(type);
+	chunk->chunk_sz = cpu_to_le32(blocks);
+	chunk->total_sz = cpu_to_le32(SPARSE_TEST_CHUNK_HDR_SZ + payload);
+
+	return p + SPARSE_TEST_CHUNK_HDR_SZ;
+}
+
+static void *sparse_test_image(size_t *len, size_t *outlen)
+{
+	struct sparse_header *sparse;
+	u32 total_blks = 0, payload, fill;
+	void *img, *p;
+	int i, j;
+
+	img = xzalloc(SPARSE_TEST_FILE_HDR_SZ + ARRAY_SIZE(sparse_test_chunks) *
+		      (SPARSE_TEST_CHUNK_HDR_SZ + 3 * SPARSE_TEST_BLK_SZ));
+
+	p = img + SPARSE_TEST_FILE_HDR_SZ;
+
+	for (i = 0; i < ARRAY_SIZE(sparse_test_chunks); i++) {
+		u16 type = sparse_test_chunks[i].type;
+		u32 blocks = sparse_test_chunks[i].blocks;
+
+		switch (type) {
+		case CHUNK_TYPE_RAW:
+			payload = blocks * SPARSE_TEST_BLK_SZ;
+			p = sparse_test_put_chunk(p, type, blocks, payload);
+			for (j = 0; j < payload; j++)
+				((u8 *)p)[j] = i * 37 + j * 7;
+			break;
+		case CHUNK_TYPE_FILL:
+		case CHUNK_TYPE_CRC32:
+			payload = sizeof(fill);
+			p = sparse_test_put_chunk(p, type, blocks, payload);
+			fill = cpu_to_le32(0x5a5a0000 | i);
+			memcpy(p, &fill, sizeof(fill));
+			break;
+		default:
+			payload = 0;
+			p = sparse_test_put_chunk(p, type, blocks, payload);
+			break;
+		}
+
+		p += payload;
+		total_blks += blocks;
+	}
+
+	sparse = img;
+	sparse->magic = cpu_to_le32(SPARSE_HEADER_MAGIC);
+	sparse->major_version = cpu_to_le16(1);
+	sparse->file_hdr_sz = cpu_to_le16(SPARSE_TEST_FILE_HDR_SZ);
+	sparse->chunk_hdr_sz = cpu_to_le16(SPARSE_TEST_CHUNK_HDR_SZ);
+	sparse->blk_sz = cpu_to_le32(SPARSE_TEST_BLK_SZ);
+	sparse->total_blks = cpu_to_le32(total_blks);
+	sparse->total_chunks = cpu_to_le32(ARRAY_SIZE(sparse_test_chunks));
+
+	*len = p - img;
+	*outlen = total_blks * SPARSE_TEST_BLK_SZ;
+
+	return img;
+}
+
+/* Decode the image with sparse_image_open() as the reference */
+static int sparse_test_decode_file(const char *path, void *out, size_t outlen)
+{
+	struct sparse_image_ctx *si;
+	size_t retlen;
+	loff_t pos;
+	u8 buf[SPARSE_TEST_BLK_SZ];
+	int ret;
+
+	si = sparse_image_open(path);
+	if (IS_ERR(si))
+		return PTR_ERR(si);
+
+	while (1) {
+		ret = sparse_image_read(si, buf, &pos, sizeof(buf), &retlen);
+		if (ret || !retlen)
+			break;
+
+		if (pos + retlen > outlen) {
+			ret = -ENOSPC;
+			break;
+		}
+
+		memcpy(out + pos, buf, retlen);
+	}
+
+	sparse_image_close(si);
+
+	return ret;
+}
+
+struct sparse_test_out {
+	void *buf;
+	size_t len;
+};
+
+static int sparse_test_write(void *ctx, const void *buf, loff_t pos,
+			     size_t len)
+{
+	struct sparse_test_out *out = ctx;
+
+	if (pos + len > out->len)
+		return -ENOSPC;
+
+	memcpy(out->buf + pos, buf, len);
+
+	return 0;
+}
+
+/* Feed the image in pieces of @piece bytes, which split headers and chunks */
+static void sparse_test_stream(const void *img, size_t len, size_t piece,
+			       const void *ref, size_t outlen)
+{
+	struct sparse_image_stream *ss;
+	struct sparse_test_out out;
+	size_t ofs, now;
+	int ret = 0;
+
+	out.len = outlen;
+	out.buf = xmalloc(outlen);
+	memset(out.buf, 0xa5, outlen);
+
+	ss = sparse_image_stream_new(sparse_test_write, &out);
+
+	for (ofs = 0; ofs < len; ofs += now) {
+		now = min(piece, len - ofs);
+
+		ret = sparse_image_stream_write(ss, img + ofs, now);
+		if (ret)
+			break;
+	}
+
+	if (!expect(ret == 0, "piece size %zu, offset %zu: %pe",
+		    piece, ofs, ERR_PTR(ret)))
+		goto out;
+
+	expect(sparse_image_stream_finish(ss) == 0, "piece size %zu", piece);
+	expect(sparse_image_stream_size(ss) == outlen, "piece size %zu", piece);
+	expect(!memcmp(out.buf, ref, outlen), "piece size %zu", piece);
+out:
+	sparse_image_stream_free(ss);
+	free(out.buf);
+}
+
+static void test_image_sparse(void)
+{
+	static const size_t pieces[] = { 1, 3, 7, 13, 29, 509, 4093, SIZE_MAX };
+	void *img, *ref = NULL;
+	size_t len, outlen;
+	char *path;
+	int i, ret;
+
+	img = sparse_test_image(&len, &outlen);
+
+	path = make_temp("sparse-test");
+	ret = write_file(path, img, len);
+	if (!expect(ret == 0, "write_file(): %pe", ERR_PTR(ret)))
+		goto out;
+
+	ref = xmalloc(outlen);
+	memset(ref, 0xa5, outlen);
+
+	ret = sparse_test_decode_file(path, ref, outlen);
+	unlink(path);
+	if (!expect(ret == 0, "one-shot decoder: %pe", ERR_PTR(ret)))
+		goto out;
+
+	for (i = 0; i < ARRAY_SIZE(pieces); i++)
+		sparse_test_stream(img, len, pieces[i], ref, outlen);
+out:
+	free(ref);
+	free(path);
+	free(img);
+}
+bselftest(core, test_image_sparse);
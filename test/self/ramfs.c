@@ -89,6 +89,119 @@ static void test_tree(const char *path, struct test_tree_ctx *ctx)
 	popd(oldwd);
 }
 
+static u8 chunk_pattern(loff_t ofs)
+{
+	return ofs * 7 + ofs / 251;
+}
+
+static bool chunk_check(const u8 *buf, loff_t ofs, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] != chunk_pattern(ofs + i))
+			return false;
+
+	return true;
+}
+
+/*
+ * Once a file has been memmapped its data can't be moved by realloc()
+ * anymore, so growing it adds a new chunk with every write. Check reads
+ * at offsets spanning chunks, truncation and that the mapping stays valid.
+ */
+static void test_ramfs_chunks(void)
+{
+	const char *fname = "chunked";
+	const size_t first = SZ_4K, piece = 1000, npieces = 64;
+	const size_t size = first + piece * npieces;
+	u8 *buf, *map, *map2;
+	loff_t ofs;
+	size_t i, now;
+	struct stat st;
+	int fd, ret;
+
+	buf = malloc(size);
+	if (WARN_ON(!buf))
+		return;
+
+	for (i = 0; i < size; i++)
+		buf[i] = chunk_pattern(i);
+
+	fd = open(fname, O_RDWR | O_CREAT | O_TRUNC);
+	if (!expect_success(fd, "creating file"))
+		goto out_free;
+
+	ret = write(fd, buf, first);
+	expect_success(ret == first ? 0 : -EIO, "writing first chunk");
+
+	map = memmap(fd, PROT_READ);
+	if (!expect_success(map != MAP_FAILED ? 0 : -errno, "memmap()"))
+		goto out_close;
+
+	expect_success(chunk_check(map, 0, first) ? 0 : -EINVAL,
+		       "memmapped content");
+
+	for (i = 0; i < npieces; i++) {
+		ret = write(fd, buf + first + i * piece, piece);
+		expect_success(ret == piece ? 0 : -EIO, "appending piece %zu", i);
+	}
+
+	ret = fstat(fd, &st);
+	expect_success(!ret && st.st_size == size ? 0 : -EINVAL, "size after appending");
+
+	/* the chunks can't be merged without invalidating the first mapping */
+	map2 = memmap(fd, PROT_READ);
+	expect_fail(map2 == MAP_FAILED ? -errno : 0, "memmap() of mapped multi-chunk file");
+
+	/* the mapping must still refer to the file data */
+	ret = pwrite(fd, "\xaa", 1, 10);
+	expect_success(ret == 1 && map[10] == 0xaa ? 0 : -EINVAL,
+		       "write through mapped data");
+	ret = pwrite(fd, &buf[10], 1, 10);
+	expect_success(ret == 1 ? 0 : -EIO, "restoring mapped data");
+
+	/* odd sized reads crossing chunk boundaries */
+	for (ofs = 0; ofs < size; ofs += 997) {
+		now = min_t(size_t, 1500, size - ofs);
+		memset(buf, 0, now);
+		ret = pread(fd, buf, now, ofs);
+		if (!expect_success(ret == now ? 0 : -EIO, "reading at %lld", ofs))
+			break;
+		if (!expect_success(chunk_check(buf, ofs, now) ? 0 : -EINVAL,
+				    "content at %lld", ofs))
+			break;
+	}
+
+	/* truncate in the middle of the chunks and grow again */
+	ret = ftruncate(fd, size / 2);
+	expect_success(ret, "truncating down");
+
+	ret = ftruncate(fd, size);
+	expect_success(ret, "truncating up");
+
+	ret = lseek(fd, 0, SEEK_SET);
+	expect_success(ret, "seeking to start");
+
+	ret = read(fd, buf, size);
+	if (expect_success(ret == size ? 0 : -EIO, "reading truncated file")) {
+		expect_success(chunk_check(buf, 0, size / 2) ? 0 : -EINVAL,
+			       "content kept after truncation");
+		expect_success(memchr_inv(buf + size / 2, 0, size - size / 2) ?
+			       -EINVAL : 0, "zeroes after growing again");
+	}
+
+	expect_success(chunk_check(map, 0, first) ? 0 : -EINVAL,
+		       "memmapped content after truncation");
+
+out_close:
+	close(fd);
+	ret = unlink(fname);
+	expect_success(ret, "unlinking file");
+out_free:
+	free(buf);
+}
+
 static void test_ramfs(void)
 {
 	int files[] = { 1, 3, 5, 7, 11, 13, 17 };
@@ -248,6 +361,8 @@ static void test_ramfs(void)
 			       ctx.ndirs);
 	}
 
+	test_ramfs_chunks();
+
 out:
 	popd(oldpwd);
 	free(content);
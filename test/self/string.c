@@ -5,6 +5,7 @@
 #include <common.h>
 #include <bselftest.h>
 #include <string.h>
+#include <linux/sizes.h>
 
 BSELFTEST_GLOBALS();
 
@@ -328,10 +329,166 @@ static void test_strsep_unescaped(void)
 	test_strsep_unescaped_only_delimiters();
 }
 
+#define MEMOPS_BUF_SIZE	(SZ_1K + 64)
+
+static u8 memops_src[MEMOPS_BUF_SIZE], memops_dst[MEMOPS_BUF_SIZE];
+static u8 memops_ref[MEMOPS_BUF_SIZE];
+
+static const size_t memops_lengths[] = {
+	0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255, SZ_1K,
+};
+
+static void memops_fill(u8 *buf, size_t len, u8 seed)
+{
+	while (len--)
+		*buf++ = seed++ * 131;
+}
+
+static void __expect_memeq(const char *func, int line, const char *what,
+			   const void *is, const void *expect,
+			   size_t dofs, size_t sofs, size_t len)
+{
+	total_tests++;
+	if (memcmp(is, expect, MEMOPS_BUF_SIZE)) {
+		failed_tests++;
+		printf("%s:%d: %s(dst+%zu, src+%zu, %zu) mismatch\n",
+		       func, line, what, dofs, sofs, len);
+	}
+}
+
+#define expect_memeq(args...) \
+	__expect_memeq(__func__, __LINE__, args)
+
+static void test_memcpy_one(void *(*fn)(void *, const void *, size_t),
+			    const char *name)
+{
+	size_t dofs, sofs, i, l, len;
+
+	for (dofs = 0; dofs < 2 * sizeof(long); dofs++) {
+		for (sofs = 0; sofs < 2 * sizeof(long); sofs++) {
+			for (l = 0; l < ARRAY_SIZE(memops_lengths); l++) {
+				len = memops_lengths[l];
+
+				memops_fill(memops_src, MEMOPS_BUF_SIZE, len);
+				memops_fill(memops_dst, MEMOPS_BUF_SIZE, 0x55);
+				memops_fill(memops_ref, MEMOPS_BUF_SIZE, 0x55);
+				for (i = 0; i < len; i++)
+					memops_ref[dofs + i] = memops_src[sofs + i];
+
+				fn(memops_dst + dofs, memops_src + sofs, len);
+				expect_memeq(name, memops_dst, memops_ref, dofs, sofs, len);
+			}
+		}
+	}
+}
+
+static void test_memset_one(void *(*fn)(void *, int, size_t),
+			    const char *name)
+{
+	size_t dofs, i, l, len;
+
+	for (dofs = 0; dofs < 2 * sizeof(long); dofs++) {
+		for (l = 0; l < ARRAY_SIZE(memops_lengths); l++) {
+			len = memops_lengths[l];
+
+			memops_fill(memops_dst, MEMOPS_BUF_SIZE, 0x55);
+			memops_fill(memops_ref, MEMOPS_BUF_SIZE, 0x55);
+			for (i = 0; i < len; i++)
+				memops_ref[dofs + i] = 0xa5;
+
+			/* upper bits of the fill value must be ignored */
+			fn(memops_dst + dofs, 0x3a5, len);
+			expect_memeq(name, memops_dst, memops_ref, dofs, 0, len);
+		}
+	}
+}
+
+static void expect_memcmp_sign(const u8 *a, const u8 *b, size_t len,
+			       int expect, size_t ofs)
+{
+	int actual = memcmp(a, b, len);
+
+	actual = actual < 0 ? -1 : actual > 0;
+
+	total_tests++;
+	if (actual != expect) {
+		failed_tests++;
+		printf("memcmp(a+%zu, b+%zu, %zu) = %d, but %d expected\n",
+		       ofs, ofs, len, actual, expect);
+	}
+}
+
+static void test_memcmp(void)
+{
+	size_t ofs, l, len;
+
+	memops_fill(memops_src, MEMOPS_BUF_SIZE, 0);
+
+	for (ofs = 0; ofs < 2 * sizeof(long); ofs++) {
+		for (l = 0; l < ARRAY_SIZE(memops_lengths); l++) {
+			len = memops_lengths[l];
+
+			memcpy(memops_dst, memops_src, MEMOPS_BUF_SIZE);
+			expect_memcmp_sign(memops_src + ofs, memops_dst + ofs, len, 0, ofs);
+
+			if (!len)
+				continue;
+
+			/* difference in the last byte only */
+			memops_src[ofs + len - 1] = 0x10;
+			memops_dst[ofs + len - 1] = 0x20;
+			expect_memcmp_sign(memops_src + ofs, memops_dst + ofs, len, -1, ofs);
+			expect_memcmp_sign(memops_dst + ofs, memops_src + ofs, len, 1, ofs);
+
+			/* bytes are compared unsigned */
+			memops_dst[ofs] = 0x80;
+			memops_src[ofs] = 0x7f;
+			expect_memcmp_sign(memops_src + ofs, memops_dst + ofs, len, -1, ofs);
+
+			memops_fill(memops_src, MEMOPS_BUF_SIZE, 0);
+		}
+	}
+}
+
+static void test_strlen(void)
+{
+	size_t ofs, len, actual;
+	char *str = (char *)memops_dst;
+
+	memset(str, 'x', MEMOPS_BUF_SIZE);
+
+	for (ofs = 0; ofs < 2 * sizeof(long); ofs++) {
+		for (len = 0; len < 4 * sizeof(long); len++) {
+			str[ofs + len] = '\0';
+
+			total_tests++;
+			actual = strlen(str + ofs);
+			if (actual != len) {
+				failed_tests++;
+				printf("strlen(str+%zu) = %zu, but %zu expected\n",
+				       ofs, actual, len);
+			}
+
+			str[ofs + len] = 0x80 | len;
+		}
+	}
+}
+
+static void test_memops(void)
+{
+	test_memcpy_one(memcpy, "memcpy");
+	test_memcpy_one(__default_memcpy, "__default_memcpy");
+	test_memset_one(memset, "memset");
+	test_memset_one(__default_memset, "__default_memset");
+	test_memcmp();
+	test_strlen();
+}
+
 static void test_string(void)
 {
 	test_strverscmp();
 	test_strjoin();
 	test_strsep_unescaped();
+	test_memops();
 }
 bselftest(parser, test_string);